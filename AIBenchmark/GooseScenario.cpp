@@ -0,0 +1,163 @@
+#include "Scenarios.h"
+#include "GameWorld.h"
+#include "PhysicsSystem.h"
+#include "NavigationGrid.h"
+#include "BehaviourTreeObject.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+using namespace NCL;
+using namespace CSC8503;
+
+/*
+Lots of real geese in the maze, all running the shared tree from one
+BehaviourBatch, to see what each one costs to keep around and to tick.
+There's no physics - their forces are recorded and thrown away, so they
+stay where they were put - and no debug lines, so it's the tree and
+what its actions look at that's being measured. The first path searches
+are let through before the measuring starts, so every goose has a goat
+to chase, and is following its path there every tick. The goats stay
+put unless told to step to a neighbouring node every so many frames, as
+a goat being chased would.
+*/
+
+namespace {
+	typedef std::chrono::high_resolution_clock Clock;
+
+	const int GOOSE_GOATS = 2;
+
+	int CountChasing(const std::vector<Goose*>& geese) {
+		int chasing = 0;
+		for (const Goose* goose : geese) {
+			chasing += goose->GetTarget() != nullptr;
+		}
+		return chasing;
+	}
+
+	void StepGoat(GameObject* goat, const NavigationGrid& maze, std::mt19937& rng) {
+		int x, z;
+		if (!maze.WorldToGrid(goat->GetTransform().GetPosition(), x, z)) {
+			return;
+		}
+		const int offsets[4][2] = { { 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 } };
+		const int* step = offsets[rng() % 4];
+		if (maze.IsOpen(x + step[0], z + step[1])) {
+			goat->GetTransform().SetPosition(maze.GetNodePosition(((z + step[1]) * maze.GetWidth()) + x + step[0]));
+		}
+	}
+}
+
+int GooseScenario(int argc, char** argv) {
+	int gooseCount	= argc > 0 ? std::atoi(argv[0]) : 10000;
+	int frames		= argc > 1 ? std::atoi(argv[1]) : 100;
+	int goatStep	= argc > 2 ? std::atoi(argv[2]) : 0;
+	const float dt = 1.0f / 60.0f;
+
+	Debug::SetLinesEnabled(0);
+
+	GameWorld* world = new GameWorld();
+	PhysicsSystem* physics = new PhysicsSystem(*world); //never stepped, but the world adds every object to it
+	NavigationGrid* maze = new NavigationGrid("CornMaze.txt", Vector3(-175, -20, -175));
+	world->AddMaze(maze);
+
+	std::vector<Vector3> openNodes;
+	for (const GridNode& n : maze->GetNodes()) {
+		if (n.type != 'x') {
+			openNodes.push_back(n.position);
+		}
+	}
+	std::mt19937 rng(1);
+	std::vector<GameObject*> goats;
+	for (int i = 0; i < GOOSE_GOATS; ++i) {
+		GameObject* goat = new GameObject("Goat");
+		goat->GetTransform().SetPosition(openNodes[rng() % openNodes.size()]);
+		world->AddGoat(goat);
+		goats.push_back(goat);
+	}
+
+	BehaviourBatch<Goose>* batch = new BehaviourBatch<Goose>(Goose::GetBehaviourTable());
+
+	// Everything a goose allocates on its way in, including itself and its share of the batch
+	unsigned long long startAllocations	= allocationCount.load();
+	unsigned long long startBytes		= allocationBytes.load();
+	std::vector<Goose*> geese;
+	geese.reserve(gooseCount);
+	for (int i = 0; i < gooseCount; ++i) {
+		Goose* goose = new Goose(world, *batch);
+		goose->GetTransform().SetPosition(openNodes[rng() % openNodes.size()]);
+		geese.push_back(goose);
+	}
+	double addAllocations	= (double)(allocationCount.load() - startAllocations) / gooseCount;
+	double addBytes			= (double)(allocationBytes.load() - startBytes) / gooseCount;
+	for (Goose* goose : geese) {
+		world->AddGameObject(goose);
+	}
+
+	AICommandBuffer commands;
+	auto tickGeese = [&]() {
+		for (Goose* goose : geese) {
+			goose->Execute(dt, commands);
+		}
+		commands.Clear();
+	};
+
+	// Lets every goose's first path searches through before measuring, or most of them would only be waiting on them
+	PathRequestService* requests = world->GetPathRequests();
+	int searchBudget = requests->GetSearchBudget();
+	requests->SetSearchBudget(gooseCount * GOOSE_GOATS);
+	int warmupFrames = 0;
+	do {
+		world->UpdateWorld(dt);
+		tickGeese();
+		warmupFrames++;
+	} while (requests->GetQueuedCount() > 0 && warmupFrames < 100);
+	requests->SetSearchBudget(searchBudget);
+
+	double gooseMS = 0.0;
+	double worldMS = 0.0;
+	unsigned long long gooseAllocations = 0;
+	for (int f = 0; f < frames; ++f) {
+		if (goatStep > 0 && f % goatStep == 0) {
+			for (GameObject* goat : goats) {
+				StepGoat(goat, *maze, rng);
+			}
+		}
+		Clock::time_point start = Clock::now();
+		world->UpdateWorld(dt);
+		Clock::time_point worldDone = Clock::now();
+
+		unsigned long long frameAllocations = allocationCount.load();
+		tickGeese();
+		gooseAllocations += allocationCount.load() - frameAllocations;
+
+		worldMS += std::chrono::duration<double, std::milli>(worldDone - start).count();
+		gooseMS += std::chrono::duration<double, std::milli>(Clock::now() - worldDone).count();
+	}
+	gooseMS /= frames;
+	worldMS /= frames;
+
+	std::printf("Geese: %d geese, %d goats, %d frames after %d to warm up\n", gooseCount, GOOSE_GOATS, frames, warmupFrames);
+	if (goatStep > 0) {
+		std::printf("Goats step to a neighbouring node every %d frames\n", goatStep);
+	}
+	std::printf("\n");
+	std::printf("Memory per goose\n");
+	std::printf("  %-24s %8zu bytes\n", "Goose object", sizeof(Goose));
+	std::printf("  %-24s %8.1f bytes, %d nodes\n", "Tree state in the batch",
+		(double)batch->GetMemoryUsage() / gooseCount, batch->GetTable().GetNodeCount());
+	std::printf("  %-24s %8.1f bytes in %.1f allocations\n\n", "Heap while adding", addBytes, addAllocations);
+
+	std::printf("%-16s %10s %14s %14s\n", "", "ms/frame", "ns/goose", "allocs/frame");
+	std::printf("%-16s %10.3f %14.1f %14.1f\n", "Geese", gooseMS, gooseMS * 1.0e6 / gooseCount, (double)gooseAllocations / frames);
+	std::printf("%-16s %10.3f %14s %14s\n", "World update", worldMS, "-", "-");
+	std::printf("\n%.2f million goose ticks a second, %d of them chasing a goat\n", gooseCount / (gooseMS * 1000.0), CountChasing(geese));
+
+	world->ClearAndErase();
+	delete batch;
+	delete physics;
+	delete world;
+	return 0;
+}
@@ -0,0 +1,593 @@
+#include "GameWorld.h"
+#include "PhysicsSystem.h"
+#include "PhysicsObject.h"
+#include "AABBVolume.h"
+#include "AIScheduler.h"
+#include "JobSystem.h"
+#include "RenderObject.h"
+#include "NetworkObject.h"
+#include "Debug.h"
+
+#include "StateGameObject.h"
+#include "BehaviourTreeObject.h"
+
+#include "Scenarios.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <random>
+#include <stdexcept>
+#include <thread>
+
+using namespace NCL;
+using namespace CSC8503;
+
+/*
+Runs the maze's AI without a window or renderer, for a fixed number of
+ticks, and reports what it cost - so it can be measured, and compared
+between commits, without watching the frame rate of the game.
+
+	AIBenchmark [civilians] [geese] [goats] [ticks] [workers] [lines] [pipelined]
+
+lines is the Debug::LineCategory mask to draw with, everything by default
+and 0 for no debug lines at all.
+
+With pipelined set to 1 (and at least one worker), each tick ends the way
+TutorialGame's frame does: the world is captured into a snapshot, physics
+steps on a worker, and meanwhile the main thread reads the snapshot the way
+the renderer and NetworkedGame would - every agent is given a RenderObject
+and NetworkObject for it to find. That's the build to run under
+-fsanitize=thread, to check nothing the physics step touches is being read
+alongside it:
+
+	cmake -S . -B tsan -DCMAKE_CXX_FLAGS=-fsanitize=thread -DCMAKE_EXE_LINKER_FLAGS=-fsanitize=thread
+	cmake --build tsan --target AIBenchmark && ./tsan/AIBenchmark/AIBenchmark 100 10 2 600 4 0xff 1
+
+Goats aren't player controlled here, they walk loops between a few
+fixed points in the maze. Everything is seeded, the physics keeps a fixed
+rate, and the AI's budget is big enough that every agent that's due gets
+to think, so two runs with the same settings and no workers end up in the
+same place. The checksum at the end is there to check exactly that. With
+workers, path searches come back whenever they finish, so it can differ.
+
+	AIBenchmark scaling [civilians] [ticks] [maxWorkers]
+
+runs the same maze once with no workers, then again with 1, 2, 4... up to
+maxWorkers (one per hardware thread by default), and prints how the
+civilians and the whole frame scale. Only the civilians run on the
+workers - there are 10 geese and 2 goats too, so the frame is still the
+game's, but the rest of it doesn't get any faster.
+
+The rest of the scenarios are listed in Scenarios.h.
+*/
+
+// Every allocation the program makes is counted, from whichever thread makes it
+std::atomic<unsigned long long> allocationCount = 0;
+std::atomic<unsigned long long> allocationBytes = 0;
+
+void* operator new(size_t size) {
+	allocationCount.fetch_add(1, std::memory_order_relaxed);
+	allocationBytes.fetch_add(size, std::memory_order_relaxed);
+	if (void* p = std::malloc(size ? size : 1)) {
+		return p;
+	}
+	throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) {
+	return operator new(size);
+}
+
+void operator delete(void* p) noexcept {
+	std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+	std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+	std::free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+	std::free(p);
+}
+
+const float	BENCHMARK_DT	= 1.0f / 60.0f;
+const float	GOAT_SPEED		= 15.0f;
+const int	GOAT_WAYPOINTS	= 4;
+
+typedef std::chrono::high_resolution_clock Clock;
+
+// Adds up how long something took, and how many allocations it made, across every tick
+struct PhaseCost {
+	double				ms			= 0.0;
+	unsigned long long	allocations	= 0;
+
+	template <typename F>
+	void Measure(F&& func) {
+		unsigned long long startAllocations = allocationCount.load(std::memory_order_relaxed);
+		Clock::time_point start = Clock::now();
+		func();
+		ms			+= std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+		allocations	+= allocationCount.load(std::memory_order_relaxed) - startAllocations;
+	}
+};
+
+struct ScriptedGoat {
+	GameObject*				object;
+	std::vector<Vector3>	route;
+	int						next;
+};
+
+class AIBenchmark {
+public:
+	AIBenchmark(int civilianCount, int gooseCount, int goatCount, int workers, bool pipelined) {
+		jobs		= workers > 0 ? new JobSystem(workers) : nullptr;
+		this->pipelined = pipelined && jobs;
+		world		= new GameWorld();
+		physics		= new PhysicsSystem(*world);
+		physics->UseFixedRate(true);
+		world->SetJobSystem(jobs);
+
+		civilianAI	= new AIScheduler(*world);
+		gooseAI		= new AIScheduler(*world);
+		gooseBatch	= new BehaviourBatch<Goose>(Goose::GetBehaviourTable());
+		for (AIScheduler* s : { civilianAI, gooseAI }) {
+			s->SetJobSystem(jobs);
+			s->SetBudget(1000.0f); //nobody gets deferred just because the machine is slow
+		}
+
+		srand(1);
+		rng.seed(1);
+
+		AddFloor();
+		AddMaze("CornMaze.txt", Vector3(-175, -20, -175));
+		for (int i = 0; i < goatCount; ++i) {
+			AddGoat();
+		}
+		for (int i = 0; i < civilianCount; ++i) {
+			AddCivilian(RandomOpenPosition(Vector3(0.3f, 0.9f, 0.3f) * 3.0f) + Vector3(0, 15, 0));
+		}
+		for (int i = 0; i < gooseCount; ++i) {
+			AddGoose(RandomOpenPosition(Vector3(0.3f, 0.9f, 0.3f) * 1.5f) + Vector3(0, 10, 0));
+		}
+	}
+
+	~AIBenchmark() {
+		delete civilianAI;
+		delete gooseAI;
+		world->ClearAndErase();
+		delete gooseBatch;
+		delete physics;
+		delete world;
+		delete jobs;
+	}
+
+	// The same order as TutorialGame::UpdateGame, with the goats moving first in place of the player
+	void Tick(float dt) {
+		MoveGoats(dt);
+
+		civilianCost.Measure([&]() { civilianAI->Update(dt); });
+		gooseCost.Measure([&]() { gooseAI->Update(dt); });
+		worldCost.Measure([&]() { world->UpdateWorld(dt); });
+		if (pipelined) {
+			PipelinedTick(dt);
+			return;
+		}
+		physicsCost.Measure([&]() {
+			physics->Update(dt);
+			physics->DispatchCollisionEvents();
+		});
+		debugCost.Measure([&]() {
+			debugLines += Debug::GetDebugLines().size(); //where the renderer would pick them up
+			Debug::UpdateRenderables(dt);
+		});
+	}
+
+	/*
+	Physics overlaps the snapshot readers and debug lines here, so they're
+	all counted together as the physics phase - the frame is only as long
+	as the slower side.
+	*/
+	void PipelinedTick(float dt) {
+		physicsCost.Measure([&]() {
+			world->CaptureSnapshot();
+
+			JobCounter physicsDone;
+			jobs->Run([&]() {
+				physics->Update(dt);
+			}, &physicsDone);
+
+			ReadSnapshot();
+			debugLines += Debug::GetDebugLines().size();
+			Debug::UpdateRenderables(dt);
+
+			jobs->Wait(physicsDone);
+			physics->DispatchCollisionEvents();
+		});
+	}
+
+	const PhaseCost& GetCivilianCost() const {
+		return civilianCost;
+	}
+
+	PhaseCost GetFrameCost() const {
+		PhaseCost total;
+		for (const PhaseCost* c : { &civilianCost, &gooseCost, &worldCost, &physicsCost, &debugCost }) {
+			total.ms			+= c->ms;
+			total.allocations	+= c->allocations;
+		}
+		return total;
+	}
+
+	void Report(int ticks) const {
+		int civilianCount	= (int)civilians.size();
+		int gooseCount		= (int)geese.size();
+
+		std::printf("AI benchmark: %d civilians, %d geese, %d goats, %d ticks, %d workers%s\n\n",
+			civilianCount, gooseCount, (int)goats.size(), ticks, jobs ? (int)jobs->GetWorkerCount() : 0,
+			pipelined ? ", pipelined" : "");
+
+		std::printf("%-16s %10s %14s %14s\n", "", "ms/tick", "us/agent/tick", "allocs/tick");
+		ReportPhase("Civilians", civilianCost, ticks, civilianCount);
+		ReportPhase("Geese", gooseCost, ticks, gooseCount);
+		ReportPhase("World update", worldCost, ticks, 0);
+		ReportPhase(pipelined ? "Physics + render" : "Physics", physicsCost, ticks, 0);
+		if (!pipelined) {
+			ReportPhase("Debug lines", debugCost, ticks, 0);
+		}
+
+		ReportPhase("Frame", GetFrameCost(), ticks, 0);
+
+		std::printf("\nRaycasts: %u against objects, %u maze sight lines, %u distance field rays\n",
+			world->GetRaycastCount(),
+			world->GetMazeVisibility()->GetSightLineCount(),
+			world->GetMazeDistances()->GetRayCount());
+		std::printf("Path requests: %d, of which %d searched\n",
+			world->GetPathRequests()->GetRequestCount(), world->GetPathRequests()->GetSearchCount());
+		std::printf("Debug lines: %.1f per tick\n", (double)debugLines / ticks);
+		std::printf("Allocations: %llu in total while ticking\n\n", allocationCount.load() - setupAllocations);
+		if (pipelined) {
+			std::printf("Snapshot: %llu objects drawn and %llu packets sent in total\n", snapshotObjects, snapshotPackets);
+		}
+		std::printf("Checksum: %016llx\n", Checksum());
+	}
+
+	void StartMeasuring() {
+		setupAllocations = allocationCount.load();
+	}
+
+protected:
+	/*
+	Stands in for the renderer and NetworkedGame::BroadcastSnapshot, while
+	physics is running - so only the snapshot is read, never the objects.
+	*/
+	void ReadSnapshot() {
+		const WorldSnapshot& snapshot = world->GetSnapshot();
+		int stateID = snapshot.GetWorldStateID();
+		for (const ObjectSnapshot& s : snapshot.GetObjects()) {
+			if (s.renderObject) {
+				snapshotObjects++;
+			}
+			if (!s.networkObject) {
+				continue;
+			}
+			GamePacket* packet = nullptr;
+			if (s.networkObject->WritePacket(&packet, false, stateID, s)) {
+				snapshotPackets++;
+				delete packet;
+			}
+			s.networkObject->UpdateStateHistory(stateID);
+		}
+	}
+
+	// Nothing to draw with, but the snapshot only keeps objects that would be drawn or sent
+	void AddSnapshotParts(GameObject* object) {
+		if (!pipelined) {
+			return;
+		}
+		object->SetRenderObject(new RenderObject(&object->GetTransform(), nullptr, nullptr, nullptr));
+		new NetworkObject(object, nextNetworkID++);
+	}
+
+	static void ReportPhase(const char* name, const PhaseCost& cost, int ticks, int agents) {
+		double ms = cost.ms / ticks;
+		if (agents > 0) {
+			std::printf("%-16s %10.3f %14.2f %14.1f\n", name, ms, ms * 1000.0 / agents, (double)cost.allocations / ticks);
+		}
+		else {
+			std::printf("%-16s %10.3f %14s %14.1f\n", name, ms, "-", (double)cost.allocations / ticks);
+		}
+	}
+
+	// Where every agent has got to, so runs can be compared
+	unsigned long long Checksum() const {
+		unsigned long long hash = 14695981039346656037ull;
+		auto add = [&](const Vector3& v) {
+			unsigned int bits[3];
+			std::memcpy(bits, &v, sizeof(bits));
+			for (unsigned int b : bits) {
+				hash = (hash ^ b) * 1099511628211ull;
+			}
+		};
+		for (GameObject* o : civilians) {
+			add(o->GetTransform().GetPosition());
+		}
+		for (GameObject* o : geese) {
+			add(o->GetTransform().GetPosition());
+		}
+		return hash;
+	}
+
+	Vector3 RandomOpenPosition(const Vector3& halfSize) {
+		NavigationGrid* maze = world->GetMaze();
+		float nodeSize = (float)maze->GetNodeSize();
+		std::uniform_real_distribution<float> x(0.0f, maze->GetWidth() * nodeSize);
+		std::uniform_real_distribution<float> z(0.0f, maze->GetHeight() * nodeSize);
+		while (true) {
+			Vector3 position = maze->GetZeroPos() + Vector3(x(rng), 0, z(rng));
+			if (maze->FullyWithinOpenNodes(position, halfSize)) {
+				return position;
+			}
+		}
+	}
+
+	void AddFloor() {
+		Vector3 floorSize(200, 2, 200);
+		GameObject* floor = new GameObject("Floor");
+		floor->SetBoundingVolume((CollisionVolume*)new AABBVolume(floorSize));
+		floor->GetTransform()
+			.SetScale(floorSize * 2)
+			.SetPosition(Vector3(0, -20, 0));
+		floor->SetPhysicsObject(new PhysicsObject(&floor->GetTransform(), floor->GetBoundingVolume(), true));
+		floor->GetPhysicsObject()->SetInverseMass(0);
+		floor->GetPhysicsObject()->InitCubeInertia();
+		world->AddGameObject(floor);
+	}
+
+	void AddMaze(const std::string& fileName, const Vector3& zeroPos) {
+		NavigationGrid* maze = new NavigationGrid(fileName, zeroPos);
+		float nodeSize = (float)maze->GetNodeSize();
+		Vector3 dimensions(nodeSize / 2, 10.0f, nodeSize / 2);
+
+		for (const GridNode& n : maze->GetNodes()) {
+			if (n.type != 'x') {
+				continue;
+			}
+			GameObject* hedge = new GameObject("Hedge");
+			hedge->SetBoundingVolume((CollisionVolume*)new AABBVolume(dimensions));
+			hedge->GetTransform()
+				.SetPosition(n.position + Vector3(0, 10.0f, 0))
+				.SetScale(dimensions * 2);
+			hedge->SetPhysicsObject(new PhysicsObject(&hedge->GetTransform(), hedge->GetBoundingVolume()));
+			hedge->GetPhysicsObject()->SetInverseMass(0);
+			hedge->GetPhysicsObject()->InitCubeInertia();
+			world->AddGameObject(hedge);
+		}
+		world->AddMaze(maze);
+	}
+
+	// As TutorialGame::AddCivilianToWorld, without anything to draw it with
+	void AddCivilian(const Vector3& position) {
+		float meshSize = 3.0f;
+
+		Civilian* civilian = new Civilian("Civilian", world);
+		civilian->SetBoundingVolume((CollisionVolume*)new AABBVolume(Vector3(0.3f, 0.9f, 0.3f) * meshSize));
+		civilian->GetTransform()
+			.SetScale(Vector3(meshSize, meshSize, meshSize))
+			.SetPosition(position)
+			.SetOrientation(Quaternion::EulerAnglesToQuaternion(0, (float)(rng() % 360), 0));
+		civilian->SetPhysicsObject(new PhysicsObject(&civilian->GetTransform(), civilian->GetBoundingVolume()));
+		civilian->GetPhysicsObject()->SetInverseMass(4.0f);
+		civilian->GetPhysicsObject()->InitSphereInertia();
+		civilian->setCRest(0.5f);
+		civilian->setCFric(0.5f);
+
+		AddSnapshotParts(civilian);
+
+		world->AddGameObject(civilian);
+		world->GetCrowd().AddAgent(civilian, 0.3f * meshSize * 1.414f, 5.0f);
+		world->GetCivilianDensity()->AddSource(civilian);
+
+		civilians.push_back(civilian);
+		civilianAI->AddAgent(civilian, [civilian](float dt, AICommandBuffer& commands) { civilian->Update(dt, commands); }, true);
+	}
+
+	// As TutorialGame::AddGooseToWorld
+	void AddGoose(const Vector3& position) {
+		float meshSize = 1.5f;
+
+		Goose* goose = new Goose(world, *gooseBatch);
+		goose->SetBoundingVolume((CollisionVolume*)new AABBVolume(Vector3(0.3f, 0.9f, 0.3f) * meshSize));
+		goose->GetTransform()
+			.SetScale(Vector3(meshSize, meshSize, meshSize))
+			.SetPosition(position);
+		goose->SetPhysicsObject(new PhysicsObject(&goose->GetTransform(), goose->GetBoundingVolume()));
+		goose->GetPhysicsObject()->SetInverseMass(1.5f);
+		goose->GetPhysicsObject()->InitSphereInertia();
+		goose->setCRest(0.5f);
+		goose->setCFric(0.5f);
+
+		AddSnapshotParts(goose);
+
+		world->AddGameObject(goose);
+		world->GetPerception().AddSource(goose, StimulusType::Goose);
+		world->GetCrowd().AddAgent(goose, 0.3f * meshSize * 1.414f, 10.0f);
+
+		geese.push_back(goose);
+		gooseAI->AddAgent(goose, [goose](float dt, AICommandBuffer& commands) { goose->Execute(dt, commands); });
+	}
+
+	/*
+	Each goat walks a loop through a few open nodes, following the maze's
+	own paths between them. The paths are all found up front, so they
+	don't count towards the path searches.
+	*/
+	void AddGoat() {
+		NavigationGrid* maze = world->GetMaze();
+		Vector3 halfSize = Vector3(0.3f, 0.9f, 0.3f) * 2.0f;
+
+		std::vector<Vector3> points;
+		for (int i = 0; i < GOAT_WAYPOINTS; ++i) {
+			points.push_back(RandomOpenPosition(halfSize));
+		}
+		ScriptedGoat goat;
+		for (int i = 0; i < GOAT_WAYPOINTS; ++i) {
+			NavigationPath path;
+			if (!maze->FindPath(points[i], points[(i + 1) % GOAT_WAYPOINTS], path)) {
+				goat.route.push_back(points[i]);
+				continue;
+			}
+			Vector3 waypoint;
+			while (path.PopWaypoint(waypoint)) {
+				goat.route.push_back(waypoint);
+			}
+		}
+		goat.next = 0;
+
+		goat.object = new GameObject("Goat");
+		goat.object->SetBoundingVolume((CollisionVolume*)new AABBVolume(halfSize));
+		goat.object->GetTransform()
+			.SetScale(Vector3(2, 2, 2))
+			.SetPosition(goat.route[0]);
+		goat.object->SetPhysicsObject(new PhysicsObject(&goat.object->GetTransform(), goat.object->GetBoundingVolume()));
+		goat.object->GetPhysicsObject()->SetInverseMass(3.0f);
+		goat.object->GetPhysicsObject()->InitSphereInertia();
+
+		world->AddGoat(goat.object);
+		goats.push_back(goat);
+	}
+
+	// Goats are moved straight to where they should be, whatever the physics did with them
+	void MoveGoats(float dt) {
+		for (ScriptedGoat& goat : goats) {
+			Vector3 position	= goat.object->GetTransform().GetPosition();
+			float step			= GOAT_SPEED * dt;
+			while (step > 0.0f) {
+				Vector3 target	= goat.route[goat.next];
+				target.y		= position.y;
+				Vector3 offset	= target - position;
+				float distance	= offset.Length();
+				if (distance > step) {
+					position += offset * (step / distance);
+					break;
+				}
+				position	= target;
+				step		-= distance;
+				goat.next	= (goat.next + 1) % (int)goat.route.size();
+				if (goat.route.size() == 1) {
+					break;
+				}
+			}
+			goat.object->GetTransform().SetPosition(position);
+			goat.object->GetPhysicsObject()->SetLinearVelocity(Vector3());
+		}
+	}
+
+	JobSystem*		jobs;
+	GameWorld*		world;
+	PhysicsSystem*	physics;
+	AIScheduler*	civilianAI;
+	AIScheduler*	gooseAI;
+	BehaviourBatch<Goose>*	gooseBatch;
+	std::mt19937	rng;
+	bool			pipelined;
+	int				nextNetworkID = 0;
+
+	std::vector<Civilian*>		civilians;
+	std::vector<Goose*>			geese;
+	std::vector<ScriptedGoat>	goats;
+
+	PhaseCost civilianCost;
+	PhaseCost gooseCost;
+	PhaseCost worldCost;
+	PhaseCost physicsCost;
+	PhaseCost debugCost;
+	unsigned long long debugLines		= 0;
+	unsigned long long setupAllocations	= 0;
+	unsigned long long snapshotObjects	= 0;
+	unsigned long long snapshotPackets	= 0;
+};
+
+// Every run gets an identical maze, so the only thing changing between rows is the worker count
+static int ScalingScenario(int argc, char** argv) {
+	int civilians	= argc > 0 ? std::atoi(argv[0]) : 500;
+	int ticks		= argc > 1 ? std::atoi(argv[1]) : 300;
+	int maxWorkers	= argc > 2 ? std::atoi(argv[2]) : (int)std::thread::hardware_concurrency();
+
+	std::vector<int> workerCounts = { 0 };
+	for (int w = 1; w < maxWorkers; w *= 2) {
+		workerCounts.push_back(w);
+	}
+	if (maxWorkers > 0) {
+		workerCounts.push_back(maxWorkers);
+	}
+
+	std::printf("Scaling: %d civilians, 10 geese, 2 goats, %d ticks, %u hardware threads\n\n",
+		civilians, ticks, std::thread::hardware_concurrency());
+	std::printf("%8s %14s %10s %14s %10s\n", "workers", "civilians ms", "speedup", "frame ms", "speedup");
+
+	double serialCivilians	= 0.0;
+	double serialFrame		= 0.0;
+	for (int workers : workerCounts) {
+		AIBenchmark benchmark(civilians, 10, 2, workers, false);
+		benchmark.StartMeasuring();
+		for (int i = 0; i < ticks; ++i) {
+			benchmark.Tick(BENCHMARK_DT);
+		}
+		double civilianMS	= benchmark.GetCivilianCost().ms / ticks;
+		double frameMS		= benchmark.GetFrameCost().ms / ticks;
+		if (workers == 0) {
+			serialCivilians	= civilianMS;
+			serialFrame		= frameMS;
+		}
+		std::printf("%8d %14.3f %9.2fx %14.3f %9.2fx\n", workers,
+			civilianMS, serialCivilians / civilianMS, frameMS, serialFrame / frameMS);
+	}
+	return 0;
+}
+
+int main(int argc, char** argv) {
+	// Every scenario loads a maze, which throws if it's a damaged binary one
+	try {
+		if (argc > 1 && std::strcmp(argv[1], "scaling") == 0) {
+			return ScalingScenario(argc - 2, argv + 2);
+		}
+		if (argc > 1 && std::strcmp(argv[1], "statemachines") == 0) {
+			return StateMachineScenario(argc - 2, argv + 2);
+		}
+		if (argc > 1 && std::strcmp(argv[1], "geese") == 0) {
+			return GooseScenario(argc - 2, argv + 2);
+		}
+		if (argc > 1 && std::strcmp(argv[1], "paths") == 0) {
+			return PathScenario(argc - 2, argv + 2);
+		}
+
+		int civilians	= argc > 1 ? std::atoi(argv[1]) : 100;
+		int geese		= argc > 2 ? std::atoi(argv[2]) : 10;
+		int goats		= argc > 3 ? std::atoi(argv[3]) : 2;
+		int ticks		= argc > 4 ? std::atoi(argv[4]) : 1200;
+		int workers		= argc > 5 ? std::atoi(argv[5]) : 0;
+
+		bool pipelined	= argc > 7 ? std::atoi(argv[7]) != 0 : false;
+
+		Debug::SetLinesEnabled(argc > 6 ? (unsigned int)std::strtoul(argv[6], nullptr, 0) : Debug::AllLines);
+
+		AIBenchmark benchmark(civilians, geese, goats, workers, pipelined);
+		benchmark.StartMeasuring();
+		for (int i = 0; i < ticks; ++i) {
+			benchmark.Tick(BENCHMARK_DT);
+		}
+		benchmark.Report(ticks);
+		return 0;
+	}
+	catch (std::runtime_error& e) {
+		std::fprintf(stderr, "%s\n", e.what());
+		return 1;
+	}
+}
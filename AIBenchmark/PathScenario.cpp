@@ -0,0 +1,143 @@
+#include "Scenarios.h"
+#include "NavigationGrid.h"
+#include "NavigationPath.h"
+#include "NavigationData.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+
+using namespace NCL;
+using namespace NCL::Maths;
+using namespace CSC8503;
+
+/*
+Times NavigationGrid::FindPath, with both search modes, on the game's
+maze and on two made up 1024x1024 grids - one with a quarter of its nodes
+walled in at random, and one of long walls with a single gap at
+alternate ends, so every path has to snake back and forth across it.
+The queries are between random open nodes, seeded, so every run asks the
+same questions.
+*/
+
+namespace {
+	typedef std::chrono::high_resolution_clock Clock;
+
+	const int SYNTHETIC_SIZE = 1024;
+
+	struct PathStats {
+		double	ms			= 0.0;
+		int		found		= 0;
+		double	waypoints	= 0.0;
+		double	expanded	= 0.0;
+	};
+
+	typedef std::vector<std::pair<int, int>> PathQueries;
+
+	PathQueries MakeQueries(const NavigationGrid& grid, int count, unsigned int seed) {
+		std::vector<int> openNodes;
+		std::span<const GridNode> nodes = grid.GetNodes();
+		for (int i = 0; i < (int)nodes.size(); ++i) {
+			if (nodes[i].type != 'x') {
+				openNodes.push_back(i);
+			}
+		}
+		std::mt19937 rng(seed);
+		PathQueries queries;
+		for (int i = 0; i < count; ++i) {
+			queries.push_back({ openNodes[rng() % openNodes.size()], openNodes[rng() % openNodes.size()] });
+		}
+		return queries;
+	}
+
+	PathStats RunQueries(NavigationGrid& grid, GridSearchMode mode, const PathQueries& queries) {
+		grid.SetSearchMode(mode);
+		GridSearch search;
+		PathStats stats;
+		for (const auto& q : queries) {
+			NavigationPath path;
+			Clock::time_point start = Clock::now();
+			bool found = grid.FindPath(grid.GetNodePosition(q.first), grid.GetNodePosition(q.second), path, search);
+			stats.ms += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+			if (!found) {
+				continue;
+			}
+			stats.found++;
+			stats.expanded += search.GetExpandedCount();
+			Vector3 waypoint;
+			while (path.PopWaypoint(waypoint)) {
+				stats.waypoints++;
+			}
+		}
+		stats.ms /= queries.size();
+		if (stats.found > 0) {
+			stats.waypoints	/= stats.found;
+			stats.expanded	/= stats.found;
+		}
+		return stats;
+	}
+
+	void ReportGrid(const char* name, NavigationGrid& grid, int queryCount) {
+		PathQueries queries = MakeQueries(grid, queryCount, 1);
+		std::printf("%s, %dx%d, %d queries\n", name, grid.GetWidth(), grid.GetHeight(), queryCount);
+		std::printf("  %-12s %12s %10s %12s %12s\n", "", "ms/query", "found", "waypoints", "expanded");
+		for (GridSearchMode mode : { GridSearchMode::AStar, GridSearchMode::JumpPoint }) {
+			PathStats stats = RunQueries(grid, mode, queries);
+			std::printf("  %-12s %12.4f %10d %12.1f %12.1f\n", mode == GridSearchMode::AStar ? "A*" : "Jump point",
+				stats.ms, stats.found, stats.waypoints, stats.expanded);
+		}
+		std::printf("\n");
+	}
+
+	// Made up grids are put together as binary grid data in memory, so nothing is written to disk
+	template <typename F>
+	NavigationGrid* MakeGrid(F&& isWall) {
+		NavDataHeader header;
+		memcpy(header.magic, NAV_GRID_MAGIC, 4);
+		header.version = NAV_DATA_VERSION;
+
+		NavGridInfo info;
+		info.nodeSize	= 1;
+		info.width		= SYNTHETIC_SIZE;
+		info.height		= SYNTHETIC_SIZE;
+
+		std::vector<char> data(sizeof(header) + sizeof(info) + (size_t)SYNTHETIC_SIZE * SYNTHETIC_SIZE);
+		memcpy(data.data(), &header, sizeof(header));
+		memcpy(data.data() + sizeof(header), &info, sizeof(info));
+		char* types = data.data() + sizeof(header) + sizeof(info);
+		for (int z = 0; z < SYNTHETIC_SIZE; ++z) {
+			for (int x = 0; x < SYNTHETIC_SIZE; ++x) {
+				types[(z * SYNTHETIC_SIZE) + x] = isWall(x, z) ? 'x' : '.';
+			}
+		}
+		return new NavigationGrid(data.data(), data.size());
+	}
+}
+
+int PathScenario(int argc, char** argv) {
+	int mazeQueries		= argc > 0 ? std::atoi(argv[0]) : 2000;
+	int syntheticQueries	= argc > 1 ? std::atoi(argv[1]) : 20;
+
+	NavigationGrid maze("CornMaze.txt");
+	ReportGrid("CornMaze.txt", maze, mazeQueries);
+
+	std::mt19937 rng(1);
+	NavigationGrid* scattered = MakeGrid([&](int, int) {
+		return rng() % 4 == 0;
+	});
+	ReportGrid("Scattered walls", *scattered, syntheticQueries);
+	delete scattered;
+
+	NavigationGrid* snaking = MakeGrid([](int x, int z) {
+		if (z % 8 != 7) {
+			return false;
+		}
+		int gap = (z / 8) % 2 == 0 ? SYNTHETIC_SIZE - 1 : 0;
+		return x != gap;
+	});
+	ReportGrid("Snaking walls", *snaking, syntheticQueries);
+	delete snaking;
+	return 0;
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include <atomic>
+
+/*
+Scenarios that measure one part of the AI on its own, away from the maze.
+Each is run as AIBenchmark <name> [arguments...], is handed the arguments
+after its name, and returns the program's exit code.
+*/
+
+// Every allocation the program makes, and how many bytes were asked for, counted by Main.cpp's operator new
+extern std::atomic<unsigned long long> allocationCount;
+extern std::atomic<unsigned long long> allocationBytes;
+
+// statemachines [agents] [frames]
+int StateMachineScenario(int argc, char** argv);
+
+// geese [geese] [frames] [goatStep]
+int GooseScenario(int argc, char** argv);
+
+// paths [mazeQueries] [syntheticQueries]
+int PathScenario(int argc, char** argv);
@@ -0,0 +1,196 @@
+#include "Scenarios.h"
+#include "StateMachine.h"
+#include "StateTable.h"
+#include "Vector3.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace NCL;
+using namespace NCL::Maths;
+using namespace CSC8503;
+
+/*
+Thousands of MagicBall-style agents - the same six states and eighteen
+transitions - each run once with their own StateMachine, and once from a
+single shared StateTable. The balls don't need a world, they just push
+themselves around with their own forces, so all that's being measured is
+the machines plus a few lines of movement.
+
+Both sets start from the same places and should end up in the same places,
+as both take the first transition that passes.
+*/
+
+namespace {
+	typedef std::chrono::high_resolution_clock Clock;
+
+	struct Ball {
+		Vector3			position;
+		Vector3			startPos;
+		Vector3			force;
+		int				state = 0;	// Only used by the StateTable
+		unsigned int	seed;
+
+		float Random() {
+			seed = seed * 1664525u + 1013904223u;
+			return ((seed >> 8) & 0xffff) / 65535.0f - 0.5f;
+		}
+
+		void MoveLeft(float)	{ force.x -= 10.0f; }
+		void MoveRight(float)	{ force.x += 10.0f; }
+		void MoveForward(float)	{ force.z -= 10.0f; }
+		void MoveBack(float)	{ force.z += 10.0f; }
+
+		// Something has to knock them back level with the start now and again, or the level transitions never pass
+		void Step(float dt) {
+			position += force * dt * 0.1f + Vector3(Random(), 0, Random());
+			if (Random() > 0.45f) {
+				position.z = startPos.z;
+			}
+			force = Vector3();
+		}
+	};
+
+	bool LeftOfStart(Ball& b)		{ return b.position.x < b.startPos.x; }
+	bool RightOfStart(Ball& b)		{ return b.position.x > b.startPos.x; }
+	bool BehindStart(Ball& b)		{ return b.position.z > b.startPos.z; }
+	bool InFrontOfStart(Ball& b)	{ return b.position.z < b.startPos.z; }
+	bool LevelWithStart(Ball& b)	{ return b.position.z == b.startPos.z; }
+
+	enum BallState { L, LF, LB, R, RF, RB, StateCount };
+
+	struct BallTransition {
+		BallState	from;
+		BallState	to;
+		bool		(*guard)(Ball&);
+	};
+
+	// MagicBall's transitions, in the order it adds them
+	const BallTransition ballTransitions[] = {
+		{ L, R, LeftOfStart },		{ L, LF, BehindStart },		{ L, LB, InFrontOfStart },
+		{ LF, L, LevelWithStart },	{ LF, LB, InFrontOfStart },	{ LF, RF, LeftOfStart },
+		{ LB, L, LevelWithStart },	{ LB, LF, BehindStart },	{ LB, RB, LeftOfStart },
+		{ R, L, RightOfStart },		{ R, RF, BehindStart },		{ R, RB, InFrontOfStart },
+		{ RF, R, LevelWithStart },	{ RF, RB, InFrontOfStart },	{ RF, LF, RightOfStart },
+		{ RB, R, LevelWithStart },	{ RB, RF, BehindStart },	{ RB, LB, RightOfStart },
+	};
+
+	void MoveInState(Ball& b, int state, float dt) {
+		if (state < R) {
+			b.MoveLeft(dt);
+		}
+		else {
+			b.MoveRight(dt);
+		}
+		if (state == LF || state == RF) {
+			b.MoveForward(dt);
+		}
+		if (state == LB || state == RB) {
+			b.MoveBack(dt);
+		}
+	}
+
+	StateMachine* BuildMachine(Ball& b) {
+		StateMachine* machine = new StateMachine();
+		State* states[StateCount];
+		for (int i = 0; i < StateCount; ++i) {
+			states[i] = new State([&b, i](float dt) { MoveInState(b, i, dt); });
+			machine->AddState(states[i]);
+		}
+		for (const BallTransition& t : ballTransitions) {
+			auto guard = t.guard;
+			machine->AddTransition(new StateTransition(states[t.from], states[t.to], [&b, guard]() { return guard(b); }));
+		}
+		return machine;
+	}
+
+	StateTable<Ball> BuildTable() {
+		StateTable<Ball> table;
+		table.AddState([](Ball& b, float dt) { MoveInState(b, L, dt); });
+		table.AddState([](Ball& b, float dt) { MoveInState(b, LF, dt); });
+		table.AddState([](Ball& b, float dt) { MoveInState(b, LB, dt); });
+		table.AddState([](Ball& b, float dt) { MoveInState(b, R, dt); });
+		table.AddState([](Ball& b, float dt) { MoveInState(b, RF, dt); });
+		table.AddState([](Ball& b, float dt) { MoveInState(b, RB, dt); });
+		for (const BallTransition& t : ballTransitions) {
+			table.AddTransition(t.from, t.to, t.guard);
+		}
+		table.Compile();
+		return table;
+	}
+
+	std::vector<Ball> MakeBalls(int count) {
+		std::vector<Ball> balls(count);
+		for (int i = 0; i < count; ++i) {
+			balls[i].seed		= i * 7919 + 1;
+			balls[i].position	= Vector3(balls[i].Random() * 20.0f, 0, balls[i].Random() * 20.0f);
+		}
+		return balls;
+	}
+
+	template <typename F>
+	double MicrosecondsPerFrame(int frames, F&& frame) {
+		Clock::time_point start = Clock::now();
+		for (int i = 0; i < frames; ++i) {
+			frame();
+		}
+		return std::chrono::duration<double, std::micro>(Clock::now() - start).count() / frames;
+	}
+}
+
+int StateMachineScenario(int argc, char** argv) {
+	int agents	= argc > 0 ? std::atoi(argv[0]) : 10000;
+	int frames	= argc > 1 ? std::atoi(argv[1]) : 200;
+	const float dt = 1.0f / 60.0f;
+
+	std::vector<Ball> machineBalls	= MakeBalls(agents);
+	std::vector<Ball> tableBalls	= MakeBalls(agents);
+
+	unsigned long long startAllocations = allocationCount.load();
+	std::vector<StateMachine*> machines;
+	machines.reserve(agents);
+	for (Ball& b : machineBalls) {
+		machines.push_back(BuildMachine(b));
+	}
+	unsigned long long machineAllocations = allocationCount.load() - startAllocations;
+
+	const StateTable<Ball> table = BuildTable();
+
+	double machineUS = MicrosecondsPerFrame(frames, [&]() {
+		for (int i = 0; i < agents; ++i) {
+			machines[i]->Update(dt);
+			machineBalls[i].Step(dt);
+		}
+	});
+	double tableUS = MicrosecondsPerFrame(frames, [&]() {
+		for (Ball& b : tableBalls) {
+			table.Update(b, b.state, dt);
+			b.Step(dt);
+		}
+	});
+	std::vector<Ball> movedBalls = MakeBalls(agents);
+	double moveUS = MicrosecondsPerFrame(frames, [&]() {
+		for (Ball& b : movedBalls) {
+			MoveInState(b, b.state, dt);
+			b.Step(dt);
+		}
+	});
+
+	int agreed = 0;
+	for (int i = 0; i < agents; ++i) {
+		agreed += machineBalls[i].position == tableBalls[i].position;
+	}
+
+	std::printf("State machines: %d MagicBall-style agents, %d frames\n\n", agents, frames);
+	std::printf("%-16s %12s %12s %16s\n", "", "us/frame", "ns/agent", "allocs/agent");
+	std::printf("%-16s %12.1f %12.1f %16.1f\n", "StateMachine", machineUS, machineUS * 1000.0 / agents, (double)machineAllocations / agents);
+	std::printf("%-16s %12.1f %12.1f %16.1f\n", "StateTable", tableUS, tableUS * 1000.0 / agents, 0.0);
+	std::printf("%-16s %12.1f %12.1f %16s\n", "Movement alone", moveUS, moveUS * 1000.0 / agents, "-");
+	std::printf("\nBoth ended in the same place for %d of %d agents\n", agreed, agents);
+
+	for (StateMachine* m : machines) {
+		delete m;
+	}
+	return agreed == agents ? 0 : 1;
+}
@@ -3,9 +3,13 @@
 #include "BehaviourNodeWithChildren.h"
 #include "BehaviourParallel.h"
 #include "BehaviourAction.h"
+#include "Blackboard.h"
+#include "BehaviourTable.h"
 #include "CollisionDetection.h"
 #include "GameWorld.h"
 #include "PhysicsObject.h"
+#include "AICommandBuffer.h"
+#include "Debug.h"
 #include <Maths.h>
 
 namespace NCL {
@@ -16,120 +20,263 @@ namespace NCL {
         public:
             BehaviourTreeObject(std::string name, GameWorld* gameWorld) : GameObject(name) {
                 this->gameWorld = gameWorld;
+                rootNode = nullptr;
+                commands = nullptr;
             }
             ~BehaviourTreeObject() {
                 delete rootNode;
             }
 
-            virtual void Execute(float dt) {
+            // Only reads the world - anything the tree does to it is recorded in commands
+            virtual void Execute(float dt, AICommandBuffer& commands) {
+                this->commands = &commands;
                 rootNode->Execute(dt);
+                this->commands = nullptr;
+            }
+
+            // Does it all straight away
+            void Execute(float dt) {
+                AICommandBuffer immediate;
+                Execute(dt, immediate);
+                immediate.Apply();
+            }
+
+            const Blackboard& GetBlackboard() const {
+                return blackboard;
             }
 
         protected:
+            Blackboard blackboard;
+            // Left null by objects that run a shared BehaviourTable instead
             BehaviourNodeWithChildren* rootNode;
             GameWorld* gameWorld;
+            // Only valid during Execute
+            AICommandBuffer* commands;
         };
 
+
+        /*
+        Picking a goat to chase is the expensive bit, as it can mean a path
+        search for every goat that's out of sight, so it's only done when the
+        goats in the maze change, or every second or so as they move about.
+        Services keep an eye on the cheap stuff, and the rest of the tree
+        waits on the blackboard keys they set.
+
+        Every goose runs the same tree, so it's built once and shared. Each
+        goose's node states and timers are kept in a BehaviourBatch along
+        with all the others', which has to outlive the geese in it.
+        */
         // Implementing in .cpp file was causing strange issues, perhaps caused by cmake? so it's just done here instead
         class Goose : public BehaviourTreeObject {
         public:
-            Goose(GameWorld* gameWorld) : BehaviourTreeObject("Goose", gameWorld) {
-                rootNode = new BehaviourParallel("Root Node");
-
-                BehaviourAction* findNearestGoat = new BehaviourAction("Find Closest Goat",
-                    [&, gameWorld](float dt, BehaviourState state) -> BehaviourState {
-                        vector<GameObject*> players = gameWorld->GetGoatsInMaze();
-                        float bestDistance = -1;
-                        GameObject* bestGoat = nullptr;
-                        Vector3 goosePosition = GetTransform().GetPosition();
-                        for (GameObject* goat : players) {
-                            // Check if goat is in sight
-                            Vector3 goatPosition = goat->GetTransform().GetPosition();
-                            Vector3 positionDifference = goatPosition - goosePosition;
-                            Ray ray = Ray(goosePosition, positionDifference.Normalised());
-                            RayCollision gooseCollision;
-                            if (gameWorld->Raycast(ray, gooseCollision, true)) {
-                                if (gooseCollision.node == goat) {
-                                    if (gooseCollision.rayDistance < bestDistance || bestDistance == -1) {
-                                        bestDistance = gooseCollision.rayDistance;
-                                        bestGoat = goat;
-                                    }
-                                    continue;
-                                }
-                            }
-                            // Otherwise use pathfinding to see how far away the goat is
-                            vector<Vector3> nodes = gameWorld->CalculatePathInMaze(goosePosition, goatPosition);
-                            if (!nodes.empty()) {
-                                float distance = (float)gameWorld->GetMaze()->GetNodeSize() * nodes.size();
-                                if (distance < bestDistance || bestDistance == -1) {
-                                    bestDistance = distance;
-                                    bestGoat = goat;
-                                }
-                            }
-                        }
-                        if (bestGoat == nullptr) {
-                            goatToChase = nullptr;
-                            return Failure;
-                        }
-                        else {
-                            goatToChase = bestGoat;
-                        }
-                        return Ongoing;
-                    });
-
-                BehaviourAction* moveToGoat = new BehaviourAction("Move to Goat",
-                    [&, gameWorld](float dt, BehaviourState state) -> BehaviourState {
-                        if (goatToChase == nullptr)
-                            return Failure;
-                        // First try and move directly to the goat
-                        Vector3 goosePosition = GetTransform().GetPosition();
-                        Vector3 goatPosition = goatToChase->GetTransform().GetPosition();
-                        Vector3 positionDifference = goatPosition - goosePosition;
-                        Ray ray = Ray(goosePosition, positionDifference.Normalised());
-                        RayCollision gooseCollision;
-
-                        if (gameWorld->Raycast(ray, gooseCollision, true))
-                            if (gooseCollision.node == goatToChase) {
-                                Debug::DrawLine(goosePosition, gooseCollision.collidedAt, Vector4(0, 1, 1, 1));
-                                MoveTowards(dt * 2.5f, gooseCollision.collidedAt);
-                                return Ongoing;
-                            }
-                        vector<Vector3> nodes = gameWorld->CalculatePathInMaze(goosePosition, goatPosition);
-                        if (!nodes.empty()) {
-                            Debug::DrawLine(goosePosition, nodes[0], Vector4(1, 1, 1, 1));
-                            for (int i = 1; i < nodes.size(); i++) {
-                                Vector3 a = nodes[i - 1];
-                                Vector3 b = nodes[i];
-
-                                Debug::DrawLine(a, b, Vector4(0, 1, 1, 1));
-                            }
-                            // Try to smooth the path taken with further nodes
-                            if (nodes.size() > 1) {
-                                Debug::DrawLine(nodes[nodes.size() - 1], goatPosition, Vector4(1, 1, 1, 1));
-                                if (nodes.size() > 2)
-                                    MoveTowards(dt, (nodes[1] + nodes[2]) / 2);
-                                else
-                                    MoveTowards(dt, nodes[1]);
-                            }
-                            else {
-                                Debug::DrawLine(nodes[0], goatPosition, Vector4(1, 1, 1, 1));
-                                MoveTowards(dt, nodes[0]);
-                            }
-                        }
-                        else {
-                            std::cout << " goat not in maze, how did we get here?\n";
-                        }
-
-
-                        return Ongoing;
-                    });
-
-                rootNode->AddChild(findNearestGoat);
-                rootNode->AddChild(moveToGoat);
+            Goose(GameWorld* gameWorld, BehaviourBatch<Goose>& batch) : BehaviourTreeObject("Goose", gameWorld), batch(batch) {
+                keys = AddKeys(blackboard);
+                batchSlot = batch.AddAgent(this);
+            }
+            ~Goose() {
+                batch.RemoveAgent(batchSlot);
+            }
+
+            using BehaviourTreeObject::Execute;
+            void Execute(float dt, AICommandBuffer& commands) override {
+                this->commands = &commands;
+                batch.Execute(batchSlot, dt);
+                this->commands = nullptr;
+            }
+
+            // The goat it's after, if any
+            GameObject* GetTarget() const {
+                return blackboard.Get(keys.target);
+            }
+
+            static const BehaviourTable<Goose>& GetBehaviourTable() {
+                static const BehaviourTable<Goose> table = []() {
+                    // Every goose adds the same keys in the same order, so these are good for all of them
+                    Blackboard layout;
+                    Keys k = AddKeys(layout);
+
+                    BehaviourTable<Goose> t;
+                    t.BeginParallel();
+                        // Picking a target - at most every half a second, and only when there's a reason to
+                        t.BeginService(0.2f, [](Goose& g, float) { g.CountGoats(); });
+                            t.BeginService(1.0f, [](Goose& g, float) {
+                                g.blackboard.Set(g.keys.retarget, g.blackboard.Get(g.keys.retarget) + 1);
+                                });
+                                t.BeginCooldown(0.5f);
+                                    t.BeginObserver({ k.goatsInMaze.index, k.retarget.index });
+                                        t.AddAction([](Goose& g, float, BehaviourState state) { return g.FindClosestGoat(state); });
+                                    t.End();
+                                t.End();
+                            t.End();
+                        t.End();
+
+                        // Chasing it - straight there if it's in sight, otherwise through the maze
+                        t.BeginCondition({ k.target.index }, [](Goose& g) { return g.blackboard.Get(g.keys.target) != nullptr; });
+                            t.BeginService(0.2f, [](Goose& g, float) { g.WatchTarget(); });
+                                t.BeginSelector();
+                                    t.BeginCondition({ k.targetVisible.index }, [](Goose& g) { return g.blackboard.Get(g.keys.targetVisible); });
+                                        t.AddAction([](Goose& g, float dt, BehaviourState) { return g.MoveDirectly(dt); });
+                                    t.End();
+                                    t.AddAction([](Goose& g, float dt, BehaviourState) { return g.FollowPath(dt); });
+                                t.End();
+                            t.End();
+                        t.End();
+                    t.End();
+                    t.Compile();
+                    return t;
+                }();
+                return table;
             }
 
         protected:
-            GameObject* goatToChase;
+            struct Keys {
+                BlackboardKey<GameObject*>  target;
+                BlackboardKey<bool>         targetVisible;
+                BlackboardKey<int>          goatsInMaze;
+                BlackboardKey<int>          retarget;
+            };
+
+            static Keys AddKeys(Blackboard& b) {
+                Keys k;
+                k.target        = b.AddKey<GameObject*>("Target", nullptr);
+                k.targetVisible = b.AddKey<bool>("Target Visible", false);
+                k.goatsInMaze   = b.AddKey<int>("Goats In Maze", 0);
+                k.retarget      = b.AddKey<int>("Retarget", 0);
+                return k;
+            }
+
+            Keys                    keys;
+            BehaviourBatch<Goose>&  batch;
+            int                     batchSlot;
+
+            void CountGoats() {
+                const vector<GameObject*>& players = gameWorld->GetGoatsInMaze();
+                blackboard.Set(keys.goatsInMaze, (int)players.size());
+                // Stop chasing a goat that's left the maze
+                GameObject* target = blackboard.Get(keys.target);
+                if (target && std::find(players.begin(), players.end(), target) == players.end())
+                    blackboard.Set(keys.target, (GameObject*)nullptr);
+            }
+
+            void WatchTarget() {
+                blackboard.Set(keys.targetVisible, gameWorld->CanSee(GetTransform().GetPosition(), blackboard.Get(keys.target)));
+            }
+
+            BehaviourState FindClosestGoat(BehaviourState state) {
+                const vector<GameObject*>& players = gameWorld->GetGoatsInMaze();
+                Vector3 goosePosition = GetTransform().GetPosition();
+                // Starting afresh, so see which goats are in sight, and ask for paths to the rest
+                if (state != Ongoing) {
+                    for (GameObject* goat : players) {
+                        GoatPath& goatPath = goatPaths[goat];
+                        goatPath.visible = gameWorld->CanSee(goosePosition, goat);
+                        if (!goatPath.visible)
+                            RequestPathToGoat(goatPath, goosePosition, goat->GetTransform().GetPosition());
+                    }
+                }
+                float bestDistance = -1;
+                GameObject* bestGoat = nullptr;
+                bool bestVisible = false;
+                bool waiting = false;
+                for (GameObject* goat : players) {
+                    GoatPath& goatPath = goatPaths[goat];
+                    float distance;
+                    if (goatPath.visible) {
+                        distance = (goat->GetTransform().GetPosition() - goosePosition).Length();
+                    }
+                    // Otherwise use pathfinding to see how far away the goat is
+                    else if (!CollectPathToGoat(goatPath)) {
+                        waiting = true;
+                        continue;
+                    }
+                    else if (goatPath.path && !goatPath.path->empty()) {
+                        distance = (float)gameWorld->GetMaze()->GetNodeSize() * goatPath.path->size();
+                    }
+                    else {
+                        continue;
+                    }
+                    if (distance < bestDistance || bestDistance == -1) {
+                        bestDistance = distance;
+                        bestGoat = goat;
+                        bestVisible = goatPath.visible;
+                    }
+                }
+                // Check back next frame for the paths still being searched for
+                if (waiting)
+                    return Ongoing;
+                blackboard.Set(keys.target, bestGoat);
+                blackboard.Set(keys.targetVisible, bestVisible);
+                return bestGoat ? Success : Failure;
+            }
+
+            BehaviourState MoveDirectly(float dt) {
+                Vector3 goosePosition = GetTransform().GetPosition();
+                Vector3 goatPosition = blackboard.Get(keys.target)->GetTransform().GetPosition();
+                Debug::DrawLine<Debug::AI>(goosePosition, goatPosition, Vector4(0, 1, 1, 1));
+                MoveTowards(dt * 2.5f, goatPosition);
+                return Ongoing;
+            }
+
+            BehaviourState FollowPath(float dt) {
+                Vector3 goosePosition = GetTransform().GetPosition();
+                GameObject* goat = blackboard.Get(keys.target);
+                Vector3 goatPosition = goat->GetTransform().GetPosition();
+                // The goat won't stay put, so rather than searching again every time it moves, follow its flow field down to it
+                FlowField* field = gameWorld->GetGoatFlowField(goat);
+                Vector3 next;
+                if (!field || !field->GetNextChasePosition(goosePosition, next)) {
+                    // Already in the goat's node, or there's no way through to it
+                    MoveTowards(dt, goatPosition);
+                    return Ongoing;
+                }
+                if (Debug::LinesEnabled(Debug::Pathfinding)) {
+                    Debug::DrawLine<Debug::Pathfinding>(goosePosition, next, Vector4(1, 1, 1, 1));
+                    Vector3 a = next;
+                    Vector3 b;
+                    while (field->GetNextChasePosition(a, b)) {
+                        Debug::DrawLine<Debug::Pathfinding>(a, b, Vector4(0, 1, 1, 1));
+                        a = b;
+                    }
+                    Debug::DrawLine<Debug::Pathfinding>(a, goatPosition, Vector4(1, 1, 1, 1));
+                }
+                // Try to smooth the path taken with the node after
+                Vector3 afterNext;
+                if (field->GetNextChasePosition(next, afterNext))
+                    MoveTowards(dt, (next + afterNext) / 2);
+                else
+                    MoveTowards(dt, next);
+                return Ongoing;
+            }
+
+            struct GoatPath {
+                PathHandle request;
+                SharedPath path;
+                bool visible = false;
+            };
+            std::unordered_map<GameObject*, GoatPath> goatPaths;
+
+            // Asks for a fresh path to the goat, unless there's already one on the way
+            void RequestPathToGoat(GoatPath& goatPath, const Vector3& goosePosition, const Vector3& goatPosition) {
+                PathRequestService* requests = gameWorld->GetPathRequests();
+                if (requests && !goatPath.request.IsValid())
+                    goatPath.request = requests->Request(goosePosition, goatPosition, 1.0f);
+            }
+
+            // Picks up the path if it's turned up. False while it's still being searched for
+            bool CollectPathToGoat(GoatPath& goatPath) {
+                PathRequestService* requests = gameWorld->GetPathRequests();
+                if (!requests || !goatPath.request.IsValid())
+                    return true;
+                PathRequestState state = requests->GetState(goatPath.request);
+                if (state == PathRequestState::Ready || state == PathRequestState::Failed) {
+                    goatPath.path = requests->GetPath(goatPath.request);
+                    requests->Release(goatPath.request);
+                    goatPath.request = PathHandle();
+                }
+                else if (state == PathRequestState::Invalid) // Service was replaced
+                    goatPath.request = PathHandle();
+                return !goatPath.request.IsValid();
+            }
 
             void MoveTowards(float dt, Vector3 target) {
                 Vector3 gooseRotation = GetTransform().GetOrientation().ToEuler();
@@ -144,12 +291,12 @@ namespace NCL {
                 else if (yawDiff < -180)
                     yawDiff += 360;
 
-                Debug::DrawLine(GetTransform().GetPosition(), target);
+                Debug::DrawLine<Debug::AI>(GetTransform().GetPosition(), target);
 
-                GetPhysicsObject()->AddTorque(Vector3(0, sqrt(abs(yawDiff)) * (yawDiff < 0 ? -1 : 1) * 10 * dt, 0));
+                commands->AddTorque(this, Vector3(0, sqrt(abs(yawDiff)) * (yawDiff < 0 ? -1 : 1) * 10 * dt, 0));
 
                 Vector3 direction = deltaPosition.Normalised();
-                GetPhysicsObject()->AddForce(Vector3(-direction.x, 0, -direction.z) * dt * 200);
+                commands->AddForce(this, Vector3(-direction.x, 0, -direction.z) * dt * 200);
             }
         };
     }
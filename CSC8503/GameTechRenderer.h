@@ -42,7 +42,8 @@ namespace NCL {
 			void SetDebugStringBufferSizes(size_t newVertCount);
 			void SetDebugLineBufferSizes(size_t newVertCount);
 
-			vector<const RenderObject*> activeObjects;
+			// Points into the world's current snapshot, not the live objects
+			vector<const ObjectSnapshot*> activeObjects;
 
 			OGLShader*  debugShader;
 			OGLShader*  skyboxShader;
@@ -304,43 +304,33 @@ void GameTechVulkanRenderer::RenderFrame() {
 void GameTechVulkanRenderer::UpdateObjectList() {
 	activeObjects.clear();
 
-	int objectCount = 0;
-
-	gameWorld.OperateOnContents(
-		[&](GameObject* o) {
-			if (o->IsActive()) {
-				objectCount++;
-			}
-		}
-	);
+	// Drawn from the snapshot, as physics may be moving the live objects
+	const std::vector<ObjectSnapshot>& snapshot = gameWorld.GetSnapshot().GetObjects();
 
 	VulkanMesh* pipeMesh = nullptr;
 	int at = 0;
-	gameWorld.OperateOnContents(
-		[&](GameObject* o) {
-			if (o->IsActive()) {
-				RenderObject* g = o->GetRenderObject();
-				if (g) {
-					activeObjects.emplace_back(g);
-
-					ObjectState state;
-					state.modelMatrix = g->GetTransform()->GetMatrix();
-					state.colour = g->GetColour();
-					state.index[0] = 0;
-					if (g->GetMesh()) {
-						pipeMesh = (VulkanMesh*)g->GetMesh();
-					}
-					if (g->GetDefaultTexture()) {
-						VulkanGameTechTexture* t = (VulkanGameTechTexture*)g->GetDefaultTexture();
-						state.index[0] = t->index;
-					}
-					currentFrame->WriteData<ObjectState>(state);
-					currentFrame->debugLinesOffset += sizeof(ObjectState);
-					at++;
-				}
-			}
+	for (const ObjectSnapshot& s : snapshot) {
+		const RenderObject* g = s.renderObject;
+		if (!g) {
+			continue;
 		}
-	);
+		activeObjects.emplace_back(g);
+
+		ObjectState state;
+		state.modelMatrix = s.modelMatrix;
+		state.colour = s.colour;
+		state.index[0] = 0;
+		if (g->GetMesh()) {
+			pipeMesh = (VulkanMesh*)g->GetMesh();
+		}
+		if (g->GetDefaultTexture()) {
+			VulkanGameTechTexture* t = (VulkanGameTechTexture*)g->GetDefaultTexture();
+			state.index[0] = t->index;
+		}
+		currentFrame->WriteData<ObjectState>(state);
+		currentFrame->debugLinesOffset += sizeof(ObjectState);
+		at++;
+	}
 	if (pipeMesh && !scenePipeline.pipeline) {
 		BuildScenePipelines(pipeMesh);
 	}
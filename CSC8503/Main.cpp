@@ -32,6 +32,7 @@ using namespace CSC8503;
 #include <thread>
 #include <sstream>
 #include <regex>
+#include <stdexcept>
 
 int option;
 int a = 127;
@@ -69,12 +70,32 @@ protected:
 	float pauseReminder = 1;
 };
 
+/*
+Makes binary copies of the text navigation files, which load straight
+out of a memory mapped file with nothing to parse. The same constructors
+read either kind, so anything can be pointed at the binary ones.
+*/
+void ConvertNavigationData() {
+	const string gridFiles[] = { "CornMaze.txt", "TestGrid1.txt" };
+	for (const string& name : gridFiles) {
+		NavigationGrid grid(name);
+		string outName = name.substr(0, name.find_last_of('.')) + ".navgrid";
+		std::cout << name << " -> " << outName << (grid.SaveBinary(outName) ? "\n" : " failed!\n");
+	}
+	const string meshFiles[] = { "test.navmesh" };
+	for (const string& name : meshFiles) {
+		NavigationMesh mesh(name);
+		string outName = name.substr(0, name.find_last_of('.')) + ".navbin";
+		std::cout << name << " -> " << outName << (mesh.SaveBinary(outName) ? "\n" : " failed!\n");
+	}
+}
+
 class IntroScreen : public PushdownState {
 	PushdownResult OnUpdate(float dt, PushdownState** newState) override {
-		std::cout << "Choose a game mode\n1) Start singleplayer game\n2) Start multiplayer server\n3) Start multiplayer client (Server IP: " + IPAsString(a, b, c, d) + ")\n4) Set IP of server to connect to\n5) Quit\nChoose a game mode : ";
+		std::cout << "Choose a game mode\n1) Start singleplayer game\n2) Start multiplayer server\n3) Start multiplayer client (Server IP: " + IPAsString(a, b, c, d) + ")\n4) Set IP of server to connect to\n5) Convert navigation data to binary\n6) Quit\nChoose a game mode : ";
 		string input;
 		std::cin >> input;
-		if (std::regex_match(input, std::regex("[1-5]"))) {
+		if (std::regex_match(input, std::regex("[1-6]"))) {
 			switch (input[0]) {
 			case('1'):
 				option = 1;
@@ -89,7 +110,10 @@ class IntroScreen : public PushdownState {
 				*newState = new EnterIPScreen();
 				return PushdownResult::Push;
 			case('5'):
-				option = 5;
+				ConvertNavigationData();
+				return PushdownResult::NoChange;
+			case('6'):
+				option = 6;
 				return PushdownResult::Pop;
 			}
 		}
@@ -147,51 +171,59 @@ int main() {
 		return -1;
 	}
 
-	switch (option) {
-	case(1):
-		g = new TutorialGame(true);
-		break;
-	case(2):
-		std::cout << "I will be server!";
-		g = new NetworkedGame();
-		break;
-	case(3):
-		std::cout << "I will be client connecting to IP " << IPAsString(a, b, c, d) << "!";
-		g = new NetworkedGame(a, b, c, d);
-		break;
-	default:
-		return 0;
-	}
+	// The maze is loaded whenever the world is set up, and a damaged binary one can't be played
+	try {
+		switch (option) {
+		case(1):
+			g = new TutorialGame(true);
+			break;
+		case(2):
+			std::cout << "I will be server!";
+			g = new NetworkedGame();
+			break;
+		case(3):
+			std::cout << "I will be client connecting to IP " << IPAsString(a, b, c, d) << "!";
+			g = new NetworkedGame(a, b, c, d);
+			break;
+		default:
+			return 0;
+		}
 
-	w->ShowOSPointer(false);
-	w->LockMouseToWindow(true);
+		w->ShowOSPointer(false);
+		w->LockMouseToWindow(true);
 
-	w->GetTimer()->GetTimeDeltaSeconds(); //Clear the timer so we don't get a larget first dt!
-	while (w->UpdateWindow() && !Window::GetKeyboard()->KeyDown(KeyboardKeys::ESCAPE)) {
-		float dt = w->GetTimer()->GetTimeDeltaSeconds();
-		if(dt > 1.0f){
-			std::cout << "Skipping large time delta" << std::endl;
-			continue; //must have hit a breakpoint or something to have a 1 second frame time!
-		}
-		if (Window::GetKeyboard()->KeyPressed(KeyboardKeys::PRIOR)) {
-			w->ShowConsole(true);
-		}
-		if (Window::GetKeyboard()->KeyPressed(KeyboardKeys::NEXT)) {
-			w->ShowConsole(false);
-		}
+		w->GetTimer()->GetTimeDeltaSeconds(); //Clear the timer so we don't get a larget first dt!
+		while (w->UpdateWindow() && !Window::GetKeyboard()->KeyDown(KeyboardKeys::ESCAPE)) {
+			float dt = w->GetTimer()->GetTimeDeltaSeconds();
+			if(dt > 1.0f){
+				std::cout << "Skipping large time delta" << std::endl;
+				continue; //must have hit a breakpoint or something to have a 1 second frame time!
+			}
+			if (Window::GetKeyboard()->KeyPressed(KeyboardKeys::PRIOR)) {
+				w->ShowConsole(true);
+			}
+			if (Window::GetKeyboard()->KeyPressed(KeyboardKeys::NEXT)) {
+				w->ShowConsole(false);
+			}
 
-		if (Window::GetKeyboard()->KeyPressed(KeyboardKeys::Y)) {
-			w->SetWindowPosition(0, 0);
-		}
-		if (Window::GetKeyboard()->KeyPressed(KeyboardKeys::U)) {
-			w->SetWindowPosition(-1920, 0);
-		}
+			if (Window::GetKeyboard()->KeyPressed(KeyboardKeys::Y)) {
+				w->SetWindowPosition(0, 0);
+			}
+			if (Window::GetKeyboard()->KeyPressed(KeyboardKeys::U)) {
+				w->SetWindowPosition(-1920, 0);
+			}
 
-		//std::cout << "LAST FRAME: " << frames[0] << " AVERAGE: " << avg << "/" << 1000.0f/avg << "fps" << std::endl;
+			//std::cout << "LAST FRAME: " << frames[0] << " AVERAGE: " << avg << "/" << 1000.0f/avg << "fps" << std::endl;
 
-		w->SetTitle("Gametech frame time:" + std::to_string(1000.0f * dt) + " / " + std::to_string(1.0f / dt) + "fps");
+			w->SetTitle("Gametech frame time:" + std::to_string(1000.0f * dt) + " / " + std::to_string(1.0f / dt) + "fps");
 
-		g->UpdateGame(dt);
+			g->UpdateGame(dt);
+		}
+	}
+	catch (std::runtime_error& e) {
+		std::cout << e.what() << std::endl;
+		Window::DestroyGameWindow();
+		return -1;
 	}
 	Window::DestroyGameWindow();
 }
\ No newline at end of file
@@ -30,6 +30,8 @@ NetworkedGame::NetworkedGame() : TutorialGame(false)	{
 	NetworkBase::Initialise();
 	timeToNextPacket  = 0.0f;
 	packetsToSnapshot = 0;
+	broadcastPending  = false;
+	broadcastDelta	  = false;
 	StartAsServer();
 }
 
@@ -40,6 +42,8 @@ NetworkedGame::NetworkedGame(int a, int b, int c, int d) : TutorialGame(false) {
 	NetworkBase::Initialise();
 	timeToNextPacket = 0.0f;
 	packetsToSnapshot = 0;
+	broadcastPending = false;
+	broadcastDelta = false;
 	StartAsClient(a, b, c, d);
 }
 
@@ -148,13 +152,15 @@ void NetworkedGame::UpdateAsServer(float dt) {
 	thisServer->UpdateServer();
 	myState++;
 	packetsToSnapshot--;
+	// The state itself is sent from UpdateFromSnapshot, overlapping the physics step
+	broadcastPending = true;
 	if (packetsToSnapshot < 0) {
 		UpdateMinimumState();
-		BroadcastSnapshot(false);
+		broadcastDelta = false;
 		packetsToSnapshot = 5;
 	}
 	else {
-		BroadcastSnapshot(true);
+		broadcastDelta = true;
 	}
 	MessagePacket timer;
 	timer.messageID = 3;
@@ -197,28 +203,30 @@ void NetworkedGame::UpdateAsClient(float dt) {
 	thisClient->SendPacket(newPacket);
 }
 
+void NetworkedGame::UpdateFromSnapshot(float dt) {
+	if (thisServer && broadcastPending) {
+		BroadcastSnapshot(broadcastDelta);
+		broadcastPending = false;
+	}
+}
+
 void NetworkedGame::BroadcastSnapshot(bool deltaFrame) {
-	std::vector<GameObject*>::const_iterator first;
-	std::vector<GameObject*>::const_iterator last;
+	int minID = INT_MAX;
 
-	world->GetObjectIterators(first, last);
+	for (auto i : stateIDs) {
+		minID = min(minID, i.second);
+	}
 
-	for (auto i = first; i != last; ++i) {
-		NetworkObject* o = (*i)->GetNetworkObject();
+	if (minID == INT_MAX)
+		minID = myState - 5;
+
+	for (const ObjectSnapshot& s : world->GetSnapshot().GetObjects()) {
+		NetworkObject* o = s.networkObject;
 		if (!o) {
 			continue;
 		}
-		int minID = INT_MAX;
-
-		for (auto i : stateIDs) {
-			minID = min(minID, i.second);
-		}
-
-		if (minID == INT_MAX)
-			minID = myState - 5;
-
 		GamePacket* newPacket = nullptr;
-		if (o->WritePacket(&newPacket, deltaFrame, minID)) {
+		if (o->WritePacket(&newPacket, deltaFrame, minID, s)) {
 			thisServer->SendGlobalPacket(*newPacket);
 			delete newPacket;
 		}
@@ -46,6 +46,8 @@ namespace NCL {
 			void UpdateAsServer(float dt);
 			void UpdateAsClient(float dt);
 
+			void UpdateFromSnapshot(float dt) override;
+
 			void BroadcastSnapshot(bool deltaFrame);
 			void UpdateMinimumState();
 
@@ -54,6 +56,9 @@ namespace NCL {
 			float timeToNextPacket;
 			int packetsToSnapshot;
 
+			bool broadcastPending;
+			bool broadcastDelta;
+
 			int myID;
 			int winner;
 			int myState;
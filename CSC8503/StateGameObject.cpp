@@ -5,21 +5,39 @@
 #include "PhysicsObject.h"
 #include "CollisionDetection.h"
 #include "GameWorld.h"
+#include "Maths.h"
+#include "Debug.h"
 
 using namespace NCL;
 using namespace CSC8503;
 
+// Goat threat that sends civilians running - about 50 units from a goat, by the way round the hedges
+const float FLEE_THREAT			= 0.33f;
+// And once they're running, they don't stop until it's dropped below this
+const float CALM_THREAT			= 0.2f;
+// How much fleeing civilians avoid running into crowds, compared to towards the goat
+const float CROWD_AVOIDANCE		= 0.5f;
+
 StateGameObject::StateGameObject(std::string name, GameWorld* gameWorld) : GameObject(name) {
 	stateMachine = new StateMachine();
 	this->gameWorld = gameWorld;
+	commands = nullptr;
 }
 
 StateGameObject::~StateGameObject() {
 	delete stateMachine;
 }
 
-void StateGameObject::Update(float dt) {
+void StateGameObject::Update(float dt, AICommandBuffer& commands) {
+	this->commands = &commands;
 	stateMachine->Update(dt);
+	this->commands = nullptr;
+}
+
+void StateGameObject::Update(float dt) {
+	AICommandBuffer immediate;
+	Update(dt, immediate);
+	immediate.Apply();
 }
 
 /* 
@@ -27,128 +45,100 @@ void StateGameObject::Update(float dt) {
 	Yes I'm aware that doing the movement via different states is really stupid and can be done far simpler, but it shows basic implemention of state machines
 */
 MagicBall::MagicBall(std::string name, GameWorld* gameWorld) : StateGameObject(name, gameWorld) {
-	State* stateL = new State([&](float dt)-> void {
-		this->MoveLeft(dt);
-		});
-
-	State* stateLF = new State([&](float dt)-> void {
-		this->MoveLeft(dt);
-		this->MoveForward(dt);
-		});
-
-	State* stateLB = new State([&](float dt)-> void {
-		this->MoveLeft(dt);
-		this->MoveBack(dt);
-		});
-
-	State* stateR = new State([&](float dt)-> void {
-		this->MoveRight(dt);
-		});
-
-	State* stateRF = new State([&](float dt)-> void {
-		this->MoveRight(dt);
-		this->MoveForward(dt);
-		});
-
-	State* stateRB = new State([&](float dt)-> void {
-		this->MoveRight(dt);
-		this->MoveBack(dt);
-		});
-
-	stateMachine->AddState(stateL);
-	stateMachine->AddState(stateLF);
-	stateMachine->AddState(stateLB);
-	stateMachine->AddState(stateR);
-	stateMachine->AddState(stateRF);
-	stateMachine->AddState(stateRB);
-
-	stateMachine->AddTransition(new StateTransition(stateL, stateR, [&]()->bool {
-		return GetTransform().GetPosition().x < startPos.x;
-		}));
-
-	stateMachine->AddTransition(new StateTransition(stateL, stateLF, [&]()->bool {
-		return GetTransform().GetPosition().z > startPos.z;
-		}));
-
-	stateMachine->AddTransition(new StateTransition(stateLF, stateL, [&]()->bool {
-		return GetTransform().GetPosition().z == startPos.z;
-		}));
-
-	stateMachine->AddTransition(new StateTransition(stateLF, stateLB, [&]()->bool {
-		return GetTransform().GetPosition().z < startPos.z;
-		}));
-
-	stateMachine->AddTransition(new StateTransition(stateLF, stateRF, [&]()->bool {
-		return GetTransform().GetPosition().x < startPos.x;
-		}));
-
-	stateMachine->AddTransition(new StateTransition(stateL, stateLB, [&]()->bool {
-		return GetTransform().GetPosition().z < startPos.z;
-		}));
-
-	stateMachine->AddTransition(new StateTransition(stateLB, stateL, [&]()->bool {
-		return GetTransform().GetPosition().z == startPos.z;
-		}));
-
-	stateMachine->AddTransition(new StateTransition(stateLB, stateLF, [&]()->bool {
-		return GetTransform().GetPosition().z > startPos.z;
-		}));
-
-	stateMachine->AddTransition(new StateTransition(stateLB, stateRB, [&]()->bool {
-		return GetTransform().GetPosition().x < startPos.x;
-		}));
-
-	stateMachine->AddTransition(new StateTransition(stateR, stateL, [&]()->bool {
-		return GetTransform().GetPosition().x > startPos.x;
-		}));
-
-	stateMachine->AddTransition(new StateTransition(stateR, stateRF, [&]()->bool {
-		return GetTransform().GetPosition().z > startPos.z;
-		}));
-
-	stateMachine->AddTransition(new StateTransition(stateRF, stateR, [&]()->bool {
-		return GetTransform().GetPosition().z == startPos.z;
-		}));
-
-	stateMachine->AddTransition(new StateTransition(stateRF, stateRB, [&]()->bool {
-		return GetTransform().GetPosition().z < startPos.z;
-		}));
-
-	stateMachine->AddTransition(new StateTransition(stateRF, stateLF, [&]()->bool {
-		return GetTransform().GetPosition().x > startPos.x;
-		}));
-
-	stateMachine->AddTransition(new StateTransition(stateR, stateRB, [&]()->bool {
-		return GetTransform().GetPosition().z < startPos.z;
-		}));
-
-	stateMachine->AddTransition(new StateTransition(stateRB, stateR, [&]()->bool {
-		return GetTransform().GetPosition().z == startPos.z;
-		}));
+	state = 0;
+}
 
-	stateMachine->AddTransition(new StateTransition(stateRB, stateRF, [&]()->bool {
-		return GetTransform().GetPosition().z > startPos.z;
-		}));
+/*
+	Every magic ball shares the one table, so there's nothing to build per ball.
+	The ball's position is compared to where it started, so there's no captures needed either.
+*/
+const StateTable<MagicBall>& MagicBall::GetStateTable() {
+	static const StateTable<MagicBall> table = []() {
+		StateTable<MagicBall> t;
+		int stateL = t.AddState([](MagicBall& b, float dt) {
+			b.MoveLeft(dt);
+			});
+
+		int stateLF = t.AddState([](MagicBall& b, float dt) {
+			b.MoveLeft(dt);
+			b.MoveForward(dt);
+			});
+
+		int stateLB = t.AddState([](MagicBall& b, float dt) {
+			b.MoveLeft(dt);
+			b.MoveBack(dt);
+			});
+
+		int stateR = t.AddState([](MagicBall& b, float dt) {
+			b.MoveRight(dt);
+			});
+
+		int stateRF = t.AddState([](MagicBall& b, float dt) {
+			b.MoveRight(dt);
+			b.MoveForward(dt);
+			});
+
+		int stateRB = t.AddState([](MagicBall& b, float dt) {
+			b.MoveRight(dt);
+			b.MoveBack(dt);
+			});
+
+		auto leftOfStart	= [](MagicBall& b) { return b.GetTransform().GetPosition().x < b.startPos.x; };
+		auto rightOfStart	= [](MagicBall& b) { return b.GetTransform().GetPosition().x > b.startPos.x; };
+		auto behindStart	= [](MagicBall& b) { return b.GetTransform().GetPosition().z > b.startPos.z; };
+		auto inFrontOfStart	= [](MagicBall& b) { return b.GetTransform().GetPosition().z < b.startPos.z; };
+		auto levelWithStart	= [](MagicBall& b) { return b.GetTransform().GetPosition().z == b.startPos.z; };
+
+		t.AddTransition(stateL, stateR, leftOfStart);
+		t.AddTransition(stateL, stateLF, behindStart);
+		t.AddTransition(stateL, stateLB, inFrontOfStart);
+
+		t.AddTransition(stateLF, stateL, levelWithStart);
+		t.AddTransition(stateLF, stateLB, inFrontOfStart);
+		t.AddTransition(stateLF, stateRF, leftOfStart);
+
+		t.AddTransition(stateLB, stateL, levelWithStart);
+		t.AddTransition(stateLB, stateLF, behindStart);
+		t.AddTransition(stateLB, stateRB, leftOfStart);
+
+		t.AddTransition(stateR, stateL, rightOfStart);
+		t.AddTransition(stateR, stateRF, behindStart);
+		t.AddTransition(stateR, stateRB, inFrontOfStart);
+
+		t.AddTransition(stateRF, stateR, levelWithStart);
+		t.AddTransition(stateRF, stateRB, inFrontOfStart);
+		t.AddTransition(stateRF, stateLF, rightOfStart);
+
+		t.AddTransition(stateRB, stateR, levelWithStart);
+		t.AddTransition(stateRB, stateRF, behindStart);
+		t.AddTransition(stateRB, stateLB, rightOfStart);
+
+		t.Compile();
+		return t;
+	}();
+	return table;
+}
 
-	stateMachine->AddTransition(new StateTransition(stateRB, stateLB, [&]()->bool {
-		return GetTransform().GetPosition().x > startPos.x;
-		}));
+void MagicBall::Update(float dt, AICommandBuffer& commands) {
+	this->commands = &commands;
+	GetStateTable().Update(*this, state, dt);
+	this->commands = nullptr;
 }
 
 void MagicBall::MoveLeft(float dt) {
-	GetPhysicsObject()->AddForce({ -10, 0, 0 });
+	commands->AddForce(this, { -10, 0, 0 });
 }
 
 void MagicBall::MoveRight(float dt) {
-	GetPhysicsObject()->AddForce({ 10, 0, 0 });
+	commands->AddForce(this, { 10, 0, 0 });
 }
 
 void MagicBall::MoveForward(float dt) {
-	GetPhysicsObject()->AddForce({ 0, 0, -10 });
+	commands->AddForce(this, { 0, 0, -10 });
 }
 
 void MagicBall::MoveBack(float dt) {
-	GetPhysicsObject()->AddForce({ 10, 0, 10 });
+	commands->AddForce(this, { 10, 0, 10 });
 }
 
 /*
@@ -160,11 +150,15 @@ Civilian::Civilian(std::string name, GameWorld* gameWorld) : StateGameObject(nam
 
 	// Originally every degree was checked but this was very expensive to do... checking only every 10 degrees is basically just as good and much faster!
 	step = 10;
+	threat = nullptr;
+	turnSide = 0;
 	State* walking = new State([&](float dt)->void {
 		MoveForward(dt);
 		});
 
-	State* decideDirection = new State();
+	State* decideDirection = new State([&](float dt)->void {
+		turnSide = FindOpenSide();
+		});
 
 	State* turnLeft = new State([&](float dt)->void {
 		TurnLeft(dt);
@@ -175,7 +169,7 @@ Civilian::Civilian(std::string name, GameWorld* gameWorld) : StateGameObject(nam
 		});
 
 	State* running = new State([&](float dt)->void {
-		MoveForward(dt * 4);
+		RunFrom(dt * 4);
 		});
 
 	stateMachine->AddState(walking);
@@ -190,225 +184,220 @@ Civilian::Civilian(std::string name, GameWorld* gameWorld) : StateGameObject(nam
 	stateMachine->AddState(running);
 
 	StateTransitionFunction checkGoatNearby = [&, gameWorld]()->bool {
-		vector<GameObject*> players = gameWorld->GetGoats();
-		Vector3 civPosition = GetTransform().GetPosition();
-		for (GameObject* goat : players) {
-			// Check goat is close
-			Vector3 goatPosition = goat->GetTransform().GetPosition();
-			Vector3 positionDifference = goatPosition - civPosition;
-			float distance = positionDifference.Length();
-			if (distance < 50) {
-				// Check if direct line of sight to goat
-				Ray ray = Ray(civPosition, positionDifference.Normalised());
-				RayCollision civCollision;
-				if (gameWorld->Raycast(ray, civCollision, true)) {
-					if (civCollision.node == goat) {
-						Debug::DrawLine(civPosition, goatPosition, Vector4(1, 0, 0, 1));
-						return true;
-					}
-					else {
-						Debug::DrawLine(civPosition, goatPosition, Vector4(1, 1, 0, 1));
-					}
-				}
-			}
-		}
-		return false;
+		return SensesGoat(FLEE_THREAT);
 	};
+	// Only the first transition that passes is taken, and running from a goat matters more than anything else a civilian is doing
+	const int fleePriority = 1;
 
 	stateMachine->AddTransition(new StateTransition(walking, decideDirection, [&, gameWorld]()->bool {
-		Ray ray = Ray(Vector3(0, 0, 0), Vector3(0, 0, 0));
-		RayCollision civCollision;
 		Vector3 civPosition = GetTransform().GetPosition();
 		float civDirection = GetTransform().GetOrientation().ToEuler().y;
 		for (float i = step; i <= fov; i += step) {
 			float dirLeft = civDirection - i;
 			float dirRight = civDirection + i;
-			ray = Ray(civPosition, Matrix3::FromEuler(Vector3(0, dirLeft, 0)) * Vector3(0, 0, -1));
-			if (gameWorld->Raycast(ray, civCollision, true)) {
-				if (civCollision.rayDistance < 10) {
-					Debug::DrawLine(civPosition, civCollision.collidedAt, Vector4(1, 0, 0, 1));
-					return true;
-				}
-				else {
-					Debug::DrawLine(civPosition, civPosition + ray.GetDirection() * 10, Vector4(0, 0, 1, 1));
-					Debug::DrawLine(civPosition + ray.GetDirection() * 10, civCollision.collidedAt, Vector4(0, 1, 0, 1));
-				}
-			}
-			else {
-				Debug::DrawLine(civPosition, civPosition + ray.GetDirection() * 10, Vector4(0, 0, 1, 1));
-			}
-			ray = Ray(civPosition, Matrix3::FromEuler(Vector3(0, dirRight, 0)) * Vector3(0, 0, -1));
-			if (gameWorld->Raycast(ray, civCollision, true)) {
-				if (civCollision.rayDistance < 10) {
-					Debug::DrawLine(civPosition, civCollision.collidedAt, Vector4(1, 0, 0, 1));
+			for (float dir : { dirLeft, dirRight }) {
+				Vector3 rayDirection = Matrix3::FromEuler(Vector3(0, dir, 0)) * Vector3(0, 0, -1);
+				float distance = FreeDistance(dir, 10);
+				if (distance < 10) {
+					Debug::DrawLine<Debug::AI>(civPosition, civPosition + rayDirection * distance, Vector4(1, 0, 0, 1));
 					return true;
 				}
-				else {
-					Debug::DrawLine(civPosition, civPosition + ray.GetDirection() * 10, Vector4(0, 0, 1, 1));
-					Debug::DrawLine(civPosition + ray.GetDirection() * 10, civCollision.collidedAt, Vector4(0, 1, 0, 1));
-				}
-			}
-			else {
-				Debug::DrawLine(civPosition, civPosition + ray.GetDirection() * 10, Vector4(0, 0, 1, 1));
+				Debug::DrawLine<Debug::AI>(civPosition, civPosition + rayDirection * 10, Vector4(0, 0, 1, 1));
 			}
 		}
 		return false;
 		}));
 
-	stateMachine->AddTransition(new StateTransition(walking, running, checkGoatNearby));
+	stateMachine->AddTransition(new StateTransition(walking, running, checkGoatNearby), fleePriority);
 
+	// The decideDirection state has already swept for the way to go by the time these are checked
 	stateMachine->AddTransition(new StateTransition(decideDirection, turnRight, [&, gameWorld]()->bool {
-		Ray ray = Ray(Vector3(0, 0, 0), Vector3(0, 0, 0));
-		RayCollision civCollision;
-		Vector3 civPosition = GetTransform().GetPosition();
-		float civDirection = GetTransform().GetOrientation().ToEuler().y;
-		for (float i = fov; i < 180; i += 1) { // Keep checking both directions, if it turns out right is closer to a success then instead turn right
-			float dirLeft = civDirection - i;
-			float dirRight = civDirection + i;
-			
-			ray = Ray(civPosition, Matrix3::FromEuler(Vector3(0, dirLeft, 0)) * Vector3(0, 0, -1));
-			Debug::DrawLine(civPosition, civPosition + ray.GetDirection() * 15, Vector4(1, 0, 1, 1));
-			if (gameWorld->Raycast(ray, civCollision, true))
-				if (civCollision.rayDistance > 15)
-					return true;
-			ray = Ray(civPosition, Matrix3::FromEuler(Vector3(0, dirRight, 0)) * Vector3(0, 0, -1));
-			Debug::DrawLine(civPosition, civPosition + ray.GetDirection() * 15, Vector4(1, 0, 1, 1));
-			if (gameWorld->Raycast(ray, civCollision, true))
-				if (civCollision.rayDistance > 15)
-					return false;
-		}
-		return false;
+		return turnSide < 0;
 		}));
 
 	stateMachine->AddTransition(new StateTransition(decideDirection, turnLeft, [&, gameWorld]()->bool {
-		Ray ray = Ray(Vector3(0, 0, 0), Vector3(0, 0, 0));
-		RayCollision civCollision;
-		Vector3 civPosition = GetTransform().GetPosition();
-		float civDirection = GetTransform().GetOrientation().ToEuler().y;
-		for (float i = fov; i < 180; i += 1) { // Keep checking both directions, if it turns out left is closer to a success then instead turn left
-			float dirLeft = civDirection - i;
-			float dirRight = civDirection + i;
-
-			ray = Ray(civPosition, Matrix3::FromEuler(Vector3(0, dirRight, 0)) * Vector3(0, 0, -1));
-			Debug::DrawLine(civPosition, civPosition + ray.GetDirection() * 15, Vector4(1, 0, 1, 1));
-			if (gameWorld->Raycast(ray, civCollision, true))
-				if (civCollision.rayDistance > 15)
-					return true;
-			ray = Ray(civPosition, Matrix3::FromEuler(Vector3(0, dirLeft, 0)) * Vector3(0, 0, -1));
-			Debug::DrawLine(civPosition, civPosition + ray.GetDirection() * 15, Vector4(1, 0, 1, 1));
-			if (gameWorld->Raycast(ray, civCollision, true))
-				if (civCollision.rayDistance > 15)
-					return false;
-		}
-		return false;
+		return turnSide > 0;
 		}));
 
 	stateMachine->AddTransition(new StateTransition(turnLeft, walking, [&, gameWorld]()->bool {
-		Ray ray = Ray(Vector3(0, 0, 0), Vector3(0, 0, 0));
-		RayCollision civCollision;
-		Vector3 civPosition = GetTransform().GetPosition();
-		float civDirection = GetTransform().GetOrientation().ToEuler().y;
-		bool ret = true;
-		for (float i = -fov; i <= fov; i += step) {
-			float dir = civDirection + i;
-			if (dir < -180)
-				dir += 360;
-			else if (dir > 180)
-				dir -= 360;
-			ray = Ray(civPosition, Matrix3::FromEuler(Vector3(0, dir, 0)) * Vector3(0, 0, -1));
-			if (gameWorld->Raycast(ray, civCollision, true)) {
-				if (civCollision.rayDistance < 10) {
-					Debug::DrawLine(civPosition, civCollision.collidedAt, Vector4(1, 0, 0, 1));
-					/* 
-						Originally thisand the other turnLeft / right states showed all the collision rays as it was more interesting, but this tanked performance unfortunately.
-						The old method is still here, delete return = false if you want to see it all, but this will greatly reduce performance, maybe reduce to 1-3 civilians in InitWorld first?
-					*/
-					return false;
-					ret = false;
-				}
-				else {
-					Debug::DrawLine(civPosition, civPosition + ray.GetDirection() * 10, Vector4(0, 0, 1, 1));
-					Debug::DrawLine(civPosition + ray.GetDirection() * 10, civCollision.collidedAt, Vector4(0, 1, 0, 1));
-				}
-			}
-			else {
-				Debug::DrawLine(civPosition, civPosition + ray.GetDirection() * 10, Vector4(0, 0, 1, 1));
-			}
-		}
-		return ret;
+		return ClearAhead();
 		}));
 
-	stateMachine->AddTransition(new StateTransition(turnLeft, running, checkGoatNearby));
+	stateMachine->AddTransition(new StateTransition(turnLeft, running, checkGoatNearby), fleePriority);
 
 	stateMachine->AddTransition(new StateTransition(turnRight, walking, [&, gameWorld]()->bool {
-		Ray ray = Ray(Vector3(0, 0, 0), Vector3(0, 0, 0));
-		RayCollision civCollision;
-		Vector3 civPosition = GetTransform().GetPosition();
-		float civDirection = GetTransform().GetOrientation().ToEuler().y;
-		bool ret = true;
-		for (float i = fov; i >= -fov; i -= step) {
-			float dir = civDirection + i;
-			if (dir < -180)
-				dir += 360;
-			else if (dir > 180)
-				dir -= 360;
-			ray = Ray(civPosition, Matrix3::FromEuler(Vector3(0, dir, 0)) * Vector3(0, 0, -1));
-			if (gameWorld->Raycast(ray, civCollision, true)) {
-				if (civCollision.rayDistance < 10) {
-					Debug::DrawLine(GetTransform().GetPosition(), civCollision.collidedAt, Vector4(1, 0, 0, 1));
-					return false;
-					ret = false;
-				}
-				else {
-					Debug::DrawLine(civPosition, civPosition + ray.GetDirection() * 10, Vector4(0, 0, 1, 1));
-					Debug::DrawLine(civPosition + ray.GetDirection() * 10, civCollision.collidedAt, Vector4(0, 1, 0, 1));
-				}
-			}
-			else {
-				Debug::DrawLine(civPosition, civPosition + ray.GetDirection() * 10, Vector4(0, 0, 1, 1));
-			}
-		}
-		return ret;
+		return ClearAhead();
 		}));
 
-	stateMachine->AddTransition(new StateTransition(turnRight, running, checkGoatNearby));
+	stateMachine->AddTransition(new StateTransition(turnRight, running, checkGoatNearby), fleePriority);
 
 	stateMachine->AddTransition(new StateTransition(running, walking, [&, gameWorld]()->bool {
-		vector<GameObject*> players = gameWorld->GetGoats();
-		Vector3 civPosition = GetTransform().GetPosition();
-		for (GameObject* goat : players) {
-			// Check goat is close
-			Vector3 goatPosition = goat->GetTransform().GetPosition();
-			Vector3 positionDifference = goatPosition - civPosition;
-			float distance = positionDifference.Length();
-			if (distance < 50) {
-				// Check if direct line of sight to goat
-				Ray ray = Ray(civPosition, positionDifference.Normalised());
-				RayCollision civCollision;
-				if (gameWorld->Raycast(ray, civCollision, true)) {
-					if (civCollision.node == goat) {
-						Debug::DrawLine(civPosition, goatPosition, Vector4(1, 0, 0, 1));
-						return false;
-					}
-					else {
-						Debug::DrawLine(civPosition, goatPosition, Vector4(1, 1, 0, 1));
-					}
-				}
-			}
-		}
-		return true;
+		return !SensesGoat(CALM_THREAT);
 		}));
 }
 
+/*
+	Whether there's a goat close enough to run from.
+	In the maze this is just a lookup in the goat threat map, which already knows how close the goats are by the way round the hedges.
+	Out of it, the civilian has to look around for one that's within 50 units and in sight.
+*/
+bool Civilian::SensesGoat(float threshold) {
+	Vector3 civPosition = GetTransform().GetPosition();
+	InfluenceMap* threatMap = gameWorld->GetGoatThreat();
+	int x, z;
+	if (threatMap && gameWorld->GetMaze()->WorldToGrid(civPosition, x, z)) {
+		threat = nullptr;
+		return threatMap->GetValue(civPosition) >= threshold;
+	}
+	threat = FindVisibleGoat();
+	return threat != nullptr;
+}
+
+/*
+	The nearest goat within 50 units with a direct line of sight to it, or null.
+	Civilians notice goats all the way around them, not just in front.
+*/
+GameObject* Civilian::FindVisibleGoat() {
+	Vector3 civPosition = GetTransform().GetPosition();
+	PerceivedStimulus goats[4];
+	int count = gameWorld->GetPerception().Sense(civPosition, Vector3(0, 0, -1), 50, 180, StimulusMask(StimulusType::Goat),
+		perceptionCache, goats, 4);
+	for (int i = 0; i < count; i++) {
+		if (gameWorld->CanSee(civPosition, goats[i].object)) {
+			Debug::DrawLine<Debug::AI>(civPosition, goats[i].position, Vector4(1, 0, 0, 1));
+			return goats[i].object;
+		}
+		Debug::DrawLine<Debug::AI>(civPosition, goats[i].position, Vector4(1, 1, 0, 1));
+	}
+	return nullptr;
+}
+
+/*
+	How far the civilian could walk along a heading before hitting something, up to range.
+	In the maze this comes from the hedge distance field, which is far cheaper than raycasting against the whole world.
+	Only hedges count in there though, not other objects.
+*/
+float Civilian::FreeDistance(float heading, float range) {
+	Vector3 civPosition = GetTransform().GetPosition();
+	Vector3 direction = Matrix3::FromEuler(Vector3(0, heading, 0)) * Vector3(0, 0, -1);
+	DistanceField* field = gameWorld->GetMazeDistances();
+	if (field && field->Contains(civPosition)) {
+		return field->RayDistance(civPosition, direction, range);
+	}
+	Ray ray = Ray(civPosition, direction);
+	RayCollision civCollision;
+	if (gameWorld->Raycast(ray, civCollision, true)) {
+		return std::min(civCollision.rayDistance, range);
+	}
+	return range;
+}
+
+/*
+	Which way to turn for the nearest heading outside the fov with 15 units free: -1 for right (lower headings, checked first), 1 for left, 0 if there's none.
+	In the maze the hedge distance field sweeps round for it. Out of it, every degree has to be raycast.
+*/
+int Civilian::FindOpenSide() {
+	Vector3 civPosition = GetTransform().GetPosition();
+	float civDirection = GetTransform().GetOrientation().ToEuler().y;
+	DistanceField* field = gameWorld->GetMazeDistances();
+	if (field && field->Contains(civPosition)) {
+		float heading;
+		if (!field->FindOpenHeading(civPosition, civDirection, 15, (float)fov, 1, heading))
+			return 0;
+		Debug::DrawLine<Debug::AI>(civPosition, civPosition + Matrix3::FromEuler(Vector3(0, heading, 0)) * Vector3(0, 0, -15), Vector4(1, 0, 1, 1));
+		return heading < civDirection ? -1 : 1;
+	}
+	for (float i = fov; i < 180; i += 1) {
+		if (FreeDistance(civDirection - i, 15) >= 15)
+			return -1;
+		if (FreeDistance(civDirection + i, 15) >= 15)
+			return 1;
+	}
+	return 0;
+}
+
+// Nothing within 10 units anywhere across the fov
+bool Civilian::ClearAhead() {
+	Vector3 civPosition = GetTransform().GetPosition();
+	float civDirection = GetTransform().GetOrientation().ToEuler().y;
+	for (float i = -fov; i <= fov; i += step) {
+		float dir = civDirection + i;
+		if (dir < -180)
+			dir += 360;
+		else if (dir > 180)
+			dir -= 360;
+		Vector3 rayDirection = Matrix3::FromEuler(Vector3(0, dir, 0)) * Vector3(0, 0, -1);
+		float distance = FreeDistance(dir, 10);
+		if (distance < 10) {
+			Debug::DrawLine<Debug::AI>(civPosition, civPosition + rayDirection * distance, Vector4(1, 0, 0, 1));
+			return false;
+		}
+		Debug::DrawLine<Debug::AI>(civPosition, civPosition + rayDirection * 10, Vector4(0, 0, 1, 1));
+	}
+	return true;
+}
+
 void Civilian::MoveForward(float dt) {
 	Matrix3 forceRotation = Matrix3::FromEuler(Vector3(0, GetTransform().GetOrientation().ToEuler().y, 0));
-	GetPhysicsObject()->AddForce(forceRotation * Vector3(0, 0, -15 * dt));
+	commands->AddForce(this, forceRotation * Vector3(0, 0, -15 * dt));
+}
+
+/*
+	Running used to just be walking forward faster, which often meant running into a hedge or towards the goat.
+	Now the civilian heads whichever way FindFleeDirection picks, and turns to face it as it runs.
+*/
+void Civilian::RunFrom(float dt) {
+	Vector3 direction;
+	if (!FindFleeDirection(GetTransform().GetPosition(), direction)) {
+		MoveForward(dt);
+		return;
+	}
+	float yaw = GetTransform().GetOrientation().ToEuler().y;
+	float directionYaw = atan2(-direction.x, -direction.z) * 180 / PI;
+	float yawDiff = directionYaw - yaw;
+	if (yawDiff > 180)
+		yawDiff -= 360;
+	else if (yawDiff < -180)
+		yawDiff += 360;
+
+	commands->AddTorque(this, Vector3(0, sqrt(abs(yawDiff)) * (yawDiff < 0 ? -1 : 1) * 5 * dt, 0));
+	commands->AddForce(this, direction * 15 * dt);
+}
+
+/*
+	In the maze, towards whichever node around has the least goat threat, steering clear of other civilians too.
+	Where the threat map is no help, in a dip in it, the flee field of the closest goat takes over, which heads for somewhere with more than one way out.
+	Out of the maze, just straight away from the goat that was seen.
+*/
+bool Civilian::FindFleeDirection(const Vector3& civPosition, Vector3& direction) {
+	if (threat) {
+		direction = civPosition - threat->GetTransform().GetPosition();
+		direction.y = 0;
+		if (direction.LengthSquared() < 0.0001f)
+			return false;
+		direction = direction.Normalised();
+		return true;
+	}
+	InfluenceMap* threatMap = gameWorld->GetGoatThreat();
+	if (threatMap && threatMap->GetLowestDirection(civPosition, direction, gameWorld->GetCivilianDensity(), CROWD_AVOIDANCE))
+		return true;
+	FlowField* closest = nullptr;
+	float closestDistance = FLT_MAX;
+	for (GameObject* goat : gameWorld->GetGoatsInMaze()) {
+		FlowField* field = gameWorld->GetGoatFlowField(goat);
+		float distance = field ? field->GetDistance(civPosition) : FLT_MAX;
+		if (distance < closestDistance) {
+			closestDistance = distance;
+			closest = field;
+		}
+	}
+	return closest && closest->GetFleeDirection(civPosition, direction);
 }
 
 void Civilian::TurnLeft(float dt) {
-	GetPhysicsObject()->AddTorque(Vector3(0, 5 * dt, 0));
+	commands->AddTorque(this, Vector3(0, 5 * dt, 0));
 }
 
 void Civilian::TurnRight(float dt) {
-	GetPhysicsObject()->AddTorque(Vector3(0, -5 * dt, 0));
+	commands->AddTorque(this, Vector3(0, -5 * dt, 0));
 }
\ No newline at end of file
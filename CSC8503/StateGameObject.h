@@ -1,5 +1,8 @@
 #pragma once
 #include "GameObject.h"
+#include "AICommandBuffer.h"
+#include "PerceptionSystem.h"
+#include "StateTable.h"
 
 namespace NCL {
     namespace CSC8503 {
@@ -10,24 +13,35 @@ namespace NCL {
             StateGameObject(std::string name, GameWorld* gameWorld);
             ~StateGameObject();
 
-            virtual void Update(float dt);
+            // Only reads the world - anything the state machine does to it is recorded in commands
+            virtual void Update(float dt, AICommandBuffer& commands);
+            // Does it all straight away
+            void Update(float dt);
 
         protected:
 
             StateMachine* stateMachine;
             GameWorld* gameWorld;
+            // Only valid during Update
+            AICommandBuffer* commands;
         };
 
         class MagicBall : public StateGameObject {
         public:
             MagicBall(std::string name, GameWorld* gameWorld);
 
+            using StateGameObject::Update;
+            void Update(float dt, AICommandBuffer& commands) override;
+
             void SetStartPos(Vector3 startPos) {
                 this->startPos = startPos;
             }
 
         protected:
+            static const StateTable<MagicBall>& GetStateTable();
+
             Vector3 startPos;
+            int state;
             void MoveLeft(float dt);
             void MoveRight(float dt);
             void MoveForward(float dt);
@@ -42,7 +56,19 @@ namespace NCL {
             int fov;
             // Originally every degree was checked but this was very expensive to do... checking only every 10 degrees is basically just as good and much faster!
             int step;
+            // The goat last seen nearby when out of the maze, which running takes us away from
+            GameObject* threat;
+            PerceptionCache perceptionCache;
+            // Which way decideDirection found to turn, -1 for right, 1 for left and 0 for neither
+            int turnSide;
+            bool SensesGoat(float threshold);
+            GameObject* FindVisibleGoat();
+            float FreeDistance(float heading, float range);
+            int FindOpenSide();
+            bool ClearAhead();
             void MoveForward(float dt);
+            void RunFrom(float dt);
+            bool FindFleeDirection(const Vector3& civPosition, Vector3& direction);
             void TurnLeft(float dt);
             void TurnRight(float dt);
         };
@@ -23,6 +23,13 @@ TutorialGame::TutorialGame(bool local) : local(local){
 
 	physics		= new PhysicsSystem(*world);
 
+	jobs		= new JobSystem();
+	world->SetJobSystem(jobs);
+	aiScheduler	= new AIScheduler(*world);
+	aiScheduler->SetJobSystem(jobs);
+	gooseBatch	= new BehaviourBatch<Goose>(Goose::GetBehaviourTable());
+	physics->DeferCollisionEvents(true);
+
 	forceMagnitude	= 10.0f;
 	useGravity		= true;
 	inSelectionMode = false;
@@ -88,9 +95,12 @@ TutorialGame::~TutorialGame()	{
 	delete dogeTex;
 	delete hedgeTex;
 
+	delete aiScheduler;
 	delete physics;
 	delete renderer;
 	delete world;
+	delete gooseBatch; //only once the geese are gone
+	delete jobs;
 }
 
 void TutorialGame::UpdateGame(float dt) {
@@ -152,6 +162,14 @@ void TutorialGame::UpdateGame(float dt) {
 		else {
 			Debug::Print("(G)ravity off", Vector2(5, 95), Debug::RED);
 		}
+		Debug::Print(physics->UsingLOD() ? "Physics LOD (M) on" : "Physics LOD (M) off", Vector2(5, 80));
+		Debug::Print("AI: " + std::to_string((int)(aiScheduler->GetLastUpdateMS() * 1000.0f)) + "us, ticked " + std::to_string(aiScheduler->GetTickedCount())
+			+ "/" + std::to_string(aiScheduler->GetAgentCount()) + ", deferred " + std::to_string(aiScheduler->GetDeferredCount()), Vector2(5, 75));
+		if (selectionObject) {
+			if (const AIAgentStats* stats = aiScheduler->GetStats(selectionObject)) {
+				Debug::Print("Selected AI: LOD " + std::to_string(stats->lodLevel) + ", " + std::to_string((int)(stats->averageCostMS * 1000.0f)) + "us/tick", Vector2(5, 70));
+			}
+		}
 
 		RayCollision closestCollision;
 		if (Window::GetKeyboard()->KeyPressed(KeyboardKeys::K) && selectionObject) {
@@ -217,18 +235,30 @@ void TutorialGame::UpdateGame(float dt) {
 		gameDurationRemaining = 5;
 	}
 	
-	for (StateGameObject* i : stateGameObjects)
-		i->Update(dt);
-
-	for (BehaviourTreeObject* i : behaviourTreeObjects)
-		i->Execute(dt);
+	aiScheduler->Update(dt); //state machines and behaviour trees, within the AI's slice of the frame
 
 	world->UpdateWorld(dt);
 	renderer->Update(dt);
-	physics->Update(dt);
 
+	/*
+	The frame is pipelined: the world is frozen into a snapshot, then the
+	next physics step runs on the job system while the renderer and network
+	code work from the snapshot. Collision callbacks are held back until
+	physics is done, so game code never runs on two threads at once.
+	*/
+	world->CaptureSnapshot();
+
+	JobCounter physicsDone;
+	jobs->Run([&]() {
+		physics->Update(dt);
+	}, &physicsDone);
+
+	UpdateFromSnapshot(dt);
 	renderer->Render();
 	Debug::UpdateRenderables(dt);
+
+	jobs->Wait(physicsDone);
+	physics->DispatchCollisionEvents();
 }
 
 
@@ -291,6 +321,10 @@ void TutorialGame::UpdateKeys() {
 		useGravity = !useGravity; //Toggle gravity!
 		physics->UseGravity(useGravity);
 	}
+
+	if (Window::GetKeyboard()->KeyPressed(KeyboardKeys::F4)) {
+		Debug::SetLinesEnabled(Debug::GetLinesEnabled() ^ (Debug::AI | Debug::Pathfinding)); //F4 toggles the AI's whiskers and paths
+	}
 	//Running certain physics updates in a consistent order might cause some
 	//bias in the calculations - the same objects might keep 'winning' the constraint
 	//allowing the other one to stretch too much etc. Shuffling the order so that it
@@ -412,6 +446,7 @@ void TutorialGame::InitWorld(bool local) {
 	physics->Clear();
 	stateGameObjects.clear();
 	behaviourTreeObjects.clear();
+	aiScheduler->Clear();
 
 	AddGrassFloor();
 	AddMazeToWorld("CornMaze.txt", Vector3(-175, -20, -175));
@@ -653,8 +688,13 @@ StateGameObject* TutorialGame::AddCivilianToWorld(const Vector3& position) {
 	civilian->GetTransform().SetOrientation(Quaternion::EulerAnglesToQuaternion(0, rand() % 360, 0));
 
 	world->AddGameObject(civilian);
+	world->GetCrowd().AddAgent(civilian, 0.3f * meshSize * 1.414f, 5.0f);
+	if (world->GetCivilianDensity()) {
+		world->GetCivilianDensity()->AddSource(civilian);
+	}
 
 	stateGameObjects.push_back(civilian);
+	aiScheduler->AddAgent(civilian, [civilian](float dt, AICommandBuffer& commands) { civilian->Update(dt, commands); }, true);
 
 	return civilian;
 }
@@ -699,6 +739,7 @@ StateGameObject* TutorialGame::AddMagicBallToWorld(const Vector3& position, floa
 	world->AddGameObject(magicBall);
 
 	stateGameObjects.push_back(magicBall);
+	aiScheduler->AddAgent(magicBall, [magicBall](float dt, AICommandBuffer& commands) { magicBall->Update(dt, commands); }, true);
 	return magicBall;
 }
 
@@ -724,7 +765,7 @@ BehaviourTreeObject* TutorialGame::AddGooseToWorld(const Vector3& position) {
 	float meshSize = 1.5f;
 	float inverseMass = 1.5f;
 
-	BehaviourTreeObject* goose = new Goose(world);
+	BehaviourTreeObject* goose = new Goose(world, *gooseBatch);
 
 	AABBVolume* volume = new AABBVolume(Vector3(0.3f, 0.9f, 0.3f) * meshSize);
 	goose->SetBoundingVolume((CollisionVolume*)volume);
@@ -743,8 +784,12 @@ BehaviourTreeObject* TutorialGame::AddGooseToWorld(const Vector3& position) {
 	goose->setCFric(0.5f);
 
 	world->AddGameObject(goose);
+	world->GetPerception().AddSource(goose, StimulusType::Goose);
+	world->GetCrowd().AddAgent(goose, 0.3f * meshSize * 1.414f, 10.0f);
 
 	behaviourTreeObjects.push_back(goose);
+	// Not thread safe - it keeps its replanner and path requests in the world
+	aiScheduler->AddAgent(goose, [goose](float dt, AICommandBuffer& commands) { goose->Execute(dt, commands); });
 
 	return goose;
 }
@@ -817,11 +862,11 @@ void TutorialGame::AddMazeToWorld(string fileName, Vector3 zeroPos) {
 	int height = maze->GetHeight();
 	int width = maze->GetWidth();
 
-	vector<GridNode> allNodes = maze->GetNodes();
+	std::span<const GridNode> allNodes = maze->GetNodes();
 
 	for (int z = 0; z < height; z++) {
 		for (int x = 0; x < width; x++) {
-			GridNode& n = allNodes[(width * z) + x];
+			const GridNode& n = allNodes[(width * z) + x];
 			if(n.type == 'x')
 				AddHedgeToWorld(n.position + Vector3(0, 10.0f, 0), Vector3((float)nodeSize/2, 10.0f, (float)nodeSize/2), "Maze Node " + (width * z) + x);
 		}
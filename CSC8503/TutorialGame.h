@@ -4,6 +4,8 @@
 #include "GameTechVulkanRenderer.h"
 #endif
 #include "PhysicsSystem.h"
+#include "JobSystem.h"
+#include "AIScheduler.h"
 
 #include "StateGameObject.h"
 #include "BehaviourTreeObject.h"
@@ -19,6 +21,9 @@ namespace NCL {
 			virtual void UpdateGame(float dt);
 
 		protected:
+			// Runs alongside physics, so may only read the world through its snapshot
+			virtual void UpdateFromSnapshot(float dt) {}
+
 			void InitialiseAssets();
 
 			void InitCamera();
@@ -79,6 +84,9 @@ namespace NCL {
 #endif
 			PhysicsSystem*		physics;
 			GameWorld*			world;
+			JobSystem*			jobs;
+			AIScheduler*		aiScheduler;
+			BehaviourBatch<Goose>*	gooseBatch;
 
 			bool local;
 			int finalScore;
@@ -0,0 +1,28 @@
+#include "AICommandBuffer.h"
+#include "GameObject.h"
+#include "PhysicsObject.h"
+
+using namespace NCL;
+using namespace CSC8503;
+
+void AICommandBuffer::AddForce(GameObject* object, const Vector3& force) {
+	commands.push_back({ CommandType::Force, object, force });
+}
+
+void AICommandBuffer::AddTorque(GameObject* object, const Vector3& torque) {
+	commands.push_back({ CommandType::Torque, object, torque });
+}
+
+void AICommandBuffer::Apply() {
+	for (const Command& c : commands) {
+		switch (c.type) {
+			case CommandType::Force:
+				c.object->GetPhysicsObject()->AddForce(c.a);
+				break;
+			case CommandType::Torque:
+				c.object->GetPhysicsObject()->AddTorque(c.a);
+				break;
+		}
+	}
+	commands.clear();
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include "Vector3.h"
+#include "Vector4.h"
+#include <vector>
+
+namespace NCL {
+	using namespace NCL::Maths;
+
+	namespace CSC8503 {
+		class GameObject;
+
+		/*
+		Agents updated on worker threads can only look at the world, not
+		change it, so whatever they want to do to it is written down here
+		instead. Once they're all done, the main thread carries the commands
+		out in the order they were recorded.
+
+		Debug lines don't need to come through here, Debug::DrawLine can be
+		called from any thread, and the scheduler keeps them in order.
+		*/
+		class AICommandBuffer {
+		public:
+			void AddForce(GameObject* object, const Vector3& force);
+			void AddTorque(GameObject* object, const Vector3& torque);
+
+			// Carries out every command, then empties the buffer
+			void Apply();
+
+			// Keeps the memory around for the next frame's commands
+			void Clear() {
+				commands.clear();
+			}
+
+			int GetCommandCount() const {
+				return (int)commands.size();
+			}
+
+		protected:
+			enum class CommandType {
+				Force,
+				Torque
+			};
+
+			struct Command {
+				CommandType	type;
+				GameObject*	object;
+				Vector3		a;
+			};
+
+			std::vector<Command> commands;
+		};
+	}
+}
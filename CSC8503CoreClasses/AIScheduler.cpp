@@ -0,0 +1,223 @@
+#include "AIScheduler.h"
+#include "Debug.h"
+#include "GameObject.h"
+#include "GameWorld.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+
+using namespace NCL;
+using namespace CSC8503;
+
+typedef std::chrono::steady_clock AIClock;
+
+static float MillisecondsBetween(AIClock::time_point from, AIClock::time_point to) {
+	return std::chrono::duration<float, std::milli>(to - from).count();
+}
+
+AIScheduler::AIScheduler(const GameWorld& world) : world(world) {
+	jobs			= nullptr;
+	batchSize		= 16;
+	cursor			= 0;
+	ticksStarted	= 0;
+	budgetMS		= 2.0f;
+	maxTickDT		= 0.25f;
+	useLOD			= true;
+	lastUpdateMS	= 0.0f;
+	tickedCount		= 0;
+	deferredCount	= 0;
+	SetLODDistances(40.0f, 80.0f, 160.0f);
+}
+
+AIScheduler::~AIScheduler() {
+}
+
+void AIScheduler::SetLODDistances(float halfRate, float quarterRate, float eighthRate) {
+	lodDistances[0] = halfRate;
+	lodDistances[1] = quarterRate;
+	lodDistances[2] = eighthRate;
+}
+
+void AIScheduler::AddAgent(GameObject* object, const AITickFunc& tick, bool threadSafe) {
+	if (agentIndices.count(object)) {
+		return;
+	}
+	Agent a;
+	a.object		= object;
+	a.tick			= tick;
+	a.threadSafe	= threadSafe;
+	a.pendingDT		= 0.0f;
+	a.framesWaiting	= 0;
+	agentIndices[object] = (int)agents.size();
+	agents.emplace_back(a);
+}
+
+// Swaps the last agent into the gap, same as the world does with its objects
+void AIScheduler::RemoveAgent(GameObject* object) {
+	auto i = agentIndices.find(object);
+	if (i == agentIndices.end()) {
+		return;
+	}
+	int index = i->second;
+	agentIndices.erase(i);
+	if (index != (int)agents.size() - 1) {
+		agents[index] = std::move(agents.back());
+		agentIndices[agents[index].object] = index;
+	}
+	agents.pop_back();
+	if (cursor >= (int)agents.size()) {
+		cursor = 0;
+	}
+}
+
+void AIScheduler::Clear() {
+	agents.clear();
+	agentIndices.clear();
+	cursor			= 0;
+	lastUpdateMS	= 0.0f;
+	tickedCount		= 0;
+	deferredCount	= 0;
+}
+
+const AIAgentStats* AIScheduler::GetStats(const GameObject* object) const {
+	auto i = agentIndices.find(object);
+	return i == agentIndices.end() ? nullptr : &agents[i->second].stats;
+}
+
+void AIScheduler::UpdateLODLevels() {
+	const std::vector<GameObject*>& goats = world.GetGoats();
+	for (Agent& a : agents) {
+		if (!useLOD || goats.empty()) {
+			a.stats.lodLevel = 0;
+			continue;
+		}
+		Vector3 position = a.object->GetTransform().GetPosition();
+		float nearest = FLT_MAX;
+		for (GameObject* goat : goats) {
+			nearest = std::min(nearest, (goat->GetTransform().GetPosition() - position).LengthSquared());
+		}
+		int level = 0;
+		while (level < 3 && nearest > lodDistances[level] * lodDistances[level]) {
+			level++;
+		}
+		a.stats.lodLevel = level;
+	}
+}
+
+/*
+Each agent's cost is estimated from its running average, with thread safe
+agents' costs shared out across the workers. The round stops at the first
+due agent that wouldn't fit in what's left of the budget. At least one
+agent always gets a go, so a single expensive one can't stall everything
+behind it.
+*/
+void AIScheduler::SelectAgents() {
+	parallelTicks.clear();
+	serialTicks.clear();
+
+	int lanes = jobs ? (int)jobs->GetWorkerCount() + 1 : 1;
+	float serialMS = 0.0f;
+	float parallelMS = 0.0f;
+
+	int count = (int)agents.size();
+	int visited = 0;
+	for (; visited < count; ++visited) {
+		int index = (cursor + visited) % count;
+		const Agent& a = agents[index];
+		if (!IsDue(a)) {
+			continue;
+		}
+		float cost = a.stats.averageCostMS;
+		float estimate = a.threadSafe ? serialMS + (parallelMS + cost) / lanes : serialMS + cost + parallelMS / lanes;
+		if (!(parallelTicks.empty() && serialTicks.empty()) && estimate > budgetMS) {
+			break;
+		}
+		if (a.threadSafe) {
+			parallelMS += cost;
+			parallelTicks.push_back(index);
+		}
+		else {
+			serialMS += cost;
+			serialTicks.push_back(index);
+		}
+	}
+	for (int i = visited; i < count; ++i) {
+		if (IsDue(agents[(cursor + i) % count])) {
+			deferredCount++;
+		}
+	}
+	cursor = count == 0 ? 0 : (cursor + visited) % count;
+}
+
+void AIScheduler::RunParallelTicks() {
+	batches.clear();
+	for (int first = 0; first < (int)parallelTicks.size(); first += batchSize) {
+		batches.push_back({ first, std::min(batchSize, (int)parallelTicks.size() - first), nullptr });
+	}
+	if (batchCommands.size() < batches.size()) {
+		batchCommands.resize(batches.size());
+	}
+	for (int i = 0; i < (int)batches.size(); ++i) {
+		batches[i].commands = &batchCommands[i];
+	}
+
+	auto runBatch = [&](TickBatch& batch) {
+		for (int i = batch.first; i < batch.first + batch.count; ++i) {
+			TickAgent(agents[parallelTicks[i]], *batch.commands, ticksStarted + i + 1);
+		}
+	};
+	if (jobs) {
+		jobs->ParallelFor(std::span<TickBatch>(batches), runBatch, 1);
+	}
+	else {
+		for (TickBatch& batch : batches) {
+			runBatch(batch);
+		}
+	}
+}
+
+void AIScheduler::TickAgent(Agent& a, AICommandBuffer& commands, uint64_t lineKey) {
+	AIClock::time_point start = AIClock::now();
+	float tickDT = std::min(a.pendingDT, maxTickDT);
+	Debug::SetLineKey(lineKey);
+	a.tick(tickDT, commands);
+	Debug::SetLineKey(0);
+	float cost = MillisecondsBetween(start, AIClock::now());
+
+	a.pendingDT			= 0.0f;
+	a.framesWaiting		= 0;
+	a.stats.ticks++;
+	a.stats.lastTickDT		= tickDT;
+	a.stats.lastCostMS		= cost;
+	a.stats.averageCostMS	= a.stats.ticks == 1 ? cost : a.stats.averageCostMS * 0.9f + cost * 0.1f;
+}
+
+void AIScheduler::Update(float dt) {
+	AIClock::time_point start = AIClock::now();
+	tickedCount		= 0;
+	deferredCount	= 0;
+
+	UpdateLODLevels();
+	for (Agent& a : agents) {
+		a.pendingDT += dt;
+		a.framesWaiting++;
+	}
+	SelectAgents();
+
+	RunParallelTicks();
+	uint64_t serialKey = ticksStarted + parallelTicks.size();
+	for (size_t i = 0; i < serialTicks.size(); ++i) {
+		TickAgent(agents[serialTicks[i]], serialCommands, serialKey + i + 1);
+	}
+	ticksStarted += parallelTicks.size() + serialTicks.size();
+
+	for (const TickBatch& batch : batches) {
+		batch.commands->Apply();
+	}
+	serialCommands.Apply();
+
+	tickedCount = (int)(parallelTicks.size() + serialTicks.size());
+	lastUpdateMS = MillisecondsBetween(start, AIClock::now());
+}
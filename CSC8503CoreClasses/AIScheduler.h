@@ -0,0 +1,169 @@
+#pragma once
+#include "AICommandBuffer.h"
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+namespace NCL {
+	class JobSystem;
+
+	namespace CSC8503 {
+		class GameObject;
+		class GameWorld;
+
+		// Anything the agent wants to do to the world goes in the command buffer
+		typedef std::function<void(float, AICommandBuffer&)> AITickFunc;
+
+		struct AIAgentStats {
+			int		lodLevel		= 0;	// Thinks every 1, 2, 4 or 8 frames
+			int		ticks			= 0;
+			float	lastTickDT		= 0.0f;	// Time handed to the agent on its last tick
+			float	lastCostMS		= 0.0f;
+			float	averageCostMS	= 0.0f;
+		};
+
+		/*
+		Rather than every agent thinking every frame, the AI gets a fixed slice
+		of each frame. Agents near a goat want to think every frame, those
+		further away only every 2nd, 4th or 8th, like the physics LOD. Whoever
+		is due gets a go, round robin, until the slice is used up, and the next
+		frame carries on from where this one stopped - so adding agents spreads
+		their thinking thinner rather than making the frame longer.
+
+		An agent that misses frames is handed all the time it missed on its
+		next tick, so it still moves as far as it would have.
+
+		Agents added as thread safe are split into batches that run across
+		the job system. The world must be left alone while they run - they
+		can look at it, but their changes go into the batch's own command
+		buffer. Those are applied in batch order once every agent is done,
+		so the result doesn't depend on which thread ran what. Debug lines
+		are keyed by each agent's place in the tick order, so they come out
+		in that order too. Any other agents then run on the calling thread,
+		with their commands applied last.
+
+		Agents must not be added or removed from inside a tick.
+		*/
+		class AIScheduler {
+		public:
+			AIScheduler(const GameWorld& world);
+			~AIScheduler();
+
+			void AddAgent(GameObject* object, const AITickFunc& tick, bool threadSafe = false);
+			void RemoveAgent(GameObject* object);
+			void Clear();
+
+			void Update(float dt);
+
+			// Without one every agent runs on the calling thread
+			void SetJobSystem(JobSystem* jobs) {
+				this->jobs = jobs;
+			}
+
+			void SetBatchSize(int agents) {
+				batchSize = std::max(agents, 1);
+			}
+
+			void SetBudget(float milliseconds) {
+				budgetMS = milliseconds;
+			}
+
+			float GetBudget() const {
+				return budgetMS;
+			}
+
+			void UseLOD(bool state) {
+				useLOD = state;
+			}
+
+			// Distances from the nearest goat past which agents drop to 1/2, 1/4 and 1/8 rate
+			void SetLODDistances(float halfRate, float quarterRate, float eighthRate);
+
+			// However long an agent has waited, it's never handed more than this in one tick
+			void SetMaxTickDT(float dt) {
+				maxTickDT = dt;
+			}
+
+			int GetAgentCount() const {
+				return (int)agents.size();
+			}
+
+			// How long the last Update spent ticking agents
+			float GetLastUpdateMS() const {
+				return lastUpdateMS;
+			}
+
+			int GetTickedCount() const {
+				return tickedCount;
+			}
+
+			// Agents that were due in the last Update, but didn't fit in the budget
+			int GetDeferredCount() const {
+				return deferredCount;
+			}
+
+			// Null if the object isn't scheduled
+			const AIAgentStats* GetStats(const GameObject* object) const;
+
+			const AIAgentStats& GetStats(int agent) const {
+				return agents[agent].stats;
+			}
+
+			GameObject* GetAgentObject(int agent) const {
+				return agents[agent].object;
+			}
+
+		protected:
+			struct Agent {
+				GameObject*		object;
+				AITickFunc		tick;
+				bool			threadSafe;
+				float			pendingDT;
+				int				framesWaiting;
+				AIAgentStats	stats;
+			};
+
+			struct TickBatch {
+				int					first;	// Into parallelTicks
+				int					count;
+				AICommandBuffer*	commands;
+			};
+
+			void UpdateLODLevels();
+			void SelectAgents();
+			void RunParallelTicks();
+			void TickAgent(Agent& a, AICommandBuffer& commands, uint64_t lineKey);
+
+			bool IsDue(const Agent& a) const {
+				return a.framesWaiting >= (1 << a.stats.lodLevel);
+			}
+
+			const GameWorld& world;
+			JobSystem*		jobs;
+
+			std::vector<Agent>						agents;
+			std::unordered_map<const GameObject*, int>	agentIndices;
+
+			// This frame's picks, as indices into agents
+			std::vector<int>				parallelTicks;
+			std::vector<int>				serialTicks;
+			std::vector<TickBatch>			batches;
+			std::vector<AICommandBuffer>	batchCommands;	// Kept between frames, so they stay allocated
+			AICommandBuffer					serialCommands;
+			int								batchSize;
+			uint64_t						ticksStarted;	// Keys the debug lines, counting every tick ever run
+
+			int		cursor;		// Where the next Update starts its round
+			float	budgetMS;
+			float	maxTickDT;
+			bool	useLOD;
+			float	lodDistances[3];
+
+			float	lastUpdateMS;
+			int		tickedCount;
+			int		deferredCount;
+		};
+	}
+}
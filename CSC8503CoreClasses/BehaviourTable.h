@@ -0,0 +1,378 @@
+#pragma once
+#include "BehaviourNode.h"
+#include "Blackboard.h"
+#include <algorithm>
+#include <initializer_list>
+#include <vector>
+
+namespace NCL {
+	namespace CSC8503 {
+		// One per node that needs to remember something between frames, like a timer
+		union BehaviourSlot {
+			float			time;
+			unsigned int	version;
+		};
+
+		/*
+		A behaviour tree for when there's lots of agents of the same type.
+		Rather than each agent building its own tree out of nodes on the heap,
+		the tree is described once and shared, with its nodes laid out one
+		after another in a single array - each node is followed by its
+		children, and knows where its subtree ends, so skipping over a branch
+		is just a jump. All each agent keeps is a byte per node for its state,
+		plus a slot for each timer or watched key version, so a whole lot of
+		agents can sit together in a BehaviourBatch.
+
+		As with StateTable, the actions, guards and services are plain
+		function pointers taking the agent. Observers and conditions watch
+		keys on the agent's blackboard (found with GetBlackboard), by
+		checking whether the keys' versions have moved on since they last
+		looked - so every agent using a table must add its keys in the same
+		order.
+
+		The tree is built up by opening composites and decorators, adding
+		their children, and closing them again:
+
+			t.BeginSequence();
+				t.AddAction(...);
+				t.BeginCooldown(1.0f);
+					t.AddAction(...);
+				t.End();
+			t.End();
+			t.Compile();
+		*/
+		template <typename Context>
+		class BehaviourTable {
+		public:
+			typedef BehaviourState (*ActionFunc)(Context&, float, BehaviourState);
+			typedef bool (*GuardFunc)(Context&);
+			typedef void (*ServiceFunc)(Context&, float);
+
+			void AddAction(ActionFunc func) {
+				Node& n		= AddNode(NodeType::Action, 0);
+				n.action	= func;
+				n.end		= (int)nodes.size();
+				n.slotEnd	= slotCount;
+			}
+
+			void BeginSequence() {
+				Open(NodeType::Sequence, 0);
+			}
+
+			void BeginSelector() {
+				Open(NodeType::Selector, 0);
+			}
+
+			void BeginParallel() {
+				Open(NodeType::Parallel, 0);
+			}
+
+			// Only re-runs its child once one of the keys has changed
+			void BeginObserver(std::initializer_list<int> watched) {
+				Open(NodeType::Observer, 2);
+				AddKeys(watched);
+			}
+
+			// Only runs its child while the guard passes, checking again once one of the keys changes
+			void BeginCondition(std::initializer_list<int> watched, GuardFunc guard) {
+				Open(NodeType::Condition, 3);
+				AddKeys(watched);
+				nodes.back().guard = guard;
+			}
+
+			// Hands back the child's last result for a while after it finishes
+			void BeginCooldown(float cooldown) {
+				Open(NodeType::Cooldown, 1);
+				nodes.back().time = cooldown;
+			}
+
+			// Calls func every interval seconds, then runs the child
+			void BeginService(float interval, ServiceFunc func) {
+				Open(NodeType::Service, 2);
+				nodes.back().time		= interval;
+				nodes.back().service	= func;
+			}
+
+			// Closes the last composite or decorator to be opened
+			void End() {
+				Node& n		= nodes[open.back()];
+				n.end		= (int)nodes.size();
+				n.slotEnd	= slotCount;
+				open.pop_back();
+			}
+
+			// Must be called once the whole tree has been added, before anything runs it
+			void Compile() {
+				compiled = open.empty() && !nodes.empty();
+			}
+
+			bool IsCompiled() const {
+				return compiled;
+			}
+
+			int GetNodeCount() const {
+				return (int)nodes.size();
+			}
+
+			int GetSlotCount() const {
+				return slotCount;
+			}
+
+			// What each agent needs to keep to run this tree
+			int GetInstanceSize() const {
+				return (int)(nodes.size() * sizeof(unsigned char) + slotCount * sizeof(BehaviourSlot));
+			}
+
+			// Puts an agent's states and slots back to how they were before it ever ran
+			void ResetInstance(unsigned char* states, BehaviourSlot* slots) const {
+				ResetRange(0, states, slots);
+			}
+
+			BehaviourState Execute(Context& context, unsigned char* states, BehaviourSlot* slots, float dt) const {
+				return Run(0, context, states, slots, dt);
+			}
+
+		protected:
+			enum class NodeType : unsigned char {
+				Action,
+				Sequence,
+				Selector,
+				Parallel,
+				Observer,
+				Condition,
+				Cooldown,
+				Service
+			};
+
+			struct Node {
+				NodeType	type;
+				int			end;		// One past the last node in this one's subtree
+				int			firstSlot;
+				int			slotEnd;	// One past the last slot used in this one's subtree
+				int			firstKey;
+				int			keyCount;
+				float		time;
+				ActionFunc	action;
+				GuardFunc	guard;
+				ServiceFunc	service;
+			};
+
+			Node& AddNode(NodeType type, int slots) {
+				Node n = {};
+				n.type		= type;
+				n.firstSlot	= slotCount;
+				n.firstKey	= (int)keys.size();
+				slotCount	+= slots;
+				nodes.push_back(n);
+				return nodes.back();
+			}
+
+			void Open(NodeType type, int slots) {
+				AddNode(type, slots);
+				open.push_back((int)nodes.size() - 1);
+			}
+
+			void AddKeys(std::initializer_list<int> watched) {
+				keys.insert(keys.end(), watched.begin(), watched.end());
+				nodes.back().keyCount = (int)watched.size();
+			}
+
+			/*
+			Observers and conditions keep the blackboard's change count and the
+			total of their keys' versions from the last time they checked, in
+			their first two slots. Versions only ever go up, so the total only
+			stays the same if none of the keys changed - and if nothing on the
+			blackboard has changed at all, the keys don't need looking at.
+			*/
+			bool KeysChanged(const Node& n, const Context& context, BehaviourSlot* slot) const {
+				const Blackboard& blackboard = context.GetBlackboard();
+				if (blackboard.GetChangeCount() == slot[0].version) {
+					return false;
+				}
+				slot[0].version = blackboard.GetChangeCount();
+				unsigned int total = 0;
+				for (int i = n.firstKey; i < n.firstKey + n.keyCount; ++i) {
+					total += blackboard.GetVersion(keys[i]);
+				}
+				if (total == slot[1].version) {
+					return false;
+				}
+				slot[1].version = total;
+				return true;
+			}
+
+			void ResetRange(int node, unsigned char* states, BehaviourSlot* slots) const {
+				const Node& n = nodes[node];
+				std::fill(states + node, states + n.end, (unsigned char)Initialise);
+				std::fill(slots + n.firstSlot, slots + n.slotEnd, BehaviourSlot{});
+			}
+
+			BehaviourState Run(int index, Context& context, unsigned char* states, BehaviourSlot* slots, float dt) const {
+				const Node& n			= nodes[index];
+				BehaviourState state	= (BehaviourState)states[index];
+				BehaviourSlot* slot		= slots + n.firstSlot;
+				int child				= index + 1;
+
+				switch (n.type) {
+					case NodeType::Action: {
+						state = n.action(context, dt, state);
+					}break;
+					case NodeType::Sequence: {
+						state = Success;
+						for (; child < n.end; child = nodes[child].end) {
+							BehaviourState childState = Run(child, context, states, slots, dt);
+							if (childState != Success) {
+								state = childState;
+								break;
+							}
+						}
+					}break;
+					case NodeType::Selector: {
+						state = Failure;
+						for (; child < n.end; child = nodes[child].end) {
+							BehaviourState childState = Run(child, context, states, slots, dt);
+							if (childState != Failure) {
+								state = childState;
+								break;
+							}
+						}
+					}break;
+					case NodeType::Parallel: {
+						state = Success;
+						for (; child < n.end; child = nodes[child].end) {
+							if (Run(child, context, states, slots, dt) == Ongoing) {
+								state = Ongoing;
+							}
+						}
+					}break;
+					case NodeType::Observer: {
+						// Changes while the child is still going get it run again once it's done
+						if (state == Ongoing) {
+							state = Run(child, context, states, slots, dt);
+							break;
+						}
+						if (KeysChanged(n, context, slot) || state == Initialise) {
+							state = Run(child, context, states, slots, dt);
+						}
+					}break;
+					case NodeType::Condition: {
+						// The third slot is whether the guard passed last time it was checked
+						if (KeysChanged(n, context, slot) || state == Initialise) {
+							unsigned int passed = n.guard(context) ? 1 : 0;
+							if (slot[2].version && !passed) {
+								ResetRange(child, states, slots);
+							}
+							slot[2].version = passed;
+						}
+						state = slot[2].version ? Run(child, context, states, slots, dt) : Failure;
+					}break;
+					case NodeType::Cooldown: {
+						slot[0].time -= dt;
+						if (slot[0].time > 0.0f) {
+							break;
+						}
+						state = Run(child, context, states, slots, dt);
+						if (state != Ongoing) {
+							slot[0].time = n.time;
+						}
+					}break;
+					case NodeType::Service: {
+						slot[0].time -= dt;
+						slot[1].time += dt;
+						if (slot[0].time <= 0.0f) {
+							n.service(context, slot[1].time);
+							slot[1].time = 0.0f;
+							slot[0].time = std::max(slot[0].time + n.time, 0.0f);
+						}
+						state = Run(child, context, states, slots, dt);
+					}break;
+				}
+				states[index] = (unsigned char)state;
+				return state;
+			}
+
+			std::vector<Node>	nodes;
+			std::vector<int>	keys;	// What each observer and condition watches, one after another
+			std::vector<int>	open;	// Composites and decorators that haven't been closed yet
+			int					slotCount	= 0;
+			bool				compiled	= false;
+		};
+
+		/*
+		The states and slots of every agent running the same BehaviourTable,
+		kept together in a couple of arrays rather than in vectors of their
+		own spread about the heap. Agents are still ticked one at a time, by
+		whatever schedules them, through the slot they were given when they
+		were added. Slots don't move, and a removed agent's slot is handed
+		to the next one added.
+		*/
+		template <typename Context>
+		class BehaviourBatch {
+		public:
+			BehaviourBatch(const BehaviourTable<Context>& table) : table(table) {
+			}
+
+			int AddAgent(Context* agent) {
+				int slot;
+				if (!freeSlots.empty()) {
+					slot = freeSlots.back();
+					freeSlots.pop_back();
+					agents[slot] = agent;
+				}
+				else {
+					slot = (int)agents.size();
+					agents.push_back(agent);
+					states.resize(agents.size() * table.GetNodeCount());
+					slots.resize(agents.size() * table.GetSlotCount());
+				}
+				table.ResetInstance(StatesFor(slot), SlotsFor(slot));
+				return slot;
+			}
+
+			void RemoveAgent(int slot) {
+				agents[slot] = nullptr;
+				freeSlots.push_back(slot);
+			}
+
+			void Clear() {
+				agents.clear();
+				freeSlots.clear();
+				states.clear();
+				slots.clear();
+			}
+
+			BehaviourState Execute(int slot, float dt) {
+				return table.Execute(*agents[slot], StatesFor(slot), SlotsFor(slot), dt);
+			}
+
+			int GetAgentCount() const {
+				return (int)(agents.size() - freeSlots.size());
+			}
+
+			// What the batch holds for every agent's trees, including free slots
+			size_t GetMemoryUsage() const {
+				return agents.capacity() * sizeof(Context*) + states.capacity() + slots.capacity() * sizeof(BehaviourSlot) +
+					freeSlots.capacity() * sizeof(int);
+			}
+
+			const BehaviourTable<Context>& GetTable() const {
+				return table;
+			}
+
+		protected:
+			unsigned char* StatesFor(int slot) {
+				return states.data() + slot * table.GetNodeCount();
+			}
+
+			BehaviourSlot* SlotsFor(int slot) {
+				return slots.data() + slot * table.GetSlotCount();
+			}
+
+			const BehaviourTable<Context>&	table;
+			std::vector<Context*>			agents;		// Null where a slot is free
+			std::vector<int>				freeSlots;
+			std::vector<unsigned char>		states;
+			std::vector<BehaviourSlot>		slots;
+		};
+	}
+}
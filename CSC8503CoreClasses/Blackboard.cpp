@@ -0,0 +1,13 @@
+#include "Blackboard.h"
+
+using namespace NCL;
+using namespace CSC8503;
+
+int Blackboard::FindKey(const std::string& name) const {
+	for (int i = 0; i < (int)keys.size(); ++i) {
+		if (keys[i].name == name) {
+			return i;
+		}
+	}
+	return -1;
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include "Vector3.h"
+#include <string>
+#include <variant>
+#include <vector>
+
+namespace NCL {
+	using namespace NCL::Maths;
+
+	namespace CSC8503 {
+		class GameObject;
+
+		// Only a Blackboard hands these out, so a key always matches the type stored under it
+		template <typename T>
+		struct BlackboardKey {
+			int index = -1;
+		};
+
+		/*
+		Somewhere for the nodes of a behaviour tree to leave things for each
+		other, rather than going through members of the agent. Setting a key
+		to the value it already has does nothing, so a key's version only
+		moves on with actual changes, and anything watching it can skip its
+		work until it does.
+		*/
+		class Blackboard {
+		public:
+			typedef std::variant<bool, int, float, Vector3, GameObject*> Value;
+
+			template <typename T>
+			BlackboardKey<T> AddKey(const std::string& name, const T& initial = T()) {
+				keys.push_back({ name, Value(initial), 0 });
+				return { (int)keys.size() - 1 };
+			}
+
+			template <typename T>
+			const T& Get(BlackboardKey<T> key) const {
+				return std::get<T>(keys[key.index].value);
+			}
+
+			template <typename T>
+			void Set(BlackboardKey<T> key, const T& value) {
+				Key& k = keys[key.index];
+				if (std::get<T>(k.value) == value) {
+					return;
+				}
+				k.value = value;
+				k.version++;
+				changeCount++;
+			}
+
+			// Returns -1 if there isn't one
+			int FindKey(const std::string& name) const;
+			const std::string& GetKeyName(int key) const {
+				return keys[key].name;
+			}
+
+			// How many times the key has changed
+			unsigned int GetVersion(int key) const {
+				return keys[key].version;
+			}
+
+			// How many times any key has changed, so watchers can tell nothing has without looking at each one
+			unsigned int GetChangeCount() const {
+				return changeCount;
+			}
+
+		protected:
+			struct Key {
+				std::string		name;
+				Value			value;
+				unsigned int	version;
+			};
+			std::vector<Key>	keys;
+			unsigned int		changeCount = 0;
+		};
+	}
+}
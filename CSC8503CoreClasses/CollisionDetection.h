@@ -43,14 +43,12 @@ namespace NCL {
 			}
 
 			//Advanced collision detection / resolution
+			// Ordered by world ID rather than address, so collisions are resolved in the same order every run
 			bool operator < (const CollisionInfo& other) const {
-				size_t otherHash = (size_t)other.a + ((size_t)other.b << 32);
-				size_t thisHash  = (size_t)a + ((size_t)b << 32);
-
-				if (thisHash < otherHash) {
-					return true;
+				if (a->GetWorldID() != other.a->GetWorldID()) {
+					return a->GetWorldID() < other.a->GetWorldID();
 				}
-				return false;
+				return b->GetWorldID() < other.b->GetWorldID();
 			}
 
 			bool operator ==(const CollisionInfo& other) const {
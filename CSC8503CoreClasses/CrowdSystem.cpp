@@ -0,0 +1,439 @@
+/*
+ * ComputeVelocity and LinearProgram1/2/3 are ported from Agent.cpp in the
+ * RVO2 Library, changed to work on this file's arrays of agents and the
+ * engine's maths types. The rest of the file is not from RVO2.
+ *
+ * RVO2 Library
+ *
+ * Copyright 2008 University of North Carolina at Chapel Hill
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * <http://gamma.cs.unc.edu/RVO2/>
+ */
+#include "CrowdSystem.h"
+#include "GameObject.h"
+#include "PhysicsObject.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace NCL;
+using namespace CSC8503;
+
+static const float CrowdEpsilon = 0.00001f;
+
+// The 2D cross product - positive if b points anticlockwise of a
+static float Det(const Vector2& a, const Vector2& b) {
+	return a.x * b.y - a.y * b.x;
+}
+
+CrowdSystem::CrowdSystem(float neighbourDistance, float timeHorizon) {
+	this->neighbourDistance	= neighbourDistance;
+	this->timeHorizon		= timeHorizon;
+	responseTime			= 0.0f;
+	lastDt					= 0.0f;
+	avoidingCount			= 0;
+}
+
+CrowdSystem::~CrowdSystem() {
+}
+
+void CrowdSystem::AddAgent(GameObject* object, float radius, float maxSpeed) {
+	if (agentIndices.count(object)) {
+		return;
+	}
+	agentIndices[object] = (int)objects.size();
+	objects.push_back(object);
+	posX.push_back(0.0f);
+	posZ.push_back(0.0f);
+	velX.push_back(0.0f);
+	velZ.push_back(0.0f);
+	newVelX.push_back(0.0f);
+	newVelZ.push_back(0.0f);
+	radii.push_back(radius);
+	maxSpeeds.push_back(maxSpeed);
+	inverseMasses.push_back(0.0f);
+}
+
+template <typename T>
+static void SwapRemove(std::vector<T>& values, int index) {
+	values[index] = values.back();
+	values.pop_back();
+}
+
+// Swaps the last agent into the gap
+void CrowdSystem::RemoveAgent(GameObject* object) {
+	auto i = agentIndices.find(object);
+	if (i == agentIndices.end()) {
+		return;
+	}
+	int index = i->second;
+	agentIndices.erase(i);
+	SwapRemove(objects, index);
+	SwapRemove(posX, index);
+	SwapRemove(posZ, index);
+	SwapRemove(velX, index);
+	SwapRemove(velZ, index);
+	SwapRemove(newVelX, index);
+	SwapRemove(newVelZ, index);
+	SwapRemove(radii, index);
+	SwapRemove(maxSpeeds, index);
+	SwapRemove(inverseMasses, index);
+	if (index < (int)objects.size()) {
+		agentIndices[objects[index]] = index;
+	}
+	// The hash still has the old indices in, so it's no good until the next update
+	sortedAgents.clear();
+	bucketStart.clear();
+}
+
+void CrowdSystem::Clear() {
+	objects.clear();
+	posX.clear();
+	posZ.clear();
+	velX.clear();
+	velZ.clear();
+	newVelX.clear();
+	newVelZ.clear();
+	radii.clear();
+	maxSpeeds.clear();
+	inverseMasses.clear();
+	agentIndices.clear();
+	sortedAgents.clear();
+	bucketStart.clear();
+	avoidingCount = 0;
+}
+
+int CrowdSystem::BucketFor(int cellX, int cellZ) const {
+	unsigned int h = ((unsigned int)cellX * 73856093u) ^ ((unsigned int)cellZ * 19349663u);
+	return (int)(h & (unsigned int)(bucketStart.size() - 2));
+}
+
+// A counting sort of the agents by bucket, so each bucket's agents end up next to each other
+void CrowdSystem::BuildHash() {
+	int bucketCount = 16;
+	while (bucketCount < (int)objects.size() * 2) {
+		bucketCount *= 2;
+	}
+	bucketStart.assign(bucketCount + 1, 0);
+	agentBuckets.resize(objects.size());
+	sortedAgents.resize(objects.size());
+
+	for (int i = 0; i < (int)objects.size(); ++i) {
+		int b = BucketFor((int)std::floor(posX[i] / neighbourDistance), (int)std::floor(posZ[i] / neighbourDistance));
+		agentBuckets[i] = b;
+		bucketStart[b + 1]++;
+	}
+	for (int b = 0; b < bucketCount; ++b) {
+		bucketStart[b + 1] += bucketStart[b];
+	}
+	// bucketStart[b + 1] is where bucket b ends, so fill each one from the back, keeping agents in order
+	for (int i = (int)objects.size() - 1; i >= 0; --i) {
+		sortedAgents[--bucketStart[agentBuckets[i] + 1]] = i;
+	}
+	// That's left bucketStart[b + 1] where bucket b starts, so shift them all back one
+	for (int b = 0; b < bucketCount; ++b) {
+		bucketStart[b] = bucketStart[b + 1];
+	}
+	bucketStart[bucketCount] = (int)objects.size();
+}
+
+/*
+Up to MaxNeighbours of the nearest agents within the neighbour distance,
+nearest first. Cells that hash to the same bucket are only looked through
+once, and anyone from a far off cell that shares a bucket is dropped by
+the distance check anyway.
+*/
+int CrowdSystem::FindNeighbours(int agent, int* neighbours, float* distances) const {
+	int cellX = (int)std::floor(posX[agent] / neighbourDistance);
+	int cellZ = (int)std::floor(posZ[agent] / neighbourDistance);
+	float rangeSq = neighbourDistance * neighbourDistance;
+
+	int buckets[9];
+	int bucketCount = 0;
+	for (int x = cellX - 1; x <= cellX + 1; ++x) {
+		for (int z = cellZ - 1; z <= cellZ + 1; ++z) {
+			int b = BucketFor(x, z);
+			if (std::find(buckets, buckets + bucketCount, b) == buckets + bucketCount) {
+				buckets[bucketCount++] = b;
+			}
+		}
+	}
+
+	int found = 0;
+	for (int i = 0; i < bucketCount; ++i) {
+		for (int s = bucketStart[buckets[i]]; s < bucketStart[buckets[i] + 1]; ++s) {
+			int other = sortedAgents[s];
+			if (other == agent) {
+				continue;
+			}
+			float dx = posX[other] - posX[agent];
+			float dz = posZ[other] - posZ[agent];
+			float distSq = dx * dx + dz * dz;
+			if (distSq >= rangeSq) {
+				continue;
+			}
+			// Insertion sort, there's only ever a handful
+			int slot = found < MaxNeighbours ? found++ : MaxNeighbours;
+			while (slot > 0 && distances[slot - 1] > distSq) {
+				if (slot < MaxNeighbours) {
+					neighbours[slot]	= neighbours[slot - 1];
+					distances[slot]		= distances[slot - 1];
+				}
+				slot--;
+			}
+			if (slot < MaxNeighbours) {
+				neighbours[slot]	= other;
+				distances[slot]		= distSq;
+			}
+		}
+	}
+	return found;
+}
+
+/*
+Each neighbour rules out a half plane of velocities - the ones that would
+bring the pair within their combined radius before the time horizon is up.
+Each of the pair takes half the responsibility for getting out of the way.
+Whatever velocity is left that's closest to the current one is the new one.
+*/
+void CrowdSystem::ComputeVelocity(int agent, float dt) {
+	int neighbours[MaxNeighbours];
+	float distances[MaxNeighbours];
+	int count = FindNeighbours(agent, neighbours, distances);
+
+	Vector2 position(posX[agent], posZ[agent]);
+	Vector2 velocity(velX[agent], velZ[agent]);
+	if (count == 0) {
+		newVelX[agent] = velocity.x;
+		newVelZ[agent] = velocity.y;
+		return;
+	}
+
+	float invTimeHorizon = 1.0f / timeHorizon;
+	Line lines[MaxNeighbours];
+	for (int n = 0; n < count; ++n) {
+		int other = neighbours[n];
+		Vector2 relativePosition	= Vector2(posX[other], posZ[other]) - position;
+		Vector2 relativeVelocity	= velocity - Vector2(velX[other], velZ[other]);
+		float distSq				= relativePosition.LengthSquared();
+		float combinedRadius		= radii[agent] + radii[other];
+		float combinedRadiusSq		= combinedRadius * combinedRadius;
+
+		Line& line = lines[n];
+		Vector2 u;
+		if (distSq > combinedRadiusSq) {
+			// Not touching yet. w runs from the centre of the cut off circle to the relative velocity
+			Vector2 w = relativeVelocity - relativePosition * invTimeHorizon;
+			float wLengthSq = w.LengthSquared();
+			float dotProduct = Vector2::Dot(w, relativePosition);
+
+			if (dotProduct < 0.0f && dotProduct * dotProduct > combinedRadiusSq * wLengthSq) {
+				// Closest to the cut off circle at the front of the cone
+				float wLength = std::sqrt(wLengthSq);
+				Vector2 unitW = w / wLength;
+				line.direction = Vector2(unitW.y, -unitW.x);
+				u = unitW * (combinedRadius * invTimeHorizon - wLength);
+			}
+			else {
+				// Closest to one of the legs down the sides of the cone
+				float leg = std::sqrt(distSq - combinedRadiusSq);
+				if (Det(relativePosition, w) > 0.0f) {
+					line.direction = Vector2(relativePosition.x * leg - relativePosition.y * combinedRadius,
+						relativePosition.x * combinedRadius + relativePosition.y * leg) / distSq;
+				}
+				else {
+					line.direction = -Vector2(relativePosition.x * leg + relativePosition.y * combinedRadius,
+						-relativePosition.x * combinedRadius + relativePosition.y * leg) / distSq;
+				}
+				float dotProduct2 = Vector2::Dot(relativeVelocity, line.direction);
+				u = line.direction * dotProduct2 - relativeVelocity;
+			}
+		}
+		else {
+			// Already overlapping, so get apart within this update
+			float invTimeStep = 1.0f / std::max(dt, CrowdEpsilon);
+			Vector2 w = relativeVelocity - relativePosition * invTimeStep;
+			float wLength = w.Length();
+			Vector2 unitW = wLength > 0.0f ? w / wLength : Vector2(1, 0);
+			line.direction = Vector2(unitW.y, -unitW.x);
+			u = unitW * (combinedRadius * invTimeStep - wLength);
+		}
+		line.point = velocity + u * 0.5f;
+	}
+
+	// Never any slower than it's going already, or it'd brake for no reason
+	float speed = std::max(maxSpeeds[agent], velocity.Length());
+	Vector2 result;
+	int failed = LinearProgram2(lines, count, speed, velocity, false, result);
+	if (failed < count) {
+		LinearProgram3(lines, count, failed, speed, result);
+	}
+	newVelX[agent] = result.x;
+	newVelZ[agent] = result.y;
+}
+
+// The best point along line lineNo that's within radius, and on the right side of every line before it
+bool CrowdSystem::LinearProgram1(const Line* lines, int lineNo, float radius, const Vector2& optVelocity, bool directionOpt, Vector2& result) {
+	const Line& line = lines[lineNo];
+	float dotProduct = Vector2::Dot(line.point, line.direction);
+	float discriminant = dotProduct * dotProduct + radius * radius - line.point.LengthSquared();
+	if (discriminant < 0.0f) {
+		return false; // The speed limit rules out the whole line
+	}
+	float sqrtDiscriminant = std::sqrt(discriminant);
+	float tLeft		= -dotProduct - sqrtDiscriminant;
+	float tRight	= -dotProduct + sqrtDiscriminant;
+
+	for (int i = 0; i < lineNo; ++i) {
+		float denominator	= Det(line.direction, lines[i].direction);
+		float numerator		= Det(lines[i].direction, line.point - lines[i].point);
+		if (std::abs(denominator) <= CrowdEpsilon) {
+			// Parallel lines - either this one is entirely on the wrong side, or the other changes nothing
+			if (numerator < 0.0f) {
+				return false;
+			}
+			continue;
+		}
+		float t = numerator / denominator;
+		if (denominator >= 0.0f) {
+			tRight = std::min(tRight, t);
+		}
+		else {
+			tLeft = std::max(tLeft, t);
+		}
+		if (tLeft > tRight) {
+			return false;
+		}
+	}
+
+	if (directionOpt) {
+		result = line.point + line.direction * (Vector2::Dot(optVelocity, line.direction) > 0.0f ? tRight : tLeft);
+	}
+	else {
+		float t = Vector2::Dot(line.direction, optVelocity - line.point);
+		result = line.point + line.direction * std::clamp(t, tLeft, tRight);
+	}
+	return true;
+}
+
+// Returns the line it couldn't satisfy, or lineCount if it found a velocity that keeps to all of them
+int CrowdSystem::LinearProgram2(const Line* lines, int lineCount, float radius, const Vector2& optVelocity, bool directionOpt, Vector2& result) {
+	if (directionOpt) {
+		result = optVelocity * radius;
+	}
+	else if (optVelocity.LengthSquared() > radius * radius) {
+		result = optVelocity.Normalised() * radius;
+	}
+	else {
+		result = optVelocity;
+	}
+
+	for (int i = 0; i < lineCount; ++i) {
+		if (Det(lines[i].direction, lines[i].point - result) > 0.0f) {
+			Vector2 tempResult = result;
+			if (!LinearProgram1(lines, i, radius, optVelocity, directionOpt, result)) {
+				result = tempResult;
+				return i;
+			}
+		}
+	}
+	return lineCount;
+}
+
+/*
+There's no velocity that avoids everyone, so go for the one that breaks
+the worst of the lines by as little as possible.
+*/
+void CrowdSystem::LinearProgram3(const Line* lines, int lineCount, int beginLine, float radius, Vector2& result) {
+	float distance = 0.0f;
+	Line projectedLines[MaxNeighbours];
+
+	for (int i = beginLine; i < lineCount; ++i) {
+		if (Det(lines[i].direction, lines[i].point - result) <= distance) {
+			continue;
+		}
+		int projectedCount = 0;
+		for (int j = 0; j < i; ++j) {
+			Line line;
+			float determinant = Det(lines[i].direction, lines[j].direction);
+			if (std::abs(determinant) <= CrowdEpsilon) {
+				if (Vector2::Dot(lines[i].direction, lines[j].direction) > 0.0f) {
+					continue; // Same direction, so this one doesn't add anything
+				}
+				line.point = (lines[i].point + lines[j].point) * 0.5f;
+			}
+			else {
+				line.point = lines[i].point + lines[i].direction * (Det(lines[j].direction, lines[i].point - lines[j].point) / determinant);
+			}
+			line.direction = (lines[j].direction - lines[i].direction).Normalised();
+			projectedLines[projectedCount++] = line;
+		}
+		Vector2 tempResult = result;
+		if (LinearProgram2(projectedLines, projectedCount, radius, Vector2(-lines[i].direction.y, lines[i].direction.x), true, result) < projectedCount) {
+			result = tempResult; // Should only happen through floating point error
+		}
+		distance = Det(lines[i].direction, lines[i].point - result);
+	}
+}
+
+void CrowdSystem::Update(float dt, JobSystem* jobs) {
+	lastDt = dt;
+	for (int i = 0; i < (int)objects.size(); ++i) {
+		Vector3 position = objects[i]->GetTransform().GetPosition();
+		PhysicsObject* physics = objects[i]->GetPhysicsObject();
+		Vector3 velocity = physics ? physics->GetLinearVelocity() : Vector3();
+		posX[i]				= position.x;
+		posZ[i]				= position.z;
+		velX[i]				= velocity.x;
+		velZ[i]				= velocity.z;
+		inverseMasses[i]	= physics ? physics->GetInverseMass() : 0.0f;
+	}
+	BuildHash();
+
+	// Going through them in bucket order keeps neighbours' data close together
+	auto compute = [&](int& agent) {
+		ComputeVelocity(agent, dt);
+	};
+	if (jobs) {
+		jobs->ParallelFor(std::span<int>(sortedAgents), compute, 64);
+	}
+	else {
+		for (int& agent : sortedAgents) {
+			compute(agent);
+		}
+	}
+
+	avoidingCount = 0;
+	for (int i = 0; i < (int)objects.size(); ++i) {
+		if (newVelX[i] != velX[i] || newVelZ[i] != velZ[i]) {
+			avoidingCount++;
+		}
+	}
+}
+
+/*
+Called every frame, whether or not the agents' AI ticked, so agents that
+only think now and then still avoid at full strength.
+*/
+void CrowdSystem::ApplyAvoidance() {
+	for (int i = 0; i < (int)objects.size(); ++i) {
+		if (inverseMasses[i] == 0.0f || (newVelX[i] == velX[i] && newVelZ[i] == velZ[i])) {
+			continue;
+		}
+		Vector3 change(newVelX[i] - velX[i], 0.0f, newVelZ[i] - velZ[i]);
+		objects[i]->GetPhysicsObject()->AddForce(change / (inverseMasses[i] * std::max(responseTime, lastDt)));
+	}
+}
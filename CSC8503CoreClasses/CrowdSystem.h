@@ -0,0 +1,113 @@
+#pragma once
+#include "Vector2.h"
+#include "Vector3.h"
+#include <unordered_map>
+#include <vector>
+
+namespace NCL {
+	class JobSystem;
+	using namespace NCL::Maths;
+
+	namespace CSC8503 {
+		class GameObject;
+
+		/*
+		Keeps crowds of agents from walking into each other, rather than
+		leaving it to the physics to push them apart once they've collided.
+		Once per update, each agent's velocity is checked against those of
+		its nearest neighbours, and nudged just enough that none of them
+		will collide within the next couple of seconds, assuming everyone
+		else does their share of the avoiding (ORCA - optimal reciprocal
+		collision avoidance).
+
+		Agents carry on steering themselves however they like, and the
+		world adds the avoidance force on top every frame, which is nothing
+		at all unless there's someone in the way. Everything is flattened
+		onto the ground plane, and hedges aren't included - agents already
+		steer around those.
+		*/
+		class CrowdSystem {
+		public:
+			CrowdSystem(float neighbourDistance = 10.0f, float timeHorizon = 2.0f);
+			~CrowdSystem();
+
+			void AddAgent(GameObject* object, float radius, float maxSpeed);
+			void RemoveAgent(GameObject* object);
+			void Clear();
+
+			// Works out everyone's new velocities, splitting the work across the jobs if there are any
+			void Update(float dt, JobSystem* jobs = nullptr);
+
+			/*
+			Adds the force to every agent that gets it from the velocity it
+			had to the one it needs to avoid everyone, over the response time.
+			*/
+			void ApplyAvoidance();
+
+			/*
+			How quickly agents are expected to make the change of velocity.
+			By default it's all done over the next update, as the avoidance
+			only holds if everyone actually takes up their new velocities.
+			*/
+			void SetResponseTime(float seconds) {
+				responseTime = seconds;
+			}
+
+			int GetAgentCount() const {
+				return (int)objects.size();
+			}
+
+			// How many agents had to change course in the last update
+			int GetAvoidingCount() const {
+				return avoidingCount;
+			}
+
+			static const int MaxNeighbours = 10;
+
+		protected:
+			// Velocities on one side of the line are the ones that avoid a neighbour
+			struct Line {
+				Vector2 point;
+				Vector2 direction;
+			};
+
+			void BuildHash();
+			int FindNeighbours(int agent, int* neighbours, float* distances) const;
+			void ComputeVelocity(int agent, float dt);
+
+			static bool LinearProgram1(const Line* lines, int lineNo, float radius, const Vector2& optVelocity, bool directionOpt, Vector2& result);
+			static int LinearProgram2(const Line* lines, int lineCount, float radius, const Vector2& optVelocity, bool directionOpt, Vector2& result);
+			static void LinearProgram3(const Line* lines, int lineCount, int beginLine, float radius, Vector2& result);
+
+			int BucketFor(int cellX, int cellZ) const;
+
+			float neighbourDistance;
+			float timeHorizon;
+			float responseTime;
+			float lastDt;
+			int avoidingCount;
+
+			// One entry per agent in each of these
+			std::vector<GameObject*>	objects;
+			std::vector<float>			posX;
+			std::vector<float>			posZ;
+			std::vector<float>			velX;
+			std::vector<float>			velZ;
+			std::vector<float>			newVelX;
+			std::vector<float>			newVelZ;
+			std::vector<float>			radii;
+			std::vector<float>			maxSpeeds;
+			std::vector<float>			inverseMasses;
+			std::unordered_map<const GameObject*, int> agentIndices;
+
+			/*
+			Agents sorted by which bucket their cell hashes to, with where
+			each bucket starts. Cells are as big as the neighbour distance,
+			so the 3x3 cells around an agent cover everyone it could avoid.
+			*/
+			std::vector<int>			bucketStart;
+			std::vector<int>			sortedAgents;
+			std::vector<int>			agentBuckets;
+		};
+	}
+}
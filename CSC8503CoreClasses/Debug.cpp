@@ -1,8 +1,18 @@
 #include "Debug.h"
+
+#include <algorithm>
+
 using namespace NCL;
 
 std::vector<Debug::DebugStringEntry>	Debug::stringEntries;
 std::vector<Debug::DebugLineEntry>		Debug::lineEntries;
+int										Debug::timedLineCount	= 0;
+bool									Debug::linesMerged		= false;
+
+std::atomic<unsigned int>				Debug::enabledLines		= Debug::AllLines;
+std::mutex								Debug::bufferLock;
+std::vector<Debug::LineBuffer*>			Debug::threadBuffers;
+std::vector<Debug::MergeRun>			Debug::mergeRuns;
 
 SimpleFont* Debug::debugFont = nullptr;
 
@@ -27,7 +37,7 @@ void Debug::Print(const std::string& text, const Vector2& pos, const Vector4& co
 	stringEntries.emplace_back(newEntry);
 }
 
-void Debug::DrawLine(const Vector3& startpoint, const Vector3& endpoint, const Vector4& colour, float time) {
+void Debug::AddLine(const Vector3& startpoint, const Vector3& endpoint, const Vector4& colour, float time) {
 	DebugLineEntry newEntry;
 
 	newEntry.start = startpoint;
@@ -36,7 +46,60 @@ void Debug::DrawLine(const Vector3& startpoint, const Vector3& endpoint, const V
 	newEntry.colourB = colour;
 	newEntry.time = time;
 
-	lineEntries.emplace_back(newEntry);
+	LineBuffer& buffer = GetThreadLines();
+	if (buffer.runs.empty() || buffer.runs.back().key != buffer.key) {
+		buffer.runs.push_back({ buffer.key, buffer.lines.size() });
+	}
+	buffer.lines.emplace_back(newEntry);
+}
+
+/*
+Each thread gets its own buffer the first time it draws anything. They're
+never deleted, so the merge doesn't have to care whether a thread's still
+around - it's one small buffer for each thread that's ever drawn a line.
+*/
+Debug::LineBuffer& Debug::GetThreadLines() {
+	thread_local LineBuffer* buffer = nullptr;
+	if (!buffer) {
+		buffer = new LineBuffer();
+		std::lock_guard<std::mutex> lock(bufferLock);
+		threadBuffers.push_back(buffer);
+	}
+	return *buffer;
+}
+
+/*
+Every run of lines from every thread is put in key order, and a stable sort
+keeps the runs under the same key in the order they were drawn. One agent's
+tick only ever happens on one thread, so its lines end up together, in the
+same place in the list whichever worker ran it.
+*/
+void Debug::MergeLines() {
+	std::lock_guard<std::mutex> lock(bufferLock);
+	mergeRuns.clear();
+	for (const LineBuffer* buffer : threadBuffers) {
+		for (size_t i = 0; i < buffer->runs.size(); ++i) {
+			size_t last = i + 1 < buffer->runs.size() ? buffer->runs[i + 1].first : buffer->lines.size();
+			mergeRuns.push_back({ buffer->runs[i].key, buffer, buffer->runs[i].first, last });
+		}
+	}
+	std::stable_sort(mergeRuns.begin(), mergeRuns.end(), [](const MergeRun& a, const MergeRun& b) {
+		return a.key < b.key;
+	});
+
+	for (const MergeRun& run : mergeRuns) {
+		for (size_t i = run.first; i < run.last; ++i) {
+			if (run.buffer->lines[i].time > 0.0f) {
+				timedLineCount++;
+			}
+		}
+		lineEntries.insert(lineEntries.end(), run.buffer->lines.begin() + run.first, run.buffer->lines.begin() + run.last);
+	}
+	for (LineBuffer* buffer : threadBuffers) {
+		buffer->lines.clear();
+		buffer->runs.clear();
+	}
+	linesMerged = true;
 }
 
 void Debug::DrawAxisLines(const Matrix4& modelMatrix, float scaleBoost, float time) {
@@ -54,23 +117,30 @@ void Debug::DrawAxisLines(const Matrix4& modelMatrix, float scaleBoost, float ti
 	DrawLine(worldPos, worldPos + (fwd * scaleBoost), Debug::BLUE, time);
 }
 
+/*
+Lines drawn for a single frame are all gone by now, so unless some were
+asked to stay around for longer there's nothing to look through at all.
+*/
 void Debug::UpdateRenderables(float dt) {
-	int trim = 0;
-	for (int i = 0; i < lineEntries.size(); ) {
-		DebugLineEntry* e = &lineEntries[i];
-		e->time -= dt;
-		if (e->time < 0) {
-			trim++;
-			lineEntries[i] = lineEntries[lineEntries.size() - trim];
-		}
-		else {
-			++i;
-		}
-		if (i + trim >= lineEntries.size()) {
-			break;
+	if (!linesMerged) {
+		MergeLines(); //nothing looked at them this frame, but the buffers still need emptying
+	}
+	linesMerged = false;
+
+	if (timedLineCount == 0) {
+		lineEntries.clear();
+	}
+	else {
+		size_t kept = 0;
+		for (DebugLineEntry& e : lineEntries) {
+			e.time -= dt;
+			if (e.time >= 0) {
+				lineEntries[kept++] = e;
+			}
 		}
+		lineEntries.resize(kept);
+		timedLineCount = (int)kept;
 	}
-	lineEntries.resize(lineEntries.size() - trim);
 	stringEntries.clear();
 }
 
@@ -86,5 +156,8 @@ const std::vector<Debug::DebugStringEntry>& Debug::GetDebugStrings() {
 }
 
 const std::vector<Debug::DebugLineEntry>& Debug::GetDebugLines() {
+	if (!linesMerged) {
+		MergeLines();
+	}
 	return lineEntries;
 }
\ No newline at end of file
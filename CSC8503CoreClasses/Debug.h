@@ -3,6 +3,18 @@
 #include "Vector4.h"
 #include "Matrix4.h"
 #include "SimpleFont.h"
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+/*
+Which categories of debug line are compiled in at all. Lines in any other
+category compile to nothing, whatever the runtime mask says - set it from
+CMake with DEBUG_LINE_CATEGORIES, 0 for none at all.
+*/
+#ifndef DEBUGLINECATEGORIES
+#define DEBUGLINECATEGORIES 0xFFFFFFFF
+#endif
 
 namespace NCL {
 	using namespace NCL::Maths;
@@ -25,8 +37,57 @@ namespace NCL {
 			Vector4 colourB;
 		};
 
+		enum LineCategory : unsigned int {
+			General		= 1 << 0,
+			AI			= 1 << 1,	// Whiskers, sight lines, steering targets
+			Pathfinding	= 1 << 2,	// Path segments
+			Spatial		= 1 << 3,	// Quad and oct tree nodes
+			AllLines	= 0xFFFFFFFF
+		};
+		static constexpr unsigned int COMPILED_LINES = DEBUGLINECATEGORIES;
+
 		static void Print(const std::string& text, const Vector2& pos, const Vector4& colour = Vector4(1, 1, 1, 1));
-		static void DrawLine(const Vector3& startpoint, const Vector3& endpoint, const Vector4& colour = Vector4(1, 1, 1, 1), float time = 0.0f);
+
+		/*
+		Can be called from any thread, as long as nothing is still drawing
+		when the main thread merges the lines - the AI's jobs have all been
+		waited on by then. Each thread appends to its own buffer without any
+		locking. If the category isn't compiled in this is empty, and if it's
+		just turned off it's a single load and test.
+		*/
+		template <LineCategory category = General>
+		static void DrawLine(const Vector3& startpoint, const Vector3& endpoint, const Vector4& colour = Vector4(1, 1, 1, 1), float time = 0.0f) {
+			if constexpr ((COMPILED_LINES & category) != 0) {
+				if (enabledLines.load(std::memory_order_relaxed) & category) {
+					AddLine(startpoint, endpoint, colour, time);
+				}
+			}
+		}
+
+		// For skipping whatever work goes into drawing a category's lines, as well as the lines themselves
+		static bool LinesEnabled(unsigned int categories) {
+			return (COMPILED_LINES & categories) && (enabledLines.load(std::memory_order_relaxed) & categories);
+		}
+
+		static void SetLinesEnabled(unsigned int categories) {
+			enabledLines.store(categories, std::memory_order_relaxed);
+		}
+
+		static unsigned int GetLinesEnabled() {
+			return enabledLines.load(std::memory_order_relaxed);
+		}
+
+		/*
+		Merged lines are ordered by this key, then by the order each thread
+		drew them in, so they come out the same however the work was spread
+		over the threads. The AIScheduler sets it to each agent's place in
+		the tick order, 0 is for anything drawn outside an agent.
+		*/
+		static void SetLineKey(uint64_t key) {
+			if constexpr (COMPILED_LINES != 0) {
+				GetThreadLines().key = key;
+			}
+		}
 
 		static void DrawAxisLines(const Matrix4& modelMatrix, float scaleBoost = 1.0f, float time = 0.0f);
 
@@ -35,6 +96,11 @@ namespace NCL {
 		static SimpleFont* GetDebugFont();
 
 		static const std::vector<DebugStringEntry>& GetDebugStrings();
+		/*
+		Everything to draw this frame. The first call each frame merges in
+		whatever every thread has drawn since, so it's for the main thread,
+		once the AI is done with its jobs.
+		*/
 		static const std::vector<DebugLineEntry>& GetDebugLines();
 
 
@@ -53,8 +119,39 @@ namespace NCL {
 		Debug() {}
 		~Debug() {}
 
+		// A stretch of a thread's lines all drawn under the same key
+		struct LineRun {
+			uint64_t	key;
+			size_t		first;
+		};
+
+		// Only ever touched by its own thread, until the main thread merges it
+		struct LineBuffer {
+			uint64_t					key = 0;
+			std::vector<DebugLineEntry>	lines;
+			std::vector<LineRun>		runs;
+		};
+
+		struct MergeRun {
+			uint64_t		key;
+			const LineBuffer*	buffer;
+			size_t			first;
+			size_t			last;
+		};
+
+		static void AddLine(const Vector3& startpoint, const Vector3& endpoint, const Vector4& colour, float time);
+		static LineBuffer& GetThreadLines();
+		static void MergeLines();
+
 		static std::vector<DebugStringEntry>	stringEntries;
 		static std::vector<DebugLineEntry>		lineEntries;
+		static int								timedLineCount;	// Lines in lineEntries that last past this frame
+		static bool								linesMerged;
+
+		static std::atomic<unsigned int>		enabledLines;
+		static std::mutex						bufferLock;	// Only for adding a new thread's buffer
+		static std::vector<LineBuffer*>			threadBuffers;
+		static std::vector<MergeRun>			mergeRuns;
 
 		static SimpleFont* debugFont;
 	};
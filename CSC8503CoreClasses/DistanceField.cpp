@@ -0,0 +1,170 @@
+#include "DistanceField.h"
+#include "Maths.h"
+#include "Matrix3.h"
+
+#include <cmath>
+
+using namespace NCL;
+using namespace CSC8503;
+
+DistanceField::DistanceField(NavigationGrid& grid, int samplesPerNode, float maxDistance) : grid(grid) {
+	this->samplesPerNode	= std::max(1, samplesPerNode);
+	this->maxDistance		= maxDistance;
+
+	float nodeSize	= (float)grid.GetNodeSize();
+	sampleSpacing	= nodeSize / this->samplesPerNode;
+	origin			= grid.GetZeroPos() - Vector3(nodeSize * 0.5f, 0.0f, nodeSize * 0.5f);
+	samplesX		= (grid.GetWidth() * this->samplesPerNode) + 1;
+	samplesZ		= (grid.GetHeight() * this->samplesPerNode) + 1;
+	samples.resize((size_t)samplesX * samplesZ);
+
+	UpdateSamples(0, 0, samplesX - 1, samplesZ - 1);
+	updatedSamples = 0;
+	rayCount = 0;
+
+	listenerID = grid.AddChangeListener([this](int x, int z) {
+		OnGridChanged(x, z);
+	});
+}
+
+DistanceField::~DistanceField() {
+	grid.RemoveChangeListener(listenerID);
+}
+
+/*
+Each hedge fills its node, so the distance to it is the distance to a
+square. Only hedges that could be within limit are looked at.
+*/
+float DistanceField::DistanceToWalls(float x, float z, float limit) const {
+	float nodeSize	= (float)grid.GetNodeSize();
+	float halfSize	= nodeSize * 0.5f;
+	Vector3 zeroPos	= grid.GetZeroPos();
+
+	int centreX	= (int)floor((x - zeroPos.x) / nodeSize + 0.5f);
+	int centreZ	= (int)floor((z - zeroPos.z) / nodeSize + 0.5f);
+	int reach	= (int)ceil(limit / nodeSize) + 1;
+
+	float best = limit;
+	for (int nz = centreZ - reach; nz <= centreZ + reach; ++nz) {
+		for (int nx = centreX - reach; nx <= centreX + reach; ++nx) {
+			if (nx < 0 || nx >= grid.GetWidth() || nz < 0 || nz >= grid.GetHeight() || grid.IsOpen(nx, nz)) {
+				continue;
+			}
+			float dx = std::abs(x - (zeroPos.x + nx * nodeSize)) - halfSize;
+			float dz = std::abs(z - (zeroPos.z + nz * nodeSize)) - halfSize;
+			float outside	= sqrt((std::max(dx, 0.0f) * std::max(dx, 0.0f)) + (std::max(dz, 0.0f) * std::max(dz, 0.0f)));
+			float inside	= std::min(std::max(dx, dz), 0.0f);
+			best = std::min(best, outside + inside);
+		}
+	}
+	return best;
+}
+
+void DistanceField::UpdateSamples(int minX, int minZ, int maxX, int maxZ) {
+	minX = std::max(minX, 0);
+	minZ = std::max(minZ, 0);
+	maxX = std::min(maxX, samplesX - 1);
+	maxZ = std::min(maxZ, samplesZ - 1);
+	for (int z = minZ; z <= maxZ; ++z) {
+		for (int x = minX; x <= maxX; ++x) {
+			samples[(z * samplesX) + x] = DistanceToWalls(origin.x + x * sampleSpacing, origin.z + z * sampleSpacing, maxDistance);
+		}
+	}
+	updatedSamples += (maxX - minX + 1) * (maxZ - minZ + 1);
+}
+
+// x and z are in samples, and must be within the field
+float DistanceField::Sample(float x, float z) const {
+	int x0 = std::min((int)x, samplesX - 2);
+	int z0 = std::min((int)z, samplesZ - 2);
+	float fx = x - x0;
+	float fz = z - z0;
+	const float* row0 = &samples[(z0 * samplesX) + x0];
+	const float* row1 = row0 + samplesX;
+
+	float top		= row0[0] + (row0[1] - row0[0]) * fx;
+	float bottom	= row1[0] + (row1[1] - row1[0]) * fx;
+	return top + (bottom - top) * fz;
+}
+
+bool DistanceField::Contains(const Vector3& position) const {
+	float x = (position.x - origin.x) / sampleSpacing;
+	float z = (position.z - origin.z) / sampleSpacing;
+	return x >= 0.0f && x <= samplesX - 1 && z >= 0.0f && z <= samplesZ - 1;
+}
+
+float DistanceField::GetClearance(const Vector3& position) const {
+	if (!Contains(position)) {
+		return maxDistance;
+	}
+	return Sample((position.x - origin.x) / sampleSpacing, (position.z - origin.z) / sampleSpacing);
+}
+
+/*
+Blending between samples can make a point look a little further from a
+hedge than it is, most of all around hedge corners - but never by more
+than the distance to the furthest sample. So the blended distance less
+that is always safe to step, and close to a hedge, where steps are
+small anyway, the distance is worked out exactly instead.
+*/
+float DistanceField::RayDistance(const Vector3& from, const Vector3& direction, float range) const {
+	rayCount.fetch_add(1, std::memory_order_relaxed);
+	const float hitDistance	= 0.01f;
+	const int	maxSteps	= 256;
+	float blendError = sampleSpacing * 0.7072f;
+
+	Vector3 flatDirection(direction.x, 0.0f, direction.z);
+	if (flatDirection.LengthSquared() < 0.000001f) {
+		return range;
+	}
+	flatDirection = flatDirection.Normalised();
+
+	float travelled = 0.0f;
+	for (int i = 0; i < maxSteps && travelled < range; ++i) {
+		Vector3 point = from + (flatDirection * travelled);
+		if (!Contains(point)) {
+			return range; //out of the maze with nothing in the way
+		}
+		float clearance = GetClearance(point) - blendError;
+		if (clearance < sampleSpacing) {
+			clearance = DistanceToWalls(point.x, point.z, sampleSpacing * 2.0f);
+		}
+		if (clearance < hitDistance) {
+			return travelled;
+		}
+		travelled += clearance;
+	}
+	return std::min(travelled, range);
+}
+
+bool DistanceField::FindOpenHeading(const Vector3& position, float heading, float range, float fromDegrees, float stepDegrees, float& outHeading) const {
+	for (float offset = fromDegrees; offset < 180.0f; offset += stepDegrees) {
+		for (int side = -1; side <= 1; side += 2) {
+			float candidate = heading + (offset * side);
+			Vector3 direction = Matrix3::FromEuler(Vector3(0, candidate, 0)) * Vector3(0, 0, -1);
+			if (RayDistance(position, direction, range) >= range) {
+				outHeading = candidate;
+				return true;
+			}
+			if (offset == 0.0f) {
+				break; //no need to try straight ahead twice
+			}
+		}
+	}
+	return false;
+}
+
+/*
+A removed hedge can only have been the nearest for samples within
+maxDistance of it.
+*/
+void DistanceField::OnGridChanged(int x, int z) {
+	float nodeSize		= (float)grid.GetNodeSize();
+	Vector3 nodeMin		= grid.GetZeroPos() + Vector3((x - 0.5f) * nodeSize, 0, (z - 0.5f) * nodeSize);
+	Vector3 nodeMax		= nodeMin + Vector3(nodeSize, 0, nodeSize);
+
+	UpdateSamples((int)floor((nodeMin.x - maxDistance - origin.x) / sampleSpacing),
+		(int)floor((nodeMin.z - maxDistance - origin.z) / sampleSpacing),
+		(int)ceil((nodeMax.x + maxDistance - origin.x) / sampleSpacing),
+		(int)ceil((nodeMax.z + maxDistance - origin.z) / sampleSpacing));
+}
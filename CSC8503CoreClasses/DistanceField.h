@@ -0,0 +1,84 @@
+#pragma once
+#include "NavigationGrid.h"
+#include <atomic>
+
+namespace NCL {
+	namespace CSC8503 {
+		/*
+		The distance from points across the maze to the nearest hedge,
+		sampled a few times per node. Between samples it's blended, so
+		asking how much room there is somewhere is a handful of lookups,
+		and the slope of the field points straight away from the nearest
+		hedge.
+
+		Casting a ray through it steps along by the room there is at each
+		point - nothing can be closer than that, so nothing is missed -
+		which finds the nearest hedge along a heading in a few steps
+		rather than testing against every hedge in the world.
+
+		Distances are only kept up to maxDistance. So when a hedge is
+		removed, only the samples within that distance of it are worked
+		out again.
+		*/
+		class DistanceField {
+		public:
+			DistanceField(NavigationGrid& grid, int samplesPerNode = 4, float maxDistance = 20.0f);
+			~DistanceField();
+
+			// False if the position is off the maze
+			bool Contains(const Vector3& position) const;
+
+			// Distance to the nearest hedge, negative inside one, and no more than maxDistance
+			float GetClearance(const Vector3& position) const;
+
+			// How far along the direction before reaching a hedge, up to range
+			float RayDistance(const Vector3& from, const Vector3& direction, float range) const;
+
+			/*
+			Sweeps out either side of the current heading (in degrees, about
+			the y axis, as with the agents' orientations), a step at a time
+			from fromDegrees away, and gives the first heading with at least
+			range free along it. Lower headings are tried first.
+			*/
+			bool FindOpenHeading(const Vector3& position, float heading, float range, float fromDegrees, float stepDegrees, float& outHeading) const;
+
+			float GetMaxDistance() const {
+				return maxDistance;
+			}
+
+			// How many samples have been worked out again since the field was built
+			int GetUpdatedSampleCount() const {
+				return updatedSamples;
+			}
+
+			// How many rays have been cast through the field
+			unsigned int GetRayCount() const {
+				return rayCount.load(std::memory_order_relaxed);
+			}
+
+		protected:
+			// Exact distance from the world x/z position to the nearest hedge, up to limit
+			float DistanceToWalls(float x, float z, float limit) const;
+			void UpdateSamples(int minX, int minZ, int maxX, int maxZ);
+			float Sample(float x, float z) const;
+
+			void OnGridChanged(int x, int z);
+
+			NavigationGrid& grid;
+			int listenerID;
+
+			int		samplesPerNode;
+			float	sampleSpacing;
+			float	maxDistance;
+			Vector3	origin;		// World position of the first sample, the outer corner of the first node
+			int		samplesX;
+			int		samplesZ;
+			std::vector<float> samples;
+
+			int updatedSamples;
+
+			// Agents cast rays from the AI's worker threads
+			mutable std::atomic<unsigned int> rayCount;
+		};
+	}
+}
@@ -0,0 +1,228 @@
+#include "FlowField.h"
+
+#include <cfloat>
+
+using namespace NCL;
+using namespace CSC8503;
+
+const float SQRT2 = 1.41421356f;
+
+// How strongly the flee field prefers distance over finding a way out, Brogue uses the same value
+const float FLEE_SCALE = -1.2f;
+
+FlowField::FlowField(NavigationGrid& grid, bool buildFleeField) : grid(grid) {
+	targetNode		= -1;
+	fleeEnabled		= buildFleeField;
+	rebuildCount	= 0;
+	repairCount		= 0;
+
+	distances.assign((size_t)grid.GetWidth() * grid.GetHeight(), FLT_MAX);
+	if (fleeEnabled) {
+		fleeValues = distances;
+	}
+	listenerID = grid.AddChangeListener([this](int x, int z) {
+		OnGridChanged(x, z);
+	});
+}
+
+FlowField::~FlowField() {
+	grid.RemoveChangeListener(listenerID);
+}
+
+void FlowField::SetTarget(const Vector3& position) {
+	int x, z;
+	int node = grid.WorldToGrid(position, x, z) ? (z * grid.GetWidth()) + x : -1;
+	if (node == targetNode) {
+		return;
+	}
+	targetNode = node;
+	Rebuild();
+}
+
+void FlowField::Rebuild() {
+	rebuildCount++;
+	std::fill(distances.begin(), distances.end(), FLT_MAX);
+
+	int width = grid.GetWidth();
+	if (targetNode != -1 && grid.IsOpen(targetNode % width, targetNode / width)) {
+		search.Begin(distances.size());
+		distances[targetNode] = 0.0f;
+		search.Open(targetNode, 0.0f, 0.0f, -1);
+		Propagate(distances);
+	}
+	if (fleeEnabled) {
+		BuildFleeField();
+	}
+}
+
+/*
+Opening a node can only make routes shorter, both through the node
+itself, and for diagonal moves that it was blocking the corner of. So
+each node around it takes the best it can get from its neighbours, and
+any that improve spread the improvement outwards.
+*/
+void FlowField::Repair(int node) {
+	repairCount++;
+	int width	= grid.GetWidth();
+	int height	= grid.GetHeight();
+	int x = node % width;
+	int z = node / width;
+
+	search.Begin(distances.size());
+	for (int dz = -1; dz <= 1; ++dz) {
+		for (int dx = -1; dx <= 1; ++dx) {
+			int nx = x + dx;
+			int nz = z + dz;
+			if (nx < 0 || nx >= width || nz < 0 || nz >= height || !grid.IsOpen(nx, nz)) {
+				continue;
+			}
+			int n = (nz * width) + nx;
+			float best = distances[n];
+			ForEachNeighbour(n, [&](int neighbour, float cost) {
+				if (distances[neighbour] != FLT_MAX) {
+					best = std::min(best, distances[neighbour] + cost);
+				}
+			});
+			if (best < distances[n]) {
+				distances[n] = best;
+				search.Open(n, best, best, -1);
+			}
+		}
+	}
+	if (!search.HasOpen()) {
+		return; //nothing got any closer
+	}
+	Propagate(distances);
+	if (fleeEnabled) {
+		BuildFleeField();
+	}
+}
+
+void FlowField::BuildFleeField() {
+	fleeValues.assign(distances.size(), FLT_MAX);
+	search.Begin(distances.size());
+	for (size_t i = 0; i < distances.size(); ++i) {
+		if (distances[i] != FLT_MAX) {
+			float value = distances[i] * FLEE_SCALE;
+			fleeValues[i] = value;
+			search.Open((int)i, value, value, -1);
+		}
+	}
+	Propagate(fleeValues);
+}
+
+void FlowField::Propagate(std::vector<float>& field) {
+	while (search.HasOpen()) {
+		int current = search.PopBest();
+		search.Close(current);
+		float g = search.GetG(current);
+
+		ForEachNeighbour(current, [&](int neighbour, float cost) {
+			if (search.IsClosed(neighbour)) {
+				return;
+			}
+			float candidate = g + cost;
+			if (candidate < field[neighbour]) {
+				field[neighbour] = candidate;
+				search.Open(neighbour, candidate, candidate, current);
+			}
+		});
+	}
+}
+
+float FlowField::GetDistance(const Vector3& position) const {
+	int x, z;
+	if (!grid.WorldToGrid(position, x, z)) {
+		return FLT_MAX;
+	}
+	return distances[(z * grid.GetWidth()) + x];
+}
+
+bool FlowField::GetChaseDirection(const Vector3& position, Vector3& outDirection) const {
+	return GetDirection(distances, position, outDirection);
+}
+
+bool FlowField::GetFleeDirection(const Vector3& position, Vector3& outDirection) const {
+	return fleeEnabled && GetDirection(fleeValues, position, outDirection);
+}
+
+bool FlowField::GetNextChasePosition(const Vector3& position, Vector3& outPosition) const {
+	int next = GetNextNode(distances, position);
+	if (next == -1) {
+		return false;
+	}
+	outPosition = grid.GetNodePosition(next);
+	return true;
+}
+
+int FlowField::GetNextNode(const std::vector<float>& field, const Vector3& position) const {
+	int x, z;
+	if (!grid.WorldToGrid(position, x, z)) {
+		return -1;
+	}
+	int node = (z * grid.GetWidth()) + x;
+	/*
+	Taking the lowest neighbour isn't quite right, as a diagonal step costs
+	more - the best step is the one the value was worked out through.
+	*/
+	int best = -1;
+	float bestValue = FLT_MAX;
+	ForEachNeighbour(node, [&](int neighbour, float cost) {
+		if (field[neighbour] < field[node] && field[neighbour] + cost < bestValue) {
+			bestValue	= field[neighbour] + cost;
+			best		= neighbour;
+		}
+	});
+	return best; //-1 if it's already as good as it gets
+}
+
+bool FlowField::GetDirection(const std::vector<float>& field, const Vector3& position, Vector3& outDirection) const {
+	int next = GetNextNode(field, position);
+	if (next == -1) {
+		return false;
+	}
+	Vector3 direction = grid.GetNodePosition(next) - position;
+	direction.y = 0.0f;
+	if (direction.LengthSquared() < 0.0001f) {
+		return false;
+	}
+	outDirection = direction.Normalised();
+	return true;
+}
+
+template <typename F>
+void FlowField::ForEachNeighbour(int node, F&& func) const {
+	int width = grid.GetWidth();
+	int x = node % width;
+	int z = node / width;
+	bool diagonals = grid.AllowsDiagonals();
+
+	for (int dz = -1; dz <= 1; ++dz) {
+		for (int dx = -1; dx <= 1; ++dx) {
+			if (dx == 0 && dz == 0) {
+				continue;
+			}
+			bool diagonal = dx != 0 && dz != 0;
+			if (diagonal && !diagonals) {
+				continue;
+			}
+			if (!grid.IsOpen(x + dx, z + dz)) {
+				continue;
+			}
+			if (diagonal && (!grid.IsOpen(x + dx, z) || !grid.IsOpen(x, z + dz))) {
+				continue; //no cutting across wall corners
+			}
+			func(((z + dz) * width) + x + dx, diagonal ? SQRT2 : 1.0f);
+		}
+	}
+}
+
+void FlowField::OnGridChanged(int x, int z) {
+	int node = (z * grid.GetWidth()) + x;
+	if (node == targetNode || !grid.IsOpen(x, z)) {
+		Rebuild(); //target's node has opened up, or something closed off
+	}
+	else {
+		Repair(node);
+	}
+}
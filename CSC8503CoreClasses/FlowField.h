@@ -0,0 +1,81 @@
+#pragma once
+#include "NavigationGrid.h"
+
+namespace NCL {
+	namespace CSC8503 {
+		/*
+		Holds the distance from every open node to one target, so any
+		number of agents can head towards (or away from) it by looking at
+		the nodes around them, rather than each running its own search.
+
+		The distances are only worked out again when the target moves to
+		a different node. When a wall is opened up, distances can only get
+		shorter, so they're repaired outwards from the opened node rather
+		than rebuilt.
+
+		Fleeing by simply climbing the distances leads agents into dead
+		ends, so the flee field takes the distances scaled by a negative
+		amount and runs them through Dijkstra again. Agents then head for
+		somewhere far away that has more than one way out.
+		*/
+		class FlowField {
+		public:
+			FlowField(NavigationGrid& grid, bool buildFleeField = false);
+			~FlowField();
+
+			// Only rebuilds if the target has moved to a different node
+			void SetTarget(const Vector3& position);
+
+			bool HasTarget() const {
+				return targetNode != -1;
+			}
+
+			// In nodes, FLT_MAX if the target can't be reached from here
+			float GetDistance(const Vector3& position) const;
+
+			// Unit direction to the next node, false if there's nowhere better to go
+			bool GetChaseDirection(const Vector3& position, Vector3& outDirection) const;
+			bool GetFleeDirection(const Vector3& position, Vector3& outDirection) const;
+
+			// Middle of the next node on the way to the target, false if there's nowhere better to go
+			bool GetNextChasePosition(const Vector3& position, Vector3& outPosition) const;
+
+			int GetRebuildCount() const {
+				return rebuildCount;
+			}
+
+			int GetRepairCount() const {
+				return repairCount;
+			}
+
+		protected:
+			void Rebuild();
+			void Repair(int node);
+			void BuildFleeField();
+
+			// Dijkstra outwards from whatever the search has been given, only keeping values that beat the field
+			void Propagate(std::vector<float>& field);
+
+			// The neighbour of the position's node with the best value, -1 if none beats the node itself
+			int GetNextNode(const std::vector<float>& field, const Vector3& position) const;
+			bool GetDirection(const std::vector<float>& field, const Vector3& position, Vector3& outDirection) const;
+
+			template <typename F>
+			void ForEachNeighbour(int node, F&& func) const;
+
+			void OnGridChanged(int x, int z);
+
+			NavigationGrid& grid;
+			int listenerID;
+
+			int		targetNode;
+			bool	fleeEnabled;
+			int		rebuildCount;
+			int		repairCount;
+
+			std::vector<float>	distances;
+			std::vector<float>	fleeValues;
+			GridSearch			search;
+		};
+	}
+}
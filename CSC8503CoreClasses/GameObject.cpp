@@ -10,7 +10,9 @@ using namespace NCL::CSC8503;
 GameObject::GameObject(string objectName)	{
 	name			= objectName;
 	worldID			= -1;
+	worldIndex		= -1;
 	isActive		= true;
+	pendingRemoval	= false;
 	boundingVolume	= nullptr;
 	physicsObject	= nullptr;
 	renderObject	= nullptr;
@@ -66,6 +68,18 @@ void GameObject::RemoveOwningNode(OctTreeNode<GameObject>* node) {
 		throw new std::invalid_argument("Attempted to remove node that isn't listened to");
 }
 
+void GameObject::AddContact(GameObject* other) {
+	contacts.push_back(other);
+}
+
+void GameObject::RemoveContact(GameObject* other) {
+	auto i = std::find(contacts.begin(), contacts.end(), other);
+	if (i == contacts.end())
+		return;
+	*i = contacts.back(); // Order doesn't matter, so swap and pop
+	contacts.pop_back();
+}
+
 void GameObject::NotifyOwningNodes() {
 	if (owningNodes.size() == 0) // Safety check: If object has fallen outside of tree then won't crash
 		return;
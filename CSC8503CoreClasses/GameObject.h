@@ -16,7 +16,7 @@ namespace NCL::CSC8503 {
 	class GameObject	{
 	public:
 		GameObject(std::string name = "");
-		~GameObject();
+		virtual ~GameObject(); //the world deletes everything through a GameObject*, so subclasses need to get to clean up too
 
 		void SetBoundingVolume(CollisionVolume* vol) {
 			boundingVolume = vol;
@@ -30,6 +30,14 @@ namespace NCL::CSC8503 {
 			return isActive;
 		}
 
+		bool IsPendingRemoval() const {
+			return pendingRemoval;
+		}
+
+		void SetPendingRemoval(bool state) {
+			pendingRemoval = state;
+		}
+
 		Transform& GetTransform() {
 			return transform;
 		}
@@ -82,6 +90,15 @@ namespace NCL::CSC8503 {
 			return worldID;
 		}
 
+		// Slot this object occupies in its GameWorld's object list, -1 if not in a world
+		void SetWorldIndex(int newIndex) {
+			worldIndex = newIndex;
+		}
+
+		int		GetWorldIndex() const {
+			return worldIndex;
+		}
+
 		void setCRest(float val) {
 			cRestitution = val;
 		}
@@ -110,6 +127,19 @@ namespace NCL::CSC8503 {
 			return (int)owningNodes.size();
 		}
 
+		// Objects this one has an entry in the physics collision list with
+		void AddContact(GameObject* other);
+
+		void RemoveContact(GameObject* other);
+
+		void ClearContacts() {
+			contacts.clear();
+		}
+
+		const std::vector<GameObject*>& GetContacts() const {
+			return contacts;
+		}
+
 		int initOwnCount;
 
 	protected:
@@ -121,12 +151,15 @@ namespace NCL::CSC8503 {
 		NetworkObject*		networkObject;
 
 		std::list<OctTreeNode<GameObject>*> owningNodes;
+		std::vector<GameObject*> contacts;
 
 		float cRestitution;
 		float cFriction;
 
 		bool		isActive;
+		bool		pendingRemoval;
 		int			worldID;
+		int			worldIndex;
 		std::string	name;
 
 		Vector3 broadphaseAABB;
@@ -10,6 +10,15 @@
 using namespace NCL;
 using namespace NCL::CSC8503;
 
+// A goat is felt about 5 nodes away (down to 0.33), and for a few seconds after it's gone. Nothing past 8 nodes needs to know
+const float GOAT_THREAT_FALLOFF			= 0.8f;
+const float GOAT_THREAT_DECAY			= 0.5f;
+const float GOAT_THREAT_CUTOFF			= 0.15f;
+// Crowds only matter close by, and move on quickly
+const float CIVILIAN_DENSITY_FALLOFF	= 0.5f;
+const float CIVILIAN_DENSITY_DECAY		= 4.0f;
+const float CIVILIAN_DENSITY_CUTOFF		= 0.2f;
+
 GameWorld::GameWorld()	{
 	mainCamera = new Camera();
 
@@ -17,18 +26,38 @@ GameWorld::GameWorld()	{
 	shuffleObjects		= false;
 	worldIDCounter		= 0;
 	worldStateCounter	= 0;
+	currentSnapshot		= 0;
+
+	physicsSystem	= nullptr;
+	maze			= nullptr;
+	pathRequests	= nullptr;
+	mazeVisibility	= nullptr;
+	mazeDistances	= nullptr;
+	goatThreat		= nullptr;
+	civilianDensity	= nullptr;
+	jobSystem		= nullptr;
+	raycastCount	= 0;
 }
 
 GameWorld::~GameWorld()	{
+	ClearMazeServices();
 }
 
 void GameWorld::Clear() {
 	gameObjects.clear();
 	playerGoats.clear();
+	goatsInMaze.clear();
+	perception.Clear();
+	crowd.Clear();
 	constraints.clear();
+	pendingRemovals.clear();
+	ClearMazeServices();
 	maze = nullptr;
+	currentSnapshot = 0;
 	worldIDCounter		= 0;
 	worldStateCounter	= 0;
+	// jobSystem stays put - it belongs to the game, not the level, and
+	// dropping it here would quietly turn parallel physics off on every reset
 }
 
 void GameWorld::ClearAndErase() {
@@ -39,20 +68,59 @@ void GameWorld::ClearAndErase() {
 	for (auto& i : constraints) {
 		delete i;
 	}
+	ClearMazeServices();
 	delete maze;
 	Clear();
 }
 
 void GameWorld::AddGameObject(GameObject* o) {
+	o->SetWorldIndex((int)gameObjects.size());
 	gameObjects.emplace_back(o);
 	o->SetWorldID(worldIDCounter++);
 	worldStateCounter++;
 	physicsSystem->AddObject(o);
 }
 
+/*
+Objects know where they sit in the gameObjects vector, so removal is just
+a swap with the last object and a pop, rather than a search and shuffle
+of everything after it. This does mean object order isn't preserved!
+*/
 void GameWorld::RemoveGameObject(GameObject* o, bool andDelete) {
-	gameObjects.erase(std::remove(gameObjects.begin(), gameObjects.end(), o), gameObjects.end());
+	int index = o->GetWorldIndex();
+	if (index < 0 || index >= (int)gameObjects.size() || gameObjects[index] != o) {
+		return; // Not in this world
+	}
+	if (o->IsPendingRemoval()) {
+		// Removed straight away while still queued, so the queue mustn't get to it later
+		pendingRemovals.erase(std::remove_if(pendingRemovals.begin(), pendingRemovals.end(),
+			[o](const PendingRemoval& r) { return r.object == o; }), pendingRemovals.end());
+		o->SetPendingRemoval(false);
+	}
+	GameObject* last = gameObjects.back();
+	gameObjects[index] = last;
+	last->SetWorldIndex(index);
+	gameObjects.pop_back();
+	o->SetWorldIndex(-1);
+
 	physicsSystem->RemoveObject(o);
+	perception.RemoveSource(o);
+	crowd.RemoveAgent(o);
+	if (goatThreat) {
+		goatThreat->RemoveSource(o);
+		civilianDensity->RemoveSource(o);
+	}
+
+	auto replanner = mazeReplanners.find(o);
+	if (replanner != mazeReplanners.end()) {
+		delete replanner->second;
+		mazeReplanners.erase(replanner);
+	}
+	auto flowField = goatFlowFields.find(o);
+	if (flowField != goatFlowFields.end()) {
+		delete flowField->second;
+		goatFlowFields.erase(flowField);
+	}
 	if (andDelete) {
 		delete o;
 	}
@@ -62,29 +130,85 @@ void GameWorld::RemoveGameObject(GameObject* o, bool andDelete) {
 void GameWorld::AddGoat(GameObject* o) {
 	playerGoats.emplace_back(o);
 	AddGameObject(o);
+	perception.AddSource(o, StimulusType::Goat);
+	if (goatThreat) {
+		goatThreat->AddSource(o);
+	}
 }
 
 void GameWorld::RemoveGoat(GameObject* o, bool andDelete) {
-	playerGoats.erase(std::remove(playerGoats.begin(), playerGoats.end(), o), playerGoats.end());
+	// There's only ever a handful of goats, so no need for an index here
+	auto i = std::find(playerGoats.begin(), playerGoats.end(), o);
+	if (i != playerGoats.end()) {
+		*i = playerGoats.back();
+		playerGoats.pop_back();
+	}
+	goatsInMaze.erase(std::remove(goatsInMaze.begin(), goatsInMaze.end(), o), goatsInMaze.end());
 	RemoveGameObject(o, andDelete);
 }
 
+void GameWorld::QueueRemoveGameObject(GameObject* o, bool andDelete) {
+	if (o->IsPendingRemoval()) {
+		return; // Already going, don't want to delete it twice
+	}
+	o->SetPendingRemoval(true);
+	pendingRemovals.push_back({ o, andDelete });
+}
+
+/*
+Called at the start of UpdateWorld, once the AI is done with this frame's
+objects but before physics or rendering get to them.
+*/
+void GameWorld::ProcessRemovals() {
+	for (const PendingRemoval& r : pendingRemovals) {
+		r.object->SetPendingRemoval(false);
+		if (std::find(playerGoats.begin(), playerGoats.end(), r.object) != playerGoats.end()) {
+			RemoveGoat(r.object, r.andDelete);
+		}
+		else {
+			RemoveGameObject(r.object, r.andDelete);
+		}
+	}
+	pendingRemovals.clear();
+}
+
 void GameWorld::AddMaze(NavigationGrid* maze) {
+	ClearMazeServices(); // They're all working off the old maze
 	this->maze = maze;
+	if (maze) {
+		pathRequests	= new PathRequestService(*maze, jobSystem);
+		mazeVisibility	= new GridVisibility(*maze);
+		mazeDistances	= new DistanceField(*maze);
+		goatThreat		= new InfluenceMap(*maze, GOAT_THREAT_FALLOFF, GOAT_THREAT_DECAY, GOAT_THREAT_CUTOFF);
+		civilianDensity	= new InfluenceMap(*maze, CIVILIAN_DENSITY_FALLOFF, CIVILIAN_DENSITY_DECAY, CIVILIAN_DENSITY_CUTOFF);
+		for (GameObject* goat : playerGoats) {
+			goatThreat->AddSource(goat);
+		}
+	}
 }
 
 void GameWorld::RemoveMazeNode(GameObject* node) {
+	if (pathRequests) {
+		pathRequests->WaitForSearches(); //can't change the maze under a search
+	}
 	maze->RemoveNode(node->GetTransform().GetPosition());
-	RemoveGameObject(node, true);
+	QueueRemoveGameObject(node, true);
 }
 
-vector<GameObject*> GameWorld::GetGoatsInMaze() {
-	vector<GameObject*> goatsInMaze;
+/*
+Done once per update, rather than by every agent that wants to know
+where the goats are.
+*/
+void GameWorld::UpdatePerception() {
+	perception.Update();
+
+	goatsInMaze.clear();
 	for (GameObject* goat : playerGoats) {
-		// TODO: Somehow just get the goats in the maze
-		goatsInMaze.emplace_back(goat);
+		int x, z;
+		if (maze && maze->WorldToGrid(goat->GetTransform().GetPosition(), x, z)) {
+			goatsInMaze.emplace_back(goat);
+		}
 	}
-	return goatsInMaze;
 }
 
 vector<Vector3> GameWorld::CalculatePathInMaze(Vector3 startPos, Vector3 endPos) {
@@ -100,6 +224,102 @@ vector<Vector3> GameWorld::CalculatePathInMaze(Vector3 startPos, Vector3 endPos)
 	return nodes;
 }
 
+vector<Vector3> GameWorld::ReplanPathInMaze(GameObject* agent, Vector3 startPos, Vector3 endPos) {
+	vector<Vector3> nodes;
+	if (!maze) {
+		return nodes;
+	}
+	GridReplanner*& replanner = mazeReplanners[agent];
+	if (!replanner) {
+		replanner = new GridReplanner(*maze);
+	}
+	NavigationPath outPath;
+	replanner->FindPath(startPos, endPos, outPath);
+
+	Vector3 pos;
+	while (outPath.PopWaypoint(pos))
+		nodes.push_back(pos);
+
+	return nodes;
+}
+
+FlowField* GameWorld::GetGoatFlowField(GameObject* goat) const {
+	auto i = goatFlowFields.find(goat);
+	return i != goatFlowFields.end() ? i->second : nullptr;
+}
+
+/*
+However many agents are chasing or running from a goat, there's only
+one field per goat, and it's only rebuilt when the goat changes node.
+*/
+void GameWorld::UpdateGoatFlowFields() {
+	if (!maze) {
+		return;
+	}
+	for (GameObject* goat : playerGoats) {
+		FlowField*& field = goatFlowFields[goat];
+		if (!field) {
+			field = new FlowField(*maze, true);
+		}
+		field->SetTarget(goat->GetTransform().GetPosition());
+	}
+}
+
+/*
+Both maps are only spread a node further each update, rather than
+worked out from scratch, which is plenty to keep up with the goats.
+*/
+void GameWorld::UpdateInfluenceMaps(float dt) {
+	if (!goatThreat) {
+		return;
+	}
+	goatThreat->Update(dt, jobSystem);
+	civilianDensity->Update(dt, jobSystem);
+}
+
+/*
+The hedges are the maze's nodes, so sight lines in the maze just walk
+the grid, rather than raycasting against every object in the world.
+Anything else, like other agents, no longer blocks the view in there.
+*/
+bool GameWorld::CanSee(const Vector3& from, GameObject* target) const {
+	Vector3 targetPos = target->GetTransform().GetPosition();
+	int x, z;
+	if (mazeVisibility && maze->WorldToGrid(from, x, z) && maze->WorldToGrid(targetPos, x, z)) {
+		return mazeVisibility->HasLineOfSight(from, targetPos);
+	}
+	Ray ray(from, (targetPos - from).Normalised());
+	RayCollision collision;
+	return Raycast(ray, collision, true) && collision.node == target;
+}
+
+void GameWorld::ClearMazeServices() {
+	for (auto& i : mazeReplanners) {
+		delete i.second;
+	}
+	mazeReplanners.clear();
+
+	for (auto& i : goatFlowFields) {
+		delete i.second;
+	}
+	goatFlowFields.clear();
+
+	delete pathRequests; //waits for any searches still running
+	pathRequests = nullptr;
+
+	delete mazeVisibility;
+	mazeVisibility = nullptr;
+
+	delete mazeDistances;
+	mazeDistances = nullptr;
+
+	delete goatThreat;
+	goatThreat = nullptr;
+
+	delete civilianDensity;
+	civilianDensity = nullptr;
+}
+
 void GameWorld::GetObjectIterators(
 	GameObjectIterator& first,
 	GameObjectIterator& last) const {
@@ -115,6 +335,17 @@ void GameWorld::OperateOnContents(GameObjectFunc f) {
 }
 
 void GameWorld::UpdateWorld(float dt) {
+	ProcessRemovals();
+
+	if (pathRequests) {
+		pathRequests->Update(); //searches run alongside physics and rendering
+	}
+	UpdateGoatFlowFields();
+	UpdatePerception();
+	UpdateInfluenceMaps(dt);
+	crowd.Update(dt, jobSystem);
+	crowd.ApplyAvoidance();
+
 	auto rng = std::default_random_engine{};
 
 	unsigned seed = std::chrono::system_clock::now().time_since_epoch().count();
@@ -122,6 +353,9 @@ void GameWorld::UpdateWorld(float dt) {
 
 	if (shuffleObjects) {
 		std::shuffle(gameObjects.begin(), gameObjects.end(), e);
+		for (int i = 0; i < (int)gameObjects.size(); ++i) {
+			gameObjects[i]->SetWorldIndex(i);
+		}
 	}
 
 	if (shuffleConstraints) {
@@ -129,7 +363,14 @@ void GameWorld::UpdateWorld(float dt) {
 	}
 }
 
+void GameWorld::CaptureSnapshot() {
+	int back = 1 - currentSnapshot;
+	snapshots[back].Capture(*this);
+	currentSnapshot = back;
+}
+
 bool GameWorld::Raycast(Ray& r, RayCollision& closestCollision, bool closestObject, GameObject* ignoreThis) const {
+	raycastCount.fetch_add(1, std::memory_order_relaxed);
 	//The simplest raycast just goes through each object and sees if there's a collision
 	RayCollision collision;
 
@@ -1,13 +1,25 @@
 #pragma once
+#include <atomic>
 #include <random>
+#include <unordered_map>
 
 #include "Ray.h"
 #include "CollisionDetection.h"
 #include "QuadTree.h"
 #include "OctTree.h"
 #include "NavigationGrid.h"
+#include "GridReplanner.h"
+#include "PathRequestService.h"
+#include "FlowField.h"
+#include "GridVisibility.h"
+#include "DistanceField.h"
+#include "InfluenceMap.h"
+#include "PerceptionSystem.h"
+#include "CrowdSystem.h"
+#include "WorldSnapshot.h"
 namespace NCL {
 		class Camera;
+		class JobSystem;
 		using Maths::Ray;
 	namespace CSC8503 {
 		class GameObject;
@@ -33,6 +45,10 @@ namespace NCL {
 			void AddGoat(GameObject* o);
 			void RemoveGoat(GameObject* o, bool andDelete = false);
 
+			// Removal is held until ProcessRemovals, so it's safe to call mid-update
+			void QueueRemoveGameObject(GameObject* o, bool andDelete = false);
+			void ProcessRemovals();
+
 			void AddConstraint(Constraint* c);
 			void RemoveConstraint(Constraint* c, bool andDelete = false);
 
@@ -50,6 +66,11 @@ namespace NCL {
 
 			bool Raycast(Ray& r, RayCollision& closestCollision, bool closestObject = false, GameObject* ignore = nullptr) const;
 
+			// How many times Raycast has been called, sight lines and rays through the maze's fields aren't included
+			unsigned int GetRaycastCount() const {
+				return raycastCount.load(std::memory_order_relaxed);
+			}
+
 			virtual void UpdateWorld(float dt);
 
 			void OperateOnContents(GameObjectFunc f);
@@ -70,22 +91,98 @@ namespace NCL {
 				physicsSystem = physics;
 			}
 
+			// Shared worker pool for systems operating on this world, may be null
+			void SetJobSystem(JobSystem* jobs) {
+				jobSystem = jobs;
+			}
+
+			JobSystem* GetJobSystem() const {
+				return jobSystem;
+			}
+
+			/*
+			Snapshots are double buffered, capturing writes the back one and
+			then flips, so anything still reading the last capture is safe.
+			*/
+			void CaptureSnapshot();
+
+			const WorldSnapshot& GetSnapshot() const {
+				return snapshots[currentSnapshot];
+			}
+
 			void AddMaze(NavigationGrid* maze);
 			NavigationGrid* GetMaze() const { return maze; }
 			void RemoveMazeNode(GameObject* node);
 			vector<Vector3> CalculatePathInMaze(Vector3 startPos, Vector3 endPos);
-
-			vector<GameObject*> GetGoats() const { return playerGoats; }
-			vector<GameObject*> GetGoatsInMaze();
+			// Keeps the agent's last search around, and repairs it rather than starting again.
+			// A new end node means a full search though, so chasing a goat uses GetGoatFlowField instead
+			vector<Vector3> ReplanPathInMaze(GameObject* agent, Vector3 startPos, Vector3 endPos);
+			// Null until a maze has been added
+			PathRequestService* GetPathRequests() const { return pathRequests; }
+			// Distances to the goat from across the maze, kept up to date by UpdateWorld. Null if there's no maze
+			FlowField* GetGoatFlowField(GameObject* goat) const;
+			// Null until a maze has been added
+			GridVisibility* GetMazeVisibility() const { return mazeVisibility; }
+			// How far it is to the nearest hedge from across the maze. Null until a maze has been added
+			DistanceField* GetMazeDistances() const { return mazeDistances; }
+			// How close the goats are across the maze, spreading around the hedges. Null until a maze has been added
+			InfluenceMap* GetGoatThreat() const { return goatThreat; }
+			// Where the civilians are crowded together. They're added as sources by whoever adds them. Null until a maze has been added
+			InfluenceMap* GetCivilianDensity() const { return civilianDensity; }
+			// Nothing in the way of the target? Within the maze only the hedges can block the view
+			bool CanSee(const Vector3& from, GameObject* target) const;
+
+			const vector<GameObject*>& GetGoats() const { return playerGoats; }
+			// Goats within the maze's bounds as of the last UpdateWorld
+			const vector<GameObject*>& GetGoatsInMaze() const { return goatsInMaze; }
+
+			// Where the goats and geese are, for agents to sense. Goats are added as sources automatically
+			PerceptionSystem& GetPerception() { return perception; }
+			const PerceptionSystem& GetPerception() const { return perception; }
+
+			// Keeps the civilians and geese added to it out of each other's way, updated by UpdateWorld
+			CrowdSystem& GetCrowd() { return crowd; }
+			const CrowdSystem& GetCrowd() const { return crowd; }
 
 		protected:
 			std::vector<GameObject*> gameObjects;
 			std::vector<GameObject*> playerGoats;
+			std::vector<GameObject*> goatsInMaze;
 			std::vector<Constraint*> constraints;
 
+			struct PendingRemoval {
+				GameObject* object;
+				bool		andDelete;
+			};
+			std::vector<PendingRemoval> pendingRemovals;
+
 			PhysicsSystem* physicsSystem;
+			JobSystem* jobSystem;
+
+			WorldSnapshot snapshots[2];
+			int currentSnapshot;
 
 			NavigationGrid* maze;
+			std::unordered_map<GameObject*, GridReplanner*> mazeReplanners;
+			PathRequestService* pathRequests;
+			std::unordered_map<GameObject*, FlowField*> goatFlowFields;
+			GridVisibility* mazeVisibility;
+			DistanceField* mazeDistances;
+			InfluenceMap* goatThreat;
+			InfluenceMap* civilianDensity;
+
+			PerceptionSystem perception;
+			CrowdSystem crowd;
+
+			// Agents raycast from the AI's worker threads
+			mutable std::atomic<unsigned int> raycastCount;
+
+			void UpdateGoatFlowFields();
+			void UpdatePerception();
+			void UpdateInfluenceMaps(float dt);
+
+			// Everything that works off the maze has to go before the maze does
+			void ClearMazeServices();
 
 			Camera* mainCamera;
 
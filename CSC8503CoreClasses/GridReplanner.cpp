@@ -0,0 +1,284 @@
+#include "GridReplanner.h"
+
+#include <cfloat>
+
+using namespace NCL;
+using namespace CSC8503;
+
+const float SQRT2 = 1.41421356f;
+
+GridReplanner::GridReplanner(NavigationGrid& grid) : grid(grid) {
+	gridWidth		= 0;
+	gridHeight		= 0;
+	diagonals		= false;
+	startNode		= -1;
+	lastStartNode	= -1;
+	goalNode		= -1;
+	keyModifier		= 0.0f;
+	expanded		= 0;
+
+	listenerID = grid.AddChangeListener([this](int x, int z) {
+		OnGridChanged(x, z);
+	});
+}
+
+GridReplanner::~GridReplanner() {
+	grid.RemoveChangeListener(listenerID);
+}
+
+void GridReplanner::Reset() {
+	goalNode = -1;
+	g.clear();
+	changedNodes.clear();
+}
+
+void GridReplanner::Restart(int newGoal) {
+	gridWidth	= grid.GetWidth();
+	gridHeight	= grid.GetHeight();
+	diagonals	= grid.AllowsDiagonals();
+
+	size_t nodeCount = (size_t)gridWidth * gridHeight;
+	g.assign(nodeCount, FLT_MAX);
+	rhs.assign(nodeCount, FLT_MAX);
+	keys.resize(nodeCount);
+	heapIndex.assign(nodeCount, -1);
+	heap.clear();
+	changedNodes.clear();
+
+	goalNode		= newGoal;
+	lastStartNode	= startNode;
+	keyModifier		= 0.0f;
+
+	rhs[goalNode] = 0.0f;
+	QueueInsert(goalNode, CalculateKey(goalNode));
+}
+
+bool GridReplanner::FindPath(const Vector3& from, const Vector3& to, NavigationPath& outPath) {
+	expanded = 0;
+
+	int fromX, fromZ, toX, toZ;
+	if (!grid.WorldToGrid(from, fromX, fromZ) || !grid.WorldToGrid(to, toX, toZ)) {
+		return false; //outside of map region!
+	}
+	if (!grid.IsOpen(fromX, fromZ) || !grid.IsOpen(toX, toZ)) {
+		return false;
+	}
+	startNode = (fromZ * grid.GetWidth()) + fromX;
+	int newGoal = (toZ * grid.GetWidth()) + toX;
+
+	if (g.empty() || newGoal != goalNode || diagonals != grid.AllowsDiagonals() ||
+		gridWidth != grid.GetWidth() || gridHeight != grid.GetHeight()) {
+		Restart(newGoal);
+	}
+	else {
+		/*
+		Keys in the queue were worked out with the heuristic from where the
+		agent used to be. Rather than redo them all, everything new gets
+		the distance moved added on, which keeps the queue order correct.
+		*/
+		if (startNode != lastStartNode) {
+			keyModifier += Distance(lastStartNode, startNode);
+			lastStartNode = startNode;
+		}
+		for (int node : changedNodes) {
+			int x = node % gridWidth;
+			int z = node / gridWidth;
+			for (int dz = -1; dz <= 1; ++dz) {
+				for (int dx = -1; dx <= 1; ++dx) {
+					if (x + dx >= 0 && x + dx < gridWidth && z + dz >= 0 && z + dz < gridHeight) {
+						UpdateNode(((z + dz) * gridWidth) + x + dx);
+					}
+				}
+			}
+		}
+		changedNodes.clear();
+	}
+	ComputeShortestPath();
+
+	if (g[startNode] == FLT_MAX) {
+		return false; //no way to the goal from here
+	}
+	/*
+	Every node's g is now its distance to the goal, so the path is found by
+	always stepping to whichever neighbour gets closest.
+	*/
+	thread_local std::vector<int> nodes;
+	nodes.clear();
+	nodes.push_back(startNode);
+
+	int current = startNode;
+	while (current != goalNode) {
+		int best = -1;
+		float bestCost = FLT_MAX;
+		ForEachNeighbour(current, [&](int neighbour, float cost) {
+			if (g[neighbour] != FLT_MAX && cost + g[neighbour] < bestCost) {
+				bestCost = cost + g[neighbour];
+				best = neighbour;
+			}
+		});
+		if (best == -1 || nodes.size() > g.size()) {
+			return false;
+		}
+		nodes.push_back(best);
+		current = best;
+	}
+	for (auto i = nodes.rbegin(); i != nodes.rend(); ++i) {
+		outPath.PushWaypoint(grid.GetNodePosition(*i));
+	}
+	return true;
+}
+
+GridReplanner::Key GridReplanner::CalculateKey(int node) const {
+	float best = std::min(g[node], rhs[node]);
+	if (best == FLT_MAX) {
+		return { FLT_MAX, FLT_MAX };
+	}
+	return { best + Distance(startNode, node) + keyModifier, best };
+}
+
+void GridReplanner::UpdateNode(int node) {
+	if (node != goalNode) {
+		float best = FLT_MAX;
+		ForEachNeighbour(node, [&](int neighbour, float cost) {
+			if (g[neighbour] != FLT_MAX) {
+				best = std::min(best, cost + g[neighbour]);
+			}
+		});
+		rhs[node] = best;
+	}
+	QueueRemove(node);
+	if (g[node] != rhs[node]) {
+		QueueInsert(node, CalculateKey(node));
+	}
+}
+
+void GridReplanner::ComputeShortestPath() {
+	while (!heap.empty() &&
+		(keys[heap[0]] < CalculateKey(startNode) || rhs[startNode] != g[startNode])) {
+		int node = heap[0];
+		Key oldKey = keys[node];
+		Key newKey = CalculateKey(node);
+		expanded++;
+
+		if (oldKey < newKey) { //agent has moved since this was queued
+			QueueRemove(node);
+			QueueInsert(node, newKey);
+		}
+		else if (g[node] > rhs[node]) { //found a better route through here
+			g[node] = rhs[node];
+			QueueRemove(node);
+			ForEachNeighbour(node, [&](int neighbour, float) {
+				UpdateNode(neighbour);
+			});
+		}
+		else { //route through here got worse, so everything around it needs another look
+			g[node] = FLT_MAX;
+			ForEachNeighbour(node, [&](int neighbour, float) {
+				UpdateNode(neighbour);
+			});
+			UpdateNode(node);
+		}
+	}
+}
+
+template <typename F>
+void GridReplanner::ForEachNeighbour(int node, F&& func) const {
+	int x = node % gridWidth;
+	int z = node / gridWidth;
+	if (!grid.IsOpen(x, z)) {
+		return; //walls don't go anywhere
+	}
+	for (int dz = -1; dz <= 1; ++dz) {
+		for (int dx = -1; dx <= 1; ++dx) {
+			if (dx == 0 && dz == 0) {
+				continue;
+			}
+			bool diagonal = dx != 0 && dz != 0;
+			if (diagonal && !diagonals) {
+				continue;
+			}
+			if (!grid.IsOpen(x + dx, z + dz)) {
+				continue;
+			}
+			if (diagonal && (!grid.IsOpen(x + dx, z) || !grid.IsOpen(x, z + dz))) {
+				continue; //no cutting across wall corners
+			}
+			func(((z + dz) * gridWidth) + x + dx, diagonal ? SQRT2 : 1.0f);
+		}
+	}
+}
+
+float GridReplanner::Distance(int node, int endNode) const {
+	int dx = std::abs((node % gridWidth) - (endNode % gridWidth));
+	int dz = std::abs((node / gridWidth) - (endNode / gridWidth));
+	if (!diagonals) {
+		return (float)(dx + dz);
+	}
+	int diagonal = std::min(dx, dz);
+	return (diagonal * SQRT2) + (float)(std::max(dx, dz) - diagonal);
+}
+
+void GridReplanner::OnGridChanged(int x, int z) {
+	if (!g.empty()) {
+		changedNodes.push_back((z * gridWidth) + x);
+	}
+}
+
+void GridReplanner::QueueInsert(int node, const Key& key) {
+	keys[node]		= key;
+	heapIndex[node] = (int)heap.size();
+	heap.push_back(node);
+	SiftUp(heapIndex[node]);
+}
+
+void GridReplanner::QueueRemove(int node) {
+	int heapPos = heapIndex[node];
+	if (heapPos == -1) {
+		return;
+	}
+	int last = (int)heap.size() - 1;
+	Swap(heapPos, last);
+	heap.pop_back();
+	heapIndex[node] = -1;
+	if (heapPos < last) {
+		SiftUp(heapPos);
+		SiftDown(heapPos);
+	}
+}
+
+void GridReplanner::SiftUp(int heapPos) {
+	while (heapPos > 0) {
+		int parentPos = (heapPos - 1) / 2;
+		if (!(keys[heap[heapPos]] < keys[heap[parentPos]])) {
+			break;
+		}
+		Swap(heapPos, parentPos);
+		heapPos = parentPos;
+	}
+}
+
+void GridReplanner::SiftDown(int heapPos) {
+	int count = (int)heap.size();
+	while (true) {
+		int left	= (heapPos * 2) + 1;
+		int right	= left + 1;
+		int best	= heapPos;
+		if (left < count && keys[heap[left]] < keys[heap[best]]) {
+			best = left;
+		}
+		if (right < count && keys[heap[right]] < keys[heap[best]]) {
+			best = right;
+		}
+		if (best == heapPos) {
+			break;
+		}
+		Swap(heapPos, best);
+		heapPos = best;
+	}
+}
+
+void GridReplanner::Swap(int a, int b) {
+	std::swap(heap[a], heap[b]);
+	heapIndex[heap[a]] = a;
+	heapIndex[heap[b]] = b;
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include "NavigationGrid.h"
+
+namespace NCL {
+	namespace CSC8503 {
+		/*
+		D* Lite (Koenig & Likhachev) - an incremental search for one agent
+		heading to one goal. It searches backwards from the goal, and keeps
+		its results between calls, so when the agent moves on, or the grid
+		changes underneath it, only the part of the search that the change
+		actually affects is redone, rather than starting again.
+
+		A new goal means starting again, so this suits agents that keep the
+		same goal for a while. It holds a couple of values per grid node, so
+		give one to each agent that needs it rather than one per search.
+		*/
+		class GridReplanner {
+		public:
+			GridReplanner(NavigationGrid& grid);
+			~GridReplanner();
+
+			bool FindPath(const Vector3& from, const Vector3& to, NavigationPath& outPath);
+
+			// Forgets everything, so the next FindPath is a full search
+			void Reset();
+
+			// How many nodes the last FindPath took off the queue
+			int GetExpandedCount() const {
+				return expanded;
+			}
+
+		protected:
+			struct Key {
+				float primary;
+				float secondary;
+
+				bool operator<(const Key& other) const {
+					return primary < other.primary ||
+						(primary == other.primary && secondary < other.secondary);
+				}
+			};
+
+			void	Restart(int newGoal);
+			Key		CalculateKey(int node) const;
+			void	UpdateNode(int node);
+			void	ComputeShortestPath();
+
+			float	Distance(int node, int endNode) const;
+
+			// Calls func(neighbour, cost) for every node that can be stepped to from this one
+			template <typename F>
+			void	ForEachNeighbour(int node, F&& func) const;
+
+			void	OnGridChanged(int x, int z);
+
+			void	QueueInsert(int node, const Key& key);
+			void	QueueRemove(int node);
+			void	SiftUp(int heapPos);
+			void	SiftDown(int heapPos);
+			void	Swap(int a, int b);
+
+			NavigationGrid& grid;
+			int listenerID;
+
+			int		gridWidth;
+			int		gridHeight;
+			bool	diagonals;
+
+			int		startNode;
+			int		lastStartNode;
+			int		goalNode;
+			float	keyModifier;	// How far the agent has moved since the queue's keys were worked out
+			int		expanded;
+
+			std::vector<float>	g;
+			std::vector<float>	rhs;		// One step lookahead of g
+			std::vector<Key>	keys;
+			std::vector<int>	heapIndex;	// -1 when not queued
+			std::vector<int>	heap;
+
+			std::vector<int>	changedNodes;	// Grid changes since the last FindPath
+		};
+	}
+}
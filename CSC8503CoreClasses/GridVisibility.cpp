@@ -0,0 +1,153 @@
+#include "GridVisibility.h"
+
+#include <cfloat>
+#include <cmath>
+
+using namespace NCL;
+using namespace CSC8503;
+
+GridVisibility::GridVisibility(NavigationGrid& grid) : grid(grid) {
+	setRadius	= 0;
+	setWidth	= 0;
+	wordsPerSet	= 0;
+	rebuiltSets	= 0;
+	sightLineCount	= 0;
+
+	listenerID = grid.AddChangeListener([this](int x, int z) {
+		OnGridChanged(x, z);
+	});
+}
+
+GridVisibility::~GridVisibility() {
+	grid.RemoveChangeListener(listenerID);
+}
+
+bool GridVisibility::ToGridSpace(const Vector3& position, float& x, float& z) const {
+	Vector3 offset = position - grid.GetZeroPos();
+	float nodeSize = (float)grid.GetNodeSize();
+	x = (offset.x / nodeSize) + 0.5f; //node positions are the middle of each node
+	z = (offset.z / nodeSize) + 0.5f;
+	return x >= 0.0f && x < grid.GetWidth() && z >= 0.0f && z < grid.GetHeight();
+}
+
+bool GridVisibility::HasLineOfSight(const Vector3& from, const Vector3& to) const {
+	sightLineCount.fetch_add(1, std::memory_order_relaxed);
+	float fromX, fromZ, toX, toZ;
+	if (!ToGridSpace(from, fromX, fromZ) || !ToGridSpace(to, toX, toZ)) {
+		return false;
+	}
+	return TraceLine(fromX, fromZ, toX, toZ);
+}
+
+/*
+Steps from node to node along the line, each time crossing whichever
+node edge the line reaches first. tMax is how far along the line the
+next edge in each axis is, and tDelta how far it is between edges.
+*/
+bool GridVisibility::TraceLine(float fromX, float fromZ, float toX, float toZ) const {
+	int x		= (int)fromX;
+	int z		= (int)fromZ;
+	int endX	= (int)toX;
+	int endZ	= (int)toZ;
+	if (!grid.IsOpen(x, z) || !grid.IsOpen(endX, endZ)) {
+		return false;
+	}
+	float dx = toX - fromX;
+	float dz = toZ - fromZ;
+	int stepX = (dx > 0.0f) - (dx < 0.0f);
+	int stepZ = (dz > 0.0f) - (dz < 0.0f);
+
+	float tDeltaX	= stepX ? 1.0f / std::abs(dx) : FLT_MAX;
+	float tDeltaZ	= stepZ ? 1.0f / std::abs(dz) : FLT_MAX;
+	float tMaxX		= stepX > 0 ? (x + 1 - fromX) * tDeltaX : stepX < 0 ? (fromX - x) * tDeltaX : FLT_MAX;
+	float tMaxZ		= stepZ > 0 ? (z + 1 - fromZ) * tDeltaZ : stepZ < 0 ? (fromZ - z) * tDeltaZ : FLT_MAX;
+
+	const float cornerSlop = 0.00001f;
+	int steps = abs(endX - x) + abs(endZ - z); //never takes more than this, even if rounding skips the end node
+
+	for (int i = 0; i < steps && (x != endX || z != endZ); ++i) {
+		if (tMaxX < tMaxZ - cornerSlop) {
+			x		+= stepX;
+			tMaxX	+= tDeltaX;
+		}
+		else if (tMaxZ < tMaxX - cornerSlop) {
+			z		+= stepZ;
+			tMaxZ	+= tDeltaZ;
+		}
+		else { //straight through a corner, which a wall on either side blocks
+			if (!grid.IsOpen(x + stepX, z) || !grid.IsOpen(x, z + stepZ)) {
+				return false;
+			}
+			x		+= stepX;
+			z		+= stepZ;
+			tMaxX	+= tDeltaX;
+			tMaxZ	+= tDeltaZ;
+			i++;
+		}
+		if (!grid.IsOpen(x, z)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void GridVisibility::BuildVisibilitySets(float range) {
+	setRadius	= std::max(1, (int)std::ceil(range / grid.GetNodeSize()));
+	setWidth	= (setRadius * 2) + 1;
+	wordsPerSet	= ((setWidth * setWidth) + 63) / 64;
+	visibleSets.assign((size_t)grid.GetWidth() * grid.GetHeight() * wordsPerSet, 0);
+
+	for (int z = 0; z < grid.GetHeight(); ++z) {
+		for (int x = 0; x < grid.GetWidth(); ++x) {
+			BuildSet(x, z);
+		}
+	}
+	rebuiltSets = 0;
+}
+
+void GridVisibility::BuildSet(int x, int z) {
+	rebuiltSets++;
+	uint64_t* set = &visibleSets[(size_t)((z * grid.GetWidth()) + x) * wordsPerSet];
+	std::fill(set, set + wordsPerSet, 0);
+	if (!grid.IsOpen(x, z)) {
+		return; //can't see anything from inside a wall
+	}
+	for (int dz = -setRadius; dz <= setRadius; ++dz) {
+		for (int dx = -setRadius; dx <= setRadius; ++dx) {
+			if (TraceLine(x + 0.5f, z + 0.5f, x + dx + 0.5f, z + dz + 0.5f)) {
+				int bit = ((dz + setRadius) * setWidth) + dx + setRadius;
+				set[bit / 64] |= (uint64_t)1 << (bit % 64);
+			}
+		}
+	}
+}
+
+bool GridVisibility::NodesVisible(const Vector3& from, const Vector3& to) const {
+	int fromX, fromZ, toX, toZ;
+	if (!grid.WorldToGrid(from, fromX, fromZ) || !grid.WorldToGrid(to, toX, toZ)) {
+		return false;
+	}
+	int dx = toX - fromX;
+	int dz = toZ - fromZ;
+	if (setRadius == 0 || abs(dx) > setRadius || abs(dz) > setRadius) { //out of range of the sets
+		return TraceLine(fromX + 0.5f, fromZ + 0.5f, toX + 0.5f, toZ + 0.5f);
+	}
+	const uint64_t* set = &visibleSets[(size_t)((fromZ * grid.GetWidth()) + fromX) * wordsPerSet];
+	int bit = ((dz + setRadius) * setWidth) + dx + setRadius;
+	return (set[bit / 64] >> (bit % 64)) & 1;
+}
+
+/*
+Any line the node could be blocking ends at nodes within setRadius of
+it, so those are the only sets that need doing again.
+*/
+void GridVisibility::OnGridChanged(int x, int z) {
+	if (setRadius == 0) {
+		return;
+	}
+	for (int nz = std::max(0, z - setRadius); nz <= std::min(grid.GetHeight() - 1, z + setRadius); ++nz) {
+		for (int nx = std::max(0, x - setRadius); nx <= std::min(grid.GetWidth() - 1, x + setRadius); ++nx) {
+			BuildSet(nx, nz);
+		}
+	}
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include "NavigationGrid.h"
+
+#include <atomic>
+#include <cstdint>
+
+namespace NCL {
+	namespace CSC8503 {
+		/*
+		Answers "can A see B?" against the maze's walls, by stepping
+		through exactly the nodes a line between them passes over (a DDA
+		walk), rather than raycasting against every object in the world.
+		The walls are the grid's nodes, so nothing else is needed, and
+		nothing has to be redone when a node changes.
+
+		Optionally, every node can also have the set of nodes visible from
+		it worked out ahead of time, out to some range. Looking those up is
+		a single bit test, but only says whether the centres of the nodes
+		can see each other. When a node opens up, only the sets of nodes
+		within range of it can have changed, so only those are rebuilt.
+		*/
+		class GridVisibility {
+		public:
+			GridVisibility(NavigationGrid& grid);
+			~GridVisibility();
+
+			// False if a wall is in the way, or the line leaves the grid
+			bool HasLineOfSight(const Vector3& from, const Vector3& to) const;
+
+			// Works out which nodes can see each other, out to range world units
+			void BuildVisibilitySets(float range);
+
+			bool HasVisibilitySets() const {
+				return setRadius > 0;
+			}
+
+			// Whether the centres of the nodes under each position can see each other
+			bool NodesVisible(const Vector3& from, const Vector3& to) const;
+
+			// How many nodes have had their set rebuilt since BuildVisibilitySets
+			int GetRebuiltSetCount() const {
+				return rebuiltSets;
+			}
+
+			// How many times HasLineOfSight has been asked
+			unsigned int GetSightLineCount() const {
+				return sightLineCount.load(std::memory_order_relaxed);
+			}
+
+		protected:
+			// Positions are in nodes, with node x covering x to x + 1
+			bool TraceLine(float fromX, float fromZ, float toX, float toZ) const;
+			bool ToGridSpace(const Vector3& position, float& x, float& z) const;
+
+			void BuildSet(int x, int z);
+			void OnGridChanged(int x, int z);
+
+			NavigationGrid& grid;
+			int listenerID;
+
+			/*
+			Each node's set covers the square of nodes setRadius either side
+			of it, one bit per node, a row at a time.
+			*/
+			int						setRadius;
+			int						setWidth;
+			int						wordsPerSet;
+			std::vector<uint64_t>	visibleSets;
+			int						rebuiltSets;
+
+			// Agents check sight lines from the AI's worker threads
+			mutable std::atomic<unsigned int> sightLineCount;
+		};
+	}
+}
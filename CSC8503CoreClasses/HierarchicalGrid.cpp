@@ -0,0 +1,443 @@
+#include "HierarchicalGrid.h"
+
+#include <cfloat>
+
+using namespace NCL;
+using namespace CSC8503;
+
+const unsigned char NEG_X_TRANSITION = 1;
+const unsigned char POS_X_TRANSITION = 2;
+const unsigned char NEG_Z_TRANSITION = 4;
+const unsigned char POS_Z_TRANSITION = 8;
+
+// Open runs along a border shorter than this get one entrance in the middle, longer ones get one at each end
+const int MAX_SINGLE_ENTRANCE_RUN = 6;
+
+const float SQRT2 = 1.41421356f;
+
+namespace {
+	thread_local GridSearch abstractSearch;
+}
+
+HierarchicalGrid::HierarchicalGrid(NavigationGrid& grid, int clusterSize) : grid(grid) {
+	this->clusterSize = std::max(clusterSize, 2);
+	Rebuild();
+
+	listenerID = grid.AddChangeListener([this](int x, int z) {
+		OnGridChanged(x, z);
+	});
+}
+
+HierarchicalGrid::~HierarchicalGrid() {
+	grid.RemoveChangeListener(listenerID);
+}
+
+void HierarchicalGrid::Rebuild() {
+	gridWidth	= grid.GetWidth();
+	gridHeight	= grid.GetHeight();
+	clustersX	= (gridWidth  + clusterSize - 1) / clusterSize;
+	clustersZ	= (gridHeight + clusterSize - 1) / clusterSize;
+
+	clusters.clear();
+	clusters.resize(clustersX * clustersZ);
+	for (int cz = 0; cz < clustersZ; ++cz) {
+		for (int cx = 0; cx < clustersX; ++cx) {
+			Cluster& c = clusters[(cz * clustersX) + cx];
+			c.minX = cx * clusterSize;
+			c.minZ = cz * clusterSize;
+			c.maxX = std::min(c.minX + clusterSize, gridWidth) - 1;
+			c.maxZ = std::min(c.minZ + clusterSize, gridHeight) - 1;
+		}
+	}
+	transitions.assign(gridWidth * gridHeight, 0);
+	entranceIndex.assign(gridWidth * gridHeight, -1);
+
+	for (int cz = 0; cz < clustersZ; ++cz) {
+		for (int cx = 0; cx < clustersX; ++cx) {
+			BuildBorder(cx, cz, true);
+			BuildBorder(cx, cz, false);
+		}
+	}
+	for (int cz = 0; cz < clustersZ; ++cz) {
+		for (int cx = 0; cx < clustersX; ++cx) {
+			BuildCluster(cx, cz);
+		}
+	}
+}
+
+/*
+Walks along the border, finding each run of node pairs that are open on
+both sides, and marks where the run's entrances are. Any entrances left
+from before are wiped first, so this also works after the grid changes.
+*/
+void HierarchicalGrid::BuildBorder(int cx, int cz, bool alongX) {
+	if ((alongX && cx + 1 >= clustersX) || (!alongX && cz + 1 >= clustersZ)) {
+		return; //edge of the map, nothing on the other side
+	}
+	const Cluster& c = clusters[(cz * clustersX) + cx];
+
+	int runLength	= alongX ? (c.maxZ - c.minZ + 1) : (c.maxX - c.minX + 1);
+	int step		= alongX ? gridWidth : 1;
+	int across		= alongX ? 1 : gridWidth;
+	int firstNode	= alongX ? (c.minZ * gridWidth) + c.maxX : (c.maxZ * gridWidth) + c.minX;
+
+	unsigned char nearBit	= alongX ? POS_X_TRANSITION : POS_Z_TRANSITION;
+	unsigned char farBit	= alongX ? NEG_X_TRANSITION : NEG_Z_TRANSITION;
+
+	for (int i = 0; i < runLength; ++i) {
+		int node = firstNode + (i * step);
+		transitions[node]			&= ~nearBit;
+		transitions[node + across]	&= ~farBit;
+	}
+
+	auto BothOpen = [&](int i) {
+		int node = firstNode + (i * step);
+		int x = node % gridWidth;
+		int z = node / gridWidth;
+		return grid.IsOpen(x, z) && (alongX ? grid.IsOpen(x + 1, z) : grid.IsOpen(x, z + 1));
+	};
+	auto Mark = [&](int i) {
+		int node = firstNode + (i * step);
+		transitions[node]			|= nearBit;
+		transitions[node + across]	|= farBit;
+	};
+
+	int i = 0;
+	while (i < runLength) {
+		if (!BothOpen(i)) {
+			++i;
+			continue;
+		}
+		int runStart = i;
+		while (i < runLength && BothOpen(i)) {
+			++i;
+		}
+		int runEnd = i - 1;
+		if (runEnd - runStart + 1 < MAX_SINGLE_ENTRANCE_RUN) {
+			Mark((runStart + runEnd) / 2);
+		}
+		else {
+			Mark(runStart);
+			Mark(runEnd);
+		}
+	}
+}
+
+void HierarchicalGrid::BuildCluster(int cx, int cz) {
+	Cluster& c = clusters[(cz * clustersX) + cx];
+
+	c.entrances.clear();
+	for (int z = c.minZ; z <= c.maxZ; ++z) {
+		for (int x = c.minX; x <= c.maxX; ++x) {
+			int node = (z * gridWidth) + x;
+			if (transitions[node]) {
+				entranceIndex[node] = (int)c.entrances.size();
+				c.entrances.push_back(node);
+			}
+			else {
+				entranceIndex[node] = -1;
+			}
+		}
+	}
+
+	size_t count = c.entrances.size();
+	c.distances.assign(count * count, FLT_MAX);
+
+	GridSearch search;
+	for (size_t i = 0; i < count; ++i) {
+		SearchCluster(c, c.entrances[i], -1, search);
+		for (size_t j = 0; j < count; ++j) {
+			int local = LocalIndex(c, c.entrances[j]);
+			if (search.IsClosed(local)) {
+				c.distances[(i * count) + j] = search.GetG(local);
+			}
+		}
+	}
+}
+
+/*
+Changing a node only changes the routes through its own cluster, unless
+it sits on the cluster's edge, where it might also open or close off an
+entrance to the cluster next door.
+*/
+void HierarchicalGrid::OnGridChanged(int x, int z) {
+	int cx = x / clusterSize;
+	int cz = z / clusterSize;
+	const Cluster& c = clusters[(cz * clustersX) + cx];
+
+	if (x == c.minX && cx > 0) {
+		BuildBorder(cx - 1, cz, true);
+		BuildCluster(cx - 1, cz);
+	}
+	if (x == c.maxX && cx + 1 < clustersX) {
+		BuildBorder(cx, cz, true);
+		BuildCluster(cx + 1, cz);
+	}
+	if (z == c.minZ && cz > 0) {
+		BuildBorder(cx, cz - 1, false);
+		BuildCluster(cx, cz - 1);
+	}
+	if (z == c.maxZ && cz + 1 < clustersZ) {
+		BuildBorder(cx, cz, false);
+		BuildCluster(cx, cz + 1);
+	}
+	BuildCluster(cx, cz);
+}
+
+bool HierarchicalGrid::SearchCluster(const Cluster& c, int startNode, int endNode, GridSearch& search) const {
+	int width	= c.maxX - c.minX + 1;
+	int height	= c.maxZ - c.minZ + 1;
+	int endLocal = endNode == -1 ? -1 : LocalIndex(c, endNode);
+	bool diagonals = grid.AllowsDiagonals();
+
+	auto LocalDistance = [&](int local) {
+		if (endLocal == -1) {
+			return 0.0f; //no goal, so this is just Dijkstra
+		}
+		int dx = std::abs((local % width) - (endLocal % width));
+		int dz = std::abs((local / width) - (endLocal / width));
+		if (!diagonals) {
+			return (float)(dx + dz);
+		}
+		int diagonal = std::min(dx, dz);
+		return (diagonal * SQRT2) + (float)(std::max(dx, dz) - diagonal);
+	};
+
+	search.Begin(width * height);
+	int startLocal = LocalIndex(c, startNode);
+	search.Open(startLocal, 0.0f, LocalDistance(startLocal), -1);
+
+	while (search.HasOpen()) {
+		int current = search.PopBest();
+		if (current == endLocal) {
+			return true;
+		}
+		search.Close(current);
+
+		int x = c.minX + (current % width);
+		int z = c.minZ + (current / width);
+		for (int dz = -1; dz <= 1; ++dz) {
+			for (int dx = -1; dx <= 1; ++dx) {
+				if (dx == 0 && dz == 0) {
+					continue;
+				}
+				bool diagonal = dx != 0 && dz != 0;
+				if (diagonal && !diagonals) {
+					continue;
+				}
+				int nx = x + dx;
+				int nz = z + dz;
+				if (nx < c.minX || nx > c.maxX || nz < c.minZ || nz > c.maxZ || !grid.IsOpen(nx, nz)) {
+					continue;
+				}
+				if (diagonal && (!grid.IsOpen(nx, z) || !grid.IsOpen(x, nz))) {
+					continue; //no cutting across wall corners
+				}
+				int neighbour = ((nz - c.minZ) * width) + (nx - c.minX);
+				if (search.IsClosed(neighbour)) {
+					continue;
+				}
+				float g = search.GetG(current) + (diagonal ? SQRT2 : 1.0f);
+				if (!search.IsSeen(neighbour) || g < search.GetG(neighbour)) {
+					search.Open(neighbour, g, g + LocalDistance(neighbour), current);
+				}
+			}
+		}
+	}
+	return false;
+}
+
+/*
+The abstract graph is never built as such - the search runs over grid
+node indices, but only ever opens the start, the end, and entrances.
+Routes out of the start's cluster and into the end's cluster come from
+a search of just those clusters, as the start and end are rarely
+entrances themselves.
+*/
+bool HierarchicalGrid::AbstractSearch(int startNode, int endNode, GridSearch& search) const {
+	thread_local GridSearch startSearch;
+	thread_local GridSearch endSearch;
+
+	int endClusterIndex = ClusterOf(endNode);
+	const Cluster& startCluster	= clusters[ClusterOf(startNode)];
+	const Cluster& endCluster	= clusters[endClusterIndex];
+
+	SearchCluster(startCluster, startNode, -1, startSearch);
+	SearchCluster(endCluster, endNode, -1, endSearch);
+
+	search.Begin(gridWidth * gridHeight);
+	search.Open(startNode, 0.0f, Distance(startNode, endNode), -1);
+
+	while (search.HasOpen()) {
+		int current = search.PopBest();
+		if (current == endNode) {
+			return true;
+		}
+		search.Close(current);
+
+		float currentG = search.GetG(current);
+		auto Relax = [&](int neighbour, float cost) {
+			if (search.IsClosed(neighbour)) {
+				return;
+			}
+			float g = currentG + cost;
+			if (!search.IsSeen(neighbour) || g < search.GetG(neighbour)) {
+				search.Open(neighbour, g, g + Distance(neighbour, endNode), current);
+			}
+		};
+
+		int clusterIndex = ClusterOf(current);
+		const Cluster& c = clusters[clusterIndex];
+
+		if (current == startNode) {
+			for (int entrance : c.entrances) {
+				int local = LocalIndex(c, entrance);
+				if (startSearch.IsClosed(local)) {
+					Relax(entrance, startSearch.GetG(local));
+				}
+			}
+		}
+		else if (entranceIndex[current] != -1) {
+			size_t count = c.entrances.size();
+			const float* row = &c.distances[entranceIndex[current] * count];
+			for (size_t i = 0; i < count; ++i) {
+				if (row[i] != FLT_MAX) {
+					Relax(c.entrances[i], row[i]);
+				}
+			}
+		}
+
+		if (clusterIndex == endClusterIndex) {
+			int local = LocalIndex(c, current);
+			if (endSearch.IsClosed(local)) {
+				Relax(endNode, endSearch.GetG(local));
+			}
+		}
+
+		unsigned char t = transitions[current];
+		if (t & NEG_X_TRANSITION) { Relax(current - 1, 1.0f); }
+		if (t & POS_X_TRANSITION) { Relax(current + 1, 1.0f); }
+		if (t & NEG_Z_TRANSITION) { Relax(current - gridWidth, 1.0f); }
+		if (t & POS_Z_TRANSITION) { Relax(current + gridWidth, 1.0f); }
+	}
+	return false;
+}
+
+bool HierarchicalGrid::FindPath(const Vector3& from, const Vector3& to, HierarchicalPath& outPath) const {
+	outPath.Clear();
+	outPath.map = this;
+
+	int fromX, fromZ, toX, toZ;
+	if (!grid.WorldToGrid(from, fromX, fromZ) || !grid.WorldToGrid(to, toX, toZ)) {
+		return false; //outside of map region!
+	}
+	if (!grid.IsOpen(fromX, fromZ) || !grid.IsOpen(toX, toZ)) {
+		return false;
+	}
+	int startNode	= (fromZ * gridWidth) + fromX;
+	int endNode		= (toZ * gridWidth) + toX;
+
+	if (startNode != endNode && !AbstractSearch(startNode, endNode, abstractSearch)) {
+		return false;
+	}
+	for (int node = endNode; node != startNode; node = abstractSearch.GetParent(node)) {
+		outPath.abstractNodes.push_back(node);
+	}
+	outPath.refinedNodes.push_back(startNode);
+	outPath.lastNode = startNode;
+	return true;
+}
+
+bool HierarchicalGrid::FindPath(const Vector3& from, const Vector3& to, NavigationPath& outPath) {
+	HierarchicalPath path;
+	if (!FindPath(from, to, path)) {
+		return false;
+	}
+	/*
+	NavigationPath hands out its waypoints from the back, so each segment
+	is refined starting from the end of the path.
+	*/
+	thread_local std::vector<int> nodes;
+	nodes.clear();
+
+	for (size_t i = 0; i < path.abstractNodes.size(); ++i) {
+		int previous = (i + 1 < path.abstractNodes.size()) ? path.abstractNodes[i + 1] : path.lastNode;
+		if (!RefineSegment(previous, path.abstractNodes[i], nodes)) {
+			return false;
+		}
+	}
+	nodes.push_back(path.lastNode);
+
+	for (int n : nodes) {
+		outPath.PushWaypoint(GetNodePosition(n));
+	}
+	return true;
+}
+
+bool HierarchicalGrid::RefineSegment(int fromNode, int toNode, std::vector<int>& outNodes) const {
+	if (fromNode == toNode) {
+		return true;
+	}
+	int dx = std::abs((fromNode % gridWidth) - (toNode % gridWidth));
+	int dz = std::abs((fromNode / gridWidth) - (toNode / gridWidth));
+	if (dx + dz == 1) {
+		outNodes.push_back(toNode); //a step across a cluster border, or a single step within one
+		return true;
+	}
+	int clusterIndex = ClusterOf(fromNode);
+	if (clusterIndex != ClusterOf(toNode)) {
+		return false;
+	}
+	const Cluster& c = clusters[clusterIndex];
+
+	thread_local GridSearch search;
+	if (!SearchCluster(c, fromNode, toNode, search)) {
+		return false; //the grid must have changed since the path was found
+	}
+	int width		= c.maxX - c.minX + 1;
+	int startLocal	= LocalIndex(c, fromNode);
+	for (int local = LocalIndex(c, toNode); local != startLocal; local = search.GetParent(local)) {
+		outNodes.push_back(((c.minZ + (local / width)) * gridWidth) + c.minX + (local % width));
+	}
+	return true;
+}
+
+float HierarchicalGrid::Distance(int node, int endNode) const {
+	int dx = std::abs((node % gridWidth) - (endNode % gridWidth));
+	int dz = std::abs((node / gridWidth) - (endNode / gridWidth));
+	if (!grid.AllowsDiagonals()) {
+		return (float)(dx + dz);
+	}
+	int diagonal = std::min(dx, dz);
+	return (diagonal * SQRT2) + (float)(std::max(dx, dz) - diagonal);
+}
+
+int HierarchicalGrid::GetEntranceCount() const {
+	int count = 0;
+	for (const Cluster& c : clusters) {
+		count += (int)c.entrances.size();
+	}
+	return count;
+}
+
+int HierarchicalGrid::GetExpandedCount() const {
+	return abstractSearch.GetExpandedCount();
+}
+
+bool HierarchicalPath::PopWaypoint(Vector3& waypoint) {
+	while (refinedNodes.empty()) {
+		if (abstractNodes.empty()) {
+			return false;
+		}
+		int next = abstractNodes.back();
+		abstractNodes.pop_back();
+		if (!map->RefineSegment(lastNode, next, refinedNodes)) {
+			Clear();
+			return false;
+		}
+		lastNode = next;
+	}
+	waypoint = map->GetNodePosition(refinedNodes.back());
+	refinedNodes.pop_back();
+	return true;
+}
@@ -0,0 +1,134 @@
+#pragma once
+#include "NavigationGrid.h"
+
+namespace NCL {
+	namespace CSC8503 {
+		class HierarchicalGrid;
+
+		/*
+		A path from HierarchicalGrid only knows which cluster entrances it
+		passes through. The nodes between each pair of entrances are only
+		worked out once the agent has walked far enough to need them, so an
+		agent that gets a new goal halfway along never pays for the rest.
+		*/
+		class HierarchicalPath {
+		public:
+			HierarchicalPath() : map(nullptr), lastNode(-1) {}
+			~HierarchicalPath() {}
+
+			void Clear() {
+				abstractNodes.clear();
+				refinedNodes.clear();
+				lastNode = -1;
+			}
+
+			bool IsEmpty() const {
+				return abstractNodes.empty() && refinedNodes.empty();
+			}
+
+			bool PopWaypoint(Vector3& waypoint);
+
+		protected:
+			friend class HierarchicalGrid;
+
+			const HierarchicalGrid* map;
+
+			std::vector<int> abstractNodes;	// Entrances still to refine, next one at the back
+			std::vector<int> refinedNodes;	// Nodes up to the next entrance, next one at the back
+			int lastNode;
+		};
+
+		/*
+		Hierarchical A* (HPA*, Botea, Muller & Schaeffer). The grid is cut
+		into square clusters, and wherever two clusters share an open border
+		a pair of entrance nodes is placed, one either side. The distance
+		between every pair of entrances in a cluster is worked out up front,
+		so a search only has to visit entrances rather than every node.
+
+		Paths come out very close to optimal rather than exactly optimal, as
+		they're forced through the chosen entrances.
+
+		The grid is watched for changes, and only the clusters touching a
+		changed node are rebuilt. Changes must not happen while a search is
+		running on another thread.
+		*/
+		class HierarchicalGrid : public NavigationMap {
+		public:
+			HierarchicalGrid(NavigationGrid& grid, int clusterSize = 8);
+			~HierarchicalGrid();
+
+			// Refines the whole path straight away, to match NavigationGrid
+			bool FindPath(const Vector3& from, const Vector3& to, NavigationPath& outPath) override;
+			// Leaves refinement until the path's waypoints are popped
+			bool FindPath(const Vector3& from, const Vector3& to, HierarchicalPath& outPath) const;
+
+			// Throws everything away and builds it again from the grid
+			void Rebuild();
+
+			int GetClusterSize() const {
+				return clusterSize;
+			}
+
+			int GetEntranceCount() const;
+
+			// How many entrances and nodes the last abstract search on this thread took off the open set
+			int GetExpandedCount() const;
+
+			// Adds the nodes after fromNode, up to and including toNode, in reverse order
+			bool RefineSegment(int fromNode, int toNode, std::vector<int>& outNodes) const;
+
+			Vector3 GetNodePosition(int node) const {
+				return grid.GetNodePosition(node);
+			}
+
+		protected:
+			struct Cluster {
+				int minX;
+				int minZ;
+				int maxX;
+				int maxZ;
+
+				std::vector<int>	entrances;	// Grid node indices
+				std::vector<float>	distances;	// entrances.size() squared, FLT_MAX if there's no route
+			};
+
+			bool AbstractSearch(int startNode, int endNode, GridSearch& search) const;
+
+			// Searches within the cluster, from one node until reaching endNode, or over everything if endNode is -1
+			bool SearchCluster(const Cluster& c, int startNode, int endNode, GridSearch& search) const;
+
+			// The border between this cluster and the next one along x (alongX) or z
+			void BuildBorder(int cx, int cz, bool alongX);
+			void BuildCluster(int cx, int cz);
+
+			void OnGridChanged(int x, int z);
+
+			int ClusterOf(int node) const {
+				int x = node % gridWidth;
+				int z = node / gridWidth;
+				return ((z / clusterSize) * clustersX) + (x / clusterSize);
+			}
+
+			int LocalIndex(const Cluster& c, int node) const {
+				int x = node % gridWidth;
+				int z = node / gridWidth;
+				return ((z - c.minZ) * (c.maxX - c.minX + 1)) + (x - c.minX);
+			}
+
+			float Distance(int node, int endNode) const;
+
+			NavigationGrid& grid;
+			int listenerID;
+
+			int clusterSize;
+			int clustersX;
+			int clustersZ;
+			int gridWidth;
+			int gridHeight;
+
+			std::vector<Cluster>		clusters;
+			std::vector<unsigned char>	transitions;		// Per node, which sides lead into a neighbouring cluster
+			std::vector<int>			entranceIndex;		// Per node, its place in its cluster's entrance list, or -1
+		};
+	}
+}
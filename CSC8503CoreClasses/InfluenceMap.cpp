@@ -0,0 +1,193 @@
+#include "InfluenceMap.h"
+#include "GameObject.h"
+#include "JobSystem.h"
+
+#include <cmath>
+
+using namespace NCL;
+using namespace CSC8503;
+
+InfluenceMap::InfluenceMap(NavigationGrid& grid, float falloff, float decayRate, float cutoff) : grid(grid) {
+	this->falloff	= falloff;
+	diagonalFalloff	= std::pow(falloff, 1.41421356f);
+	this->decayRate	= decayRate;
+	this->cutoff	= cutoff;
+
+	size_t nodeCount = (size_t)grid.GetWidth() * grid.GetHeight();
+	values.assign(nodeCount, 0.0f);
+	nextValues.assign(nodeCount, 0.0f);
+	stamps.assign(nodeCount, 0.0f);
+	nodeGenerations.assign(nodeCount, 0);
+	generation = 0;
+}
+
+InfluenceMap::~InfluenceMap() {
+}
+
+void InfluenceMap::AddSource(GameObject* object, float strength) {
+	for (Source& s : sources) {
+		if (s.object == object) {
+			s.strength = strength;
+			return;
+		}
+	}
+	sources.push_back({ object, strength });
+}
+
+void InfluenceMap::RemoveSource(GameObject* object) {
+	for (size_t i = 0; i < sources.size(); ++i) {
+		if (sources[i].object == object) {
+			sources[i] = sources.back();
+			sources.pop_back();
+			return;
+		}
+	}
+}
+
+/*
+Influence can only spread a node each update, so the only nodes that can
+change are the ones with anything in them, the ones around those, and
+wherever the sources are now. The rest of the maze is left alone.
+*/
+void InfluenceMap::Update(float dt, JobSystem* jobs) {
+	int width	= grid.GetWidth();
+	int height	= grid.GetHeight();
+
+	for (int node : stampedNodes) {
+		stamps[node] = 0.0f;
+	}
+	stampedNodes.clear();
+	for (const Source& s : sources) {
+		int x, z;
+		if (!grid.WorldToGrid(s.object->GetTransform().GetPosition(), x, z)) {
+			continue;
+		}
+		int node = (z * width) + x;
+		if (stamps[node] == 0.0f) {
+			stampedNodes.push_back(node);
+		}
+		stamps[node] += s.strength;
+	}
+
+	generation++;
+	updateNodes.clear();
+	auto addNode = [&](int node) {
+		if (nodeGenerations[node] != generation) {
+			nodeGenerations[node] = generation;
+			updateNodes.push_back(node);
+		}
+	};
+	for (int node : stampedNodes) {
+		addNode(node);
+	}
+	for (int node : liveNodes) {
+		int x = node % width;
+		int z = node / width;
+		for (int nz = std::max(z - 1, 0); nz <= std::min(z + 1, height - 1); ++nz) {
+			for (int nx = std::max(x - 1, 0); nx <= std::min(x + 1, width - 1); ++nx) {
+				addNode((nz * width) + nx);
+			}
+		}
+	}
+
+	auto updateNode = [&](int& node) {
+		UpdateNode(node, dt);
+	};
+	if (jobs) {
+		jobs->ParallelFor(std::span<int>(updateNodes), updateNode, 256);
+	}
+	else {
+		for (int& node : updateNodes) {
+			updateNode(node);
+		}
+	}
+
+	// Every node has read the values it needed, so they can be overwritten now
+	liveNodes.clear();
+	for (int node : updateNodes) {
+		values[node] = nextValues[node];
+		if (values[node] > 0.0f) {
+			liveNodes.push_back(node);
+		}
+	}
+}
+
+/*
+Only reads from values, and only writes the node's own nextValues, so
+the nodes can all be done at once.
+*/
+void InfluenceMap::UpdateNode(int node, float dt) {
+	int width		= grid.GetWidth();
+	int x			= node % width;
+	int z			= node / width;
+	bool diagonals	= grid.AllowsDiagonals();
+
+	if (!grid.IsOpen(x, z)) {
+		nextValues[node] = 0.0f;
+		return;
+	}
+	float spread = stamps[node];
+	for (int dz = -1; dz <= 1; ++dz) {
+		for (int dx = -1; dx <= 1; ++dx) {
+			if (dx == 0 && dz == 0) {
+				continue;
+			}
+			bool diagonal = dx != 0 && dz != 0;
+			if (!grid.IsOpen(x + dx, z + dz) || (diagonal && (!diagonals || !grid.IsOpen(x + dx, z) || !grid.IsOpen(x, z + dz)))) {
+				continue; //influence doesn't go through hedges, or cut across their corners
+			}
+			spread = std::max(spread, values[node + (dz * width) + dx] * (diagonal ? diagonalFalloff : falloff));
+		}
+	}
+	float current	= values[node];
+	float next		= spread >= current ? spread : current + (spread - current) * std::min(decayRate * dt, 1.0f);
+	nextValues[node] = next < cutoff ? 0.0f : next;
+}
+
+float InfluenceMap::GetValue(const Vector3& position) const {
+	int x, z;
+	if (!grid.WorldToGrid(position, x, z)) {
+		return 0.0f;
+	}
+	return values[(z * grid.GetWidth()) + x];
+}
+
+bool InfluenceMap::GetLowestDirection(const Vector3& position, Vector3& outDirection, const InfluenceMap* other, float otherWeight) const {
+	int x, z;
+	if (!grid.WorldToGrid(position, x, z)) {
+		return false;
+	}
+	int width = grid.GetWidth();
+	auto valueAt = [&](int node) {
+		return other ? values[node] + other->values[node] * otherWeight : values[node];
+	};
+
+	int best		= (z * width) + x;
+	float bestValue	= valueAt(best);
+	bool diagonals	= grid.AllowsDiagonals();
+	for (int dz = -1; dz <= 1; ++dz) {
+		for (int dx = -1; dx <= 1; ++dx) {
+			bool diagonal = dx != 0 && dz != 0;
+			if ((dx == 0 && dz == 0) || !grid.IsOpen(x + dx, z + dz) ||
+				(diagonal && (!diagonals || !grid.IsOpen(x + dx, z) || !grid.IsOpen(x, z + dz)))) {
+				continue;
+			}
+			int node = ((z + dz) * width) + x + dx;
+			float value = valueAt(node);
+			if (value < bestValue) {
+				bestValue	= value;
+				best		= node;
+			}
+		}
+	}
+	if (best == (z * width) + x) {
+		return false;
+	}
+	Vector3 direction = grid.GetNodePosition(best) - position;
+	direction.y = 0.0f;
+	if (direction.LengthSquared() < 0.0001f) {
+		return false;
+	}
+	outDirection = direction.Normalised();
+	return true;
+}
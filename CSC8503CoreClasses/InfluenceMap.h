@@ -0,0 +1,90 @@
+#pragma once
+#include "NavigationGrid.h"
+
+namespace NCL {
+	class JobSystem;
+
+	namespace CSC8503 {
+		class GameObject;
+
+		/*
+		How strongly something is felt across the maze, one value per node.
+		Each source puts its strength into the node it's in, and every
+		update each open node takes the strongest of its neighbours, less
+		a bit for the distance - so influence spreads a node further each
+		update, around the hedges rather than through them. Once a source
+		has moved on, the influence it left behind fades away over time
+		rather than all at once.
+
+		Only the nodes with anything in them, and those right around them,
+		are worked on each update - nothing at all once it's faded away.
+		Agents can then tell how much of it there is where they are, or
+		which way it falls away, with a handful of lookups.
+		*/
+		class InfluenceMap {
+		public:
+			/*
+			falloff is how much is left after spreading one node across,
+			decayRate how much of the gap to what's being spread is closed
+			each second once it starts to fade. Anything below cutoff is
+			treated as nothing at all, which is what stops it spreading.
+			*/
+			InfluenceMap(NavigationGrid& grid, float falloff, float decayRate, float cutoff = 0.01f);
+			~InfluenceMap();
+
+			void AddSource(GameObject* object, float strength = 1.0f);
+			void RemoveSource(GameObject* object);
+
+			// Spreads the influence a node further, splitting the nodes across the jobs if there are any
+			void Update(float dt, JobSystem* jobs = nullptr);
+
+			// 0 off the grid or in a hedge
+			float GetValue(const Vector3& position) const;
+
+			/*
+			Unit direction to the neighbouring node with the least influence,
+			adding on the other map's as well (scaled by otherWeight) if
+			there is one. False if nowhere around is any better.
+			*/
+			bool GetLowestDirection(const Vector3& position, Vector3& outDirection,
+				const InfluenceMap* other = nullptr, float otherWeight = 0.0f) const;
+
+			int GetSourceCount() const {
+				return (int)sources.size();
+			}
+
+			// How many nodes were worked on in the last update
+			int GetUpdatedNodeCount() const {
+				return (int)updateNodes.size();
+			}
+
+		protected:
+			void UpdateNode(int node, float dt);
+
+			struct Source {
+				GameObject* object;
+				float		strength;
+			};
+
+			NavigationGrid& grid;
+			float falloff;
+			float diagonalFalloff;
+			float decayRate;
+			float cutoff;
+
+			std::vector<Source> sources;
+
+			// Agents read values, while the next update is worked out into nextValues
+			std::vector<float>	values;
+			std::vector<float>	nextValues;
+			std::vector<float>	stamps;			// What the sources put into each node this update
+			std::vector<int>	stampedNodes;
+
+			std::vector<int>	liveNodes;		// Everything with anything in it after the last update
+			std::vector<int>	updateNodes;	// What the last update worked on
+			// Nodes are only added to updateNodes once, by marking them with the update's generation
+			std::vector<unsigned int>	nodeGenerations;
+			unsigned int				generation;
+		};
+	}
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+
+namespace NCL {
+	namespace CSC8503 {
+		/*
+		Binary navigation files, made from the text ones by
+		NavigationGrid::SaveBinary and NavigationMesh::SaveBinary. Each is
+		a header followed by flat arrays, laid out exactly as they're used
+		in memory, so loading is a few bounds checks and copies straight
+		out of the mapped file with nothing to parse.
+
+		Everything is little endian, and every array starts 4 byte aligned.
+
+		Grid:	NavDataHeader, NavGridInfo, then width * height bytes of node
+				type, a row at a time
+		Mesh:	NavDataHeader, NavMeshInfo, then vertexCount * 3 floats,
+				triCount * 3 int32 vertex indices, and triCount * 3 int32
+				neighbouring triangles (-1 for none)
+		*/
+		const char		NAV_GRID_MAGIC[4]	= { 'N', 'A', 'V', 'G' };
+		const char		NAV_MESH_MAGIC[4]	= { 'N', 'A', 'V', 'M' };
+		const uint32_t	NAV_DATA_VERSION	= 1;
+
+		struct NavDataHeader {
+			char		magic[4];
+			uint32_t	version;
+		};
+
+		struct NavGridInfo {
+			int32_t nodeSize;
+			int32_t width;
+			int32_t height;
+		};
+
+		struct NavMeshInfo {
+			int32_t vertexCount;
+			int32_t triCount;
+		};
+
+		// True if the data starts with a header of the given type this code can read
+		inline bool IsNavData(const char* data, size_t size, const char magic[4]) {
+			if (!data || size < sizeof(NavDataHeader)) {
+				return false;
+			}
+			const NavDataHeader* header = (const NavDataHeader*)data;
+			return memcmp(header->magic, magic, 4) == 0 && header->version == NAV_DATA_VERSION;
+		}
+	}
+}
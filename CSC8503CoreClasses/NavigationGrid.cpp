@@ -1,7 +1,10 @@
 #include "NavigationGrid.h"
+#include "NavigationData.h"
 #include "Assets.h"
+#include "MappedFile.h"
 
 #include <fstream>
+#include <stdexcept>
 #include <CollisionDetection.h>
 
 using namespace NCL;
@@ -15,16 +18,35 @@ const int BOTTOM_NODE	= 3;
 const char WALL_NODE	= 'x';
 const char FLOOR_NODE	= '.';
 
+const float SQRT2		= 1.41421356f;
+
 NavigationGrid::NavigationGrid()	{
 	nodeSize	= 0;
 	gridWidth	= 0;
 	gridHeight	= 0;
+
+	searchMode		= GridSearchMode::JumpPoint;
+	allowDiagonals	= false;
+
+	version			= 0;
+	listenerCounter	= 0;
 }
 
 NavigationGrid::NavigationGrid(const std::string&filename, Vector3 zeroPos) : NavigationGrid() {
 
 
 	this->zeroPos = zeroPos;
+
+	MappedFile binary(Assets::DATADIR + filename);
+	if (IsNavData(binary.GetData(), binary.GetSize(), NAV_GRID_MAGIC)) {
+		// There's no text to fall back on, and an empty grid would only go wrong much later on
+		if (!LoadBinary(binary.GetData(), binary.GetSize())) {
+			throw std::runtime_error("NavigationGrid: " + filename + " is a damaged binary grid");
+		}
+		UpdateConnections();
+		return;
+	}
+	binary.Close();
 	std::ifstream infile(Assets::DATADIR + filename);
 
 	infile >> nodeSize;
@@ -45,34 +67,102 @@ NavigationGrid::NavigationGrid(const std::string&filename, Vector3 zeroPos) : Na
 	UpdateConnections();
 }
 
+NavigationGrid::NavigationGrid(const char* data, size_t size, Vector3 zeroPos) : NavigationGrid() {
+	this->zeroPos = zeroPos;
+
+	if (!IsNavData(data, size, NAV_GRID_MAGIC) || !LoadBinary(data, size)) {
+		throw std::runtime_error("NavigationGrid: damaged binary grid data");
+	}
+	UpdateConnections();
+}
+
+bool NavigationGrid::LoadBinary(const char* data, size_t size) {
+	const NavGridInfo* info = (const NavGridInfo*)(data + sizeof(NavDataHeader));
+	size_t nodesStart = sizeof(NavDataHeader) + sizeof(NavGridInfo);
+	if (size < nodesStart || info->nodeSize <= 0 || info->width < 0 || info->height < 0 ||
+		size < nodesStart + ((size_t)info->width * info->height)) {
+		return false; //cut short, or a node size everything would divide by zero with
+	}
+	nodeSize	= info->nodeSize;
+	gridWidth	= info->width;
+	gridHeight	= info->height;
+
+	const char* types = data + nodesStart;
+	allNodes.resize((size_t)gridWidth * gridHeight);
+	for (int z = 0; z < gridHeight; ++z) {
+		for (int x = 0; x < gridWidth; ++x) {
+			int nodePos = (gridWidth * z) + x;
+			allNodes[nodePos].type		= types[nodePos];
+			allNodes[nodePos].position	= zeroPos + Vector3((float)(x * nodeSize), 0, (float)(z * nodeSize));
+		}
+	}
+	return true;
+}
+
+bool NavigationGrid::SaveBinary(const std::string& filename) const {
+	std::ofstream outfile(Assets::DATADIR + filename, std::ios::binary);
+	if (!outfile) {
+		return false;
+	}
+	NavDataHeader header;
+	memcpy(header.magic, NAV_GRID_MAGIC, 4);
+	header.version = NAV_DATA_VERSION;
+
+	NavGridInfo info;
+	info.nodeSize	= nodeSize;
+	info.width		= gridWidth;
+	info.height		= gridHeight;
+
+	std::vector<char> types(allNodes.size());
+	for (size_t i = 0; i < allNodes.size(); ++i) {
+		types[i] = (char)allNodes[i].type;
+	}
+	outfile.write((const char*)&header, sizeof(header));
+	outfile.write((const char*)&info, sizeof(info));
+	outfile.write(types.data(), types.size());
+	return outfile.good();
+}
+
 void NavigationGrid::UpdateConnections() {
 	//now to build the connectivity between the nodes
 	for (int z = 0; z < gridHeight; ++z) {
 		for (int x = 0; x < gridWidth; ++x) {
-			GridNode& n = allNodes[(gridWidth * z) + x];
+			UpdateNodeConnections(x, z);
+		}
+	}
+}
 
-			if (z > 0) { //get the above node
-				n.connected[0] = &allNodes[(gridWidth * (z - 1)) + x];
-			}
-			if (z < gridHeight - 1) { //get the below node
-				n.connected[1] = &allNodes[(gridWidth * (z + 1)) + x];
-			}
-			if (x > 0) { //get left node
-				n.connected[2] = &allNodes[(gridWidth * (z)) + (x - 1)];
-			}
-			if (x < gridWidth - 1) { //get right node
-				n.connected[3] = &allNodes[(gridWidth * (z)) + (x + 1)];
+void NavigationGrid::UpdateNodeConnections(int x, int z) {
+	if (x < 0 || x > gridWidth - 1 ||
+		z < 0 || z > gridHeight - 1) {
+		return;
+	}
+	GridNode& n = allNodes[(gridWidth * z) + x];
+
+	for (int i = 0; i < 4; ++i) {
+		n.connected[i] = nullptr;
+		n.costs[i] = 0;
+	}
+	if (z > 0) { //get the above node
+		n.connected[0] = &allNodes[(gridWidth * (z - 1)) + x];
+	}
+	if (z < gridHeight - 1) { //get the below node
+		n.connected[1] = &allNodes[(gridWidth * (z + 1)) + x];
+	}
+	if (x > 0) { //get left node
+		n.connected[2] = &allNodes[(gridWidth * (z)) + (x - 1)];
+	}
+	if (x < gridWidth - 1) { //get right node
+		n.connected[3] = &allNodes[(gridWidth * (z)) + (x + 1)];
+	}
+	for (int i = 0; i < 4; ++i) {
+		if (n.connected[i]) {
+			if (n.connected[i]->type == '.') {
+				n.costs[i] = 1;
 			}
-			for (int i = 0; i < 4; ++i) {
-				if (n.connected[i]) {
-					if (n.connected[i]->type == '.') {
-						n.costs[i] = 1;
-					}
-					if (n.connected[i]->type == 'x') {
-						n.connected[i] = nullptr; //actually a wall, disconnect!
-						n.costs[i] = 0;
-					}
-				}
+			if (n.connected[i]->type == 'x') {
+				n.connected[i] = nullptr; //actually a wall, disconnect!
+				n.costs[i] = 0;
 			}
 		}
 	}
@@ -89,9 +179,47 @@ void NavigationGrid::RemoveNode(Vector3 position) {
 	}
 
 	GridNode& node = allNodes[(gridZ * gridWidth) + gridX];
+	if (node.type == '.') {
+		return; //nothing to change
+	}
 
 	node.type = '.';
-	UpdateConnections();
+
+	//Only this node and the ones next to it can have had their connections changed
+	UpdateNodeConnections(gridX, gridZ);
+	UpdateNodeConnections(gridX, gridZ - 1);
+	UpdateNodeConnections(gridX, gridZ + 1);
+	UpdateNodeConnections(gridX - 1, gridZ);
+	UpdateNodeConnections(gridX + 1, gridZ);
+
+	NodeChanged(gridX, gridZ);
+}
+
+void NavigationGrid::NodeChanged(int x, int z) {
+	version++;
+	for (auto& listener : changeListeners) {
+		listener.second(x, z);
+	}
+}
+
+int NavigationGrid::AddChangeListener(const GridChangeFunc& func) {
+	int id = ++listenerCounter;
+	changeListeners.emplace_back(id, func);
+	return id;
+}
+
+void NavigationGrid::RemoveChangeListener(int id) {
+	std::erase_if(changeListeners, [id](const std::pair<int, GridChangeFunc>& l) {
+		return l.first == id;
+	});
+}
+
+bool NavigationGrid::WorldToGrid(const Vector3& position, int& x, int& z) const {
+	Vector3 gridPos = position - zeroPos + Vector3(nodeSize / 2, 0, nodeSize / 2);
+	x = ((int)gridPos.x / nodeSize);
+	z = ((int)gridPos.z / nodeSize);
+
+	return x >= 0 && x < gridWidth && z >= 0 && z < gridHeight;
 }
 
 bool NavigationGrid::FullyWithinOpenNodes(Vector3 position, Vector3 halfSize) {
@@ -134,103 +262,359 @@ void NavigationGrid::Print() {
 }
 
 bool NavigationGrid::FindPath(const Vector3& from, const Vector3& to, NavigationPath& outPath) {
-	//need to work out which node 'from' sits in, and 'to' sits in
-	Vector3 gridFrom = from - zeroPos + Vector3(nodeSize/2, 0, nodeSize/2);
-	Vector3 gridTo = to - zeroPos + Vector3(nodeSize / 2, 0, nodeSize / 2);
-	int fromX = ((int)gridFrom.x / nodeSize);
-	int fromZ = ((int)gridFrom.z / nodeSize);
-
-	int toX = ((int)gridTo.x / nodeSize);
-	int toZ = ((int)gridTo.z / nodeSize);
-
-	if (fromX < 0 || fromX > gridWidth - 1 ||
-		fromZ < 0 || fromZ > gridHeight - 1) {
-		return false; //outside of map region!
-	}
+	thread_local GridSearch search;
+	return FindPath(from, to, outPath, search);
+}
 
-	if (toX < 0 || toX > gridWidth - 1 ||
-		toZ < 0 || toZ > gridHeight - 1) {
+bool NavigationGrid::FindPath(const Vector3& from, const Vector3& to, NavigationPath& outPath, GridSearch& search) const {
+	//need to work out which node 'from' sits in, and 'to' sits in
+	int fromX, fromZ, toX, toZ;
+	if (!WorldToGrid(from, fromX, fromZ) || !WorldToGrid(to, toX, toZ)) {
 		return false; //outside of map region!
 	}
 
-	GridNode* startNode = &allNodes[(fromZ * gridWidth) + fromX];
-	GridNode* endNode	= &allNodes[(toZ * gridWidth) + toX];
+	int startNode	= (fromZ * gridWidth) + fromX;
+	int endNode		= (toZ * gridWidth) + toX;
 
-	std::vector<GridNode*>  openList;
-	std::vector<GridNode*>  closedList;
+	bool found = searchMode == GridSearchMode::JumpPoint ?
+		JumpPointSearch(startNode, endNode, search) :
+		AStarSearch(startNode, endNode, search);
 
-	openList.push_back(startNode);
+	if (!found) {
+		return false; //open list emptied out with no path!
+	}
+	/*
+	Jump point parents can be several nodes away in a straight or diagonal
+	line, so step back along that line to give every node on the way. A*
+	parents are always next door, so the inner loop never runs for those.
+	*/
+	int node = endNode;
+	while (node != -1) {
+		int parent = search.GetParent(node);
+		int x = node % gridWidth;
+		int z = node / gridWidth;
+		outPath.PushWaypoint(allNodes[node].position);
+		if (parent != -1) {
+			int px = parent % gridWidth;
+			int pz = parent / gridWidth;
+			int dx = (px > x) - (px < x);
+			int dz = (pz > z) - (pz < z);
+			for (x += dx, z += dz; x != px || z != pz; x += dx, z += dz) {
+				outPath.PushWaypoint(allNodes[(z * gridWidth) + x].position);
+			}
+		}
+		node = parent;
+	}
+	return true;
+}
 
-	startNode->f = 0;
-	startNode->g = 0;
-	startNode->parent = nullptr;
+bool NavigationGrid::AStarSearch(int startNode, int endNode, GridSearch& search) const {
+	const GridNode* nodes = allNodes.data();
 
-	GridNode* currentBestNode = nullptr;
+	search.Begin(allNodes.size());
+	search.Open(startNode, 0.0f, Heuristic(startNode, endNode), -1);
 
-	while (!openList.empty()) {
-		currentBestNode = RemoveBestNode(openList);
+	while (search.HasOpen()) {
+		int currentBestNode = search.PopBest();
 
 		if (currentBestNode == endNode) {			//we've found the path!
-			GridNode* node = endNode;
-			while (node != nullptr) {
-				outPath.PushWaypoint(node->position);
-				node = node->parent;
-			}
 			return true;
 		}
-		else {
-			for (int i = 0; i < 4; ++i) {
-				GridNode* neighbour = currentBestNode->connected[i];
-				if (!neighbour) { //might not be connected...
+		search.Close(currentBestNode);
+
+		const GridNode& current = nodes[currentBestNode];
+		for (int i = 0; i < 4; ++i) {
+			if (!current.connected[i]) { //might not be connected...
+				continue;
+			}
+			int neighbour = (int)(current.connected[i] - nodes);
+			if (search.IsClosed(neighbour)) {
+				continue; //already discarded this neighbour...
+			}
+			float g = search.GetG(currentBestNode) + current.costs[i];
+
+			if (!search.IsSeen(neighbour) || g < search.GetG(neighbour)) { //might be a better route to this neighbour
+				search.Open(neighbour, g, g + Heuristic(neighbour, endNode), currentBestNode);
+			}
+		}
+		if (!allowDiagonals) {
+			continue;
+		}
+		int x = currentBestNode % gridWidth;
+		int z = currentBestNode / gridWidth;
+		for (int dz = -1; dz <= 1; dz += 2) {
+			for (int dx = -1; dx <= 1; dx += 2) {
+				if (!IsOpen(x + dx, z + dz) || !IsOpen(x + dx, z) || !IsOpen(x, z + dz)) {
+					continue; //no cutting across wall corners
+				}
+				int neighbour = ((z + dz) * gridWidth) + x + dx;
+				if (search.IsClosed(neighbour)) {
 					continue;
-				}	
-				bool inClosed	= NodeInList(neighbour, closedList);
-				if (inClosed) {
-					continue; //already discarded this neighbour...
 				}
+				float g = search.GetG(currentBestNode) + SQRT2;
+				if (!search.IsSeen(neighbour) || g < search.GetG(neighbour)) {
+					search.Open(neighbour, g, g + Heuristic(neighbour, endNode), currentBestNode);
+				}
+			}
+		}
+	}
+	return false;
+}
 
-				float h = Heuristic(neighbour, endNode);				
-				float g = currentBestNode->g + currentBestNode->costs[i];
-				float f = h + g;
-
-				bool inOpen		= NodeInList(neighbour, openList);
+/*
+Jump Point Search (Harabor & Grastien) - on a grid where every step
+costs the same, most nodes along a straight run can't be on any better
+path than the straight line through them, so rather than put each one
+on the open list, we 'jump' along the line until reaching the goal or a
+node where the path might need to turn. Only those nodes are expanded.
+
+Without diagonals, horizontal jumps stop where a vertical turn is
+forced, and vertical jumps look sideways at each step and stop if a
+horizontal jump from there would find something.
+*/
+bool NavigationGrid::JumpPointSearch(int startNode, int endNode, GridSearch& search) const {
+	search.Begin(allNodes.size());
+	search.Open(startNode, 0.0f, Heuristic(startNode, endNode), -1);
+
+	while (search.HasOpen()) {
+		int current = search.PopBest();
+		if (current == endNode) {
+			return true;
+		}
+		search.Close(current);
+
+		int x = current % gridWidth;
+		int z = current / gridWidth;
+
+		int dx = 0;
+		int dz = 0;
+		int parent = search.GetParent(current);
+		if (parent != -1) {
+			int px = parent % gridWidth;
+			int pz = parent / gridWidth;
+			dx = (x > px) - (x < px);
+			dz = (z > pz) - (z < pz);
+		}
 
-				if (!inOpen) { //first time we've seen this neighbour
-					openList.emplace_back(neighbour);
-				}
-				if (!inOpen || f < neighbour->f) {//might be a better route to this neighbour
-					neighbour->parent = currentBestNode;
-					neighbour->f = f;
-					neighbour->g = g;
+		// Work out which directions can't be pruned, given the way we came in
+		int dirs[8][2];
+		int dirCount = 0;
+		auto add = [&](int ndx, int ndz) {
+			dirs[dirCount][0] = ndx;
+			dirs[dirCount][1] = ndz;
+			dirCount++;
+		};
+		if (dx == 0 && dz == 0) { // Start node, nothing can be pruned
+			for (int nz = -1; nz <= 1; ++nz) {
+				for (int nx = -1; nx <= 1; ++nx) {
+					if ((nx == 0 && nz == 0) || (!allowDiagonals && nx != 0 && nz != 0)) {
+						continue;
+					}
+					add(nx, nz);
 				}
 			}
-			closedList.emplace_back(currentBestNode);
+		}
+		else if (!allowDiagonals) {
+			if (dz == 0) {
+				add(dx, 0);
+				if (IsOpen(x, z + 1) && !IsOpen(x - dx, z + 1)) add(0, 1);
+				if (IsOpen(x, z - 1) && !IsOpen(x - dx, z - 1)) add(0, -1);
+			}
+			else {
+				add(0, dz);
+				add(1, 0);
+				add(-1, 0);
+			}
+		}
+		else if (dx != 0 && dz != 0) {
+			add(dx, 0);
+			add(0, dz);
+			add(dx, dz);
+		}
+		else if (dz == 0) {
+			add(dx, 0);
+			add(dx, 1);
+			add(dx, -1);
+			add(0, 1);
+			add(0, -1);
+		}
+		else {
+			add(0, dz);
+			add(1, dz);
+			add(-1, dz);
+			add(1, 0);
+			add(-1, 0);
+		}
+
+		for (int i = 0; i < dirCount; ++i) {
+			int jumpPoint = Jump(x, z, dirs[i][0], dirs[i][1], endNode);
+			if (jumpPoint == -1 || search.IsClosed(jumpPoint)) {
+				continue;
+			}
+			float g = search.GetG(current) + Distance(current, jumpPoint);
+			if (!search.IsSeen(jumpPoint) || g < search.GetG(jumpPoint)) {
+				search.Open(jumpPoint, g, g + Heuristic(jumpPoint, endNode), current);
+			}
+		}
+	}
+	return false;
+}
+
+// Steps from (x, z) in the given direction, returning the next jump point found, or -1
+int NavigationGrid::Jump(int x, int z, int dx, int dz, int endNode) const {
+	if (dx == 0 || dz == 0) {
+		return JumpStraight(x, z, dx, dz, endNode);
+	}
+	while (true) {
+		if (!IsOpen(x + dx, z) || !IsOpen(x, z + dz)) {
+			return -1; //no cutting across wall corners
+		}
+		x += dx;
+		z += dz;
+		if (!IsOpen(x, z)) {
+			return -1;
+		}
+		int node = (z * gridWidth) + x;
+		if (node == endNode) {
+			return node;
+		}
+		if (JumpStraight(x, z, dx, 0, endNode) != -1 || JumpStraight(x, z, 0, dz, endNode) != -1) {
+			return node;
+		}
+	}
+}
+
+int NavigationGrid::JumpStraight(int x, int z, int dx, int dz, int endNode) const {
+	while (true) {
+		x += dx;
+		z += dz;
+		if (!IsOpen(x, z)) {
+			return -1;
+		}
+		int node = (z * gridWidth) + x;
+		if (node == endNode) {
+			return node;
+		}
+		if (dz == 0) {
+			// A node above or below that couldn't be reached from the one behind forces a turn
+			if ((IsOpen(x, z + 1) && !IsOpen(x - dx, z + 1)) ||
+				(IsOpen(x, z - 1) && !IsOpen(x - dx, z - 1))) {
+				return node;
+			}
+		}
+		else if (allowDiagonals) {
+			if ((IsOpen(x + 1, z) && !IsOpen(x + 1, z - dz)) ||
+				(IsOpen(x - 1, z) && !IsOpen(x - 1, z - dz))) {
+				return node;
+			}
+		}
+		else if (JumpStraight(x, z, 1, 0, endNode) != -1 || JumpStraight(x, z, -1, 0, endNode) != -1) {
+			return node;
 		}
 	}
-	return false; //open list emptied out with no path!
 }
 
-bool NavigationGrid::NodeInList(GridNode* n, std::vector<GridNode*>& list) const {
-	std::vector<GridNode*>::iterator i = std::find(list.begin(), list.end(), n);
-	return i == list.end() ? false : true;
+// Exact cost of a straight or diagonal run between two nodes
+float NavigationGrid::Distance(int node, int endNode) const {
+	int dx = std::abs((node % gridWidth) - (endNode % gridWidth));
+	int dz = std::abs((node / gridWidth) - (endNode / gridWidth));
+	if (!allowDiagonals) {
+		return (float)(dx + dz);
+	}
+	int diagonal = std::min(dx, dz);
+	return (diagonal * SQRT2) + (float)(std::max(dx, dz) - diagonal);
 }
 
-GridNode*  NavigationGrid::RemoveBestNode(std::vector<GridNode*>& list) const {
-	std::vector<GridNode*>::iterator bestI = list.begin();
+/*
+Manhattan distance in nodes, or octile distance if diagonals are
+allowed. Neither ever overestimates, which A* needs to be able to
+trust the closed set.
+*/
+float NavigationGrid::Heuristic(int node, int endNode) const {
+	return Distance(node, endNode);
+}
 
-	GridNode* bestNode = *list.begin();
+void GridSearch::Begin(size_t nodeCount) {
+	if (seenGeneration.size() != nodeCount) {
+		seenGeneration.assign(nodeCount, 0);
+		closedGeneration.assign(nodeCount, 0);
+		g.resize(nodeCount);
+		f.resize(nodeCount);
+		parent.resize(nodeCount);
+		heapIndex.resize(nodeCount);
+		generation = 0;
+	}
+	generation++;
+	expanded = 0;
+	if (generation == 0) { // Wrapped around, old stamps could look current again
+		std::fill(seenGeneration.begin(), seenGeneration.end(), 0);
+		std::fill(closedGeneration.begin(), closedGeneration.end(), 0);
+		generation = 1;
+	}
+	heap.clear();
+}
 
-	for (auto i = list.begin(); i != list.end(); ++i) {
-		if ((*i)->f < bestNode->f) {
-			bestNode	= (*i);
-			bestI		= i;
+void GridSearch::Open(int node, float nodeG, float nodeF, int nodeParent) {
+	bool inHeap = IsSeen(node);
+	seenGeneration[node] = generation;
+	g[node]			= nodeG;
+	f[node]			= nodeF;
+	parent[node]	= nodeParent;
+
+	if (inHeap) {
+		SiftUp(heapIndex[node]); // f only ever goes down
+	}
+	else {
+		heapIndex[node] = (int)heap.size();
+		heap.push_back(node);
+		SiftUp(heapIndex[node]);
+	}
+}
+
+int GridSearch::PopBest() {
+	expanded++;
+	int best = heap[0];
+	Swap(0, (int)heap.size() - 1);
+	heap.pop_back();
+	if (!heap.empty()) {
+		SiftDown(0);
+	}
+	return best;
+}
+
+void GridSearch::SiftUp(int heapPos) {
+	while (heapPos > 0) {
+		int parentPos = (heapPos - 1) / 2;
+		if (f[heap[parentPos]] <= f[heap[heapPos]]) {
+			return;
 		}
+		Swap(heapPos, parentPos);
+		heapPos = parentPos;
 	}
-	list.erase(bestI);
+}
 
-	return bestNode;
+void GridSearch::SiftDown(int heapPos) {
+	int count = (int)heap.size();
+	while (true) {
+		int left	= (heapPos * 2) + 1;
+		int right	= left + 1;
+		int best	= heapPos;
+		if (left < count && f[heap[left]] < f[heap[best]]) {
+			best = left;
+		}
+		if (right < count && f[heap[right]] < f[heap[best]]) {
+			best = right;
+		}
+		if (best == heapPos) {
+			return;
+		}
+		Swap(heapPos, best);
+		heapPos = best;
+	}
 }
 
-float NavigationGrid::Heuristic(GridNode* hNode, GridNode* endNode) const {
-	return (hNode->position - endNode->position).Length();
-}
\ No newline at end of file
+void GridSearch::Swap(int a, int b) {
+	std::swap(heap[a], heap[b]);
+	heapIndex[heap[a]] = a;
+	heapIndex[heap[b]] = b;
+}
@@ -1,19 +1,16 @@
 #pragma once
 #include "NavigationMap.h"
+#include <functional>
+#include <span>
 #include <string>
 namespace NCL {
 	namespace CSC8503 {
 		struct GridNode {
-			GridNode* parent;
-
 			GridNode* connected[4];
 			int		  costs[4];
 
 			Vector3		position;
 
-			float f;
-			float g;
-
 			int type;
 
 			GridNode() {
@@ -21,45 +18,158 @@ namespace NCL {
 					connected[i] = nullptr;
 					costs[i] = 0;
 				}
-				f = 0;
-				g = 0;
 				type = 0;
-				parent = nullptr;
 			}
 			~GridNode() {	}
 		};
 
+		/*
+		Everything a single A* search writes lives in here rather than in
+		the nodes, so any number of searches can run over the same grid at
+		once as long as each has its own GridSearch.
+
+		Rather than clearing every array before each search, entries are
+		stamped with the search's generation, and anything with an old
+		stamp is treated as unvisited.
+		*/
+		class GridSearch {
+		public:
+			GridSearch() : generation(0), expanded(0) {}
+
+			// Gets ready for a new search over a grid of nodeCount nodes
+			void Begin(size_t nodeCount);
+
+			// How many nodes the last search took off the open set
+			int GetExpandedCount() const { return expanded; }
+
+			bool IsSeen(int node) const		{ return seenGeneration[node] == generation; }
+			bool IsClosed(int node) const	{ return closedGeneration[node] == generation; }
+			void Close(int node)			{ closedGeneration[node] = generation; }
+
+			float	GetG(int node) const		{ return g[node]; }
+			int		GetParent(int node) const	{ return parent[node]; }
+
+			// Adds the node to the open set, or lowers its f if it's already there
+			void Open(int node, float nodeG, float nodeF, int nodeParent);
+			bool HasOpen() const { return !heap.empty(); }
+			int  PopBest();
+
+		protected:
+			void SiftUp(int heapPos);
+			void SiftDown(int heapPos);
+			void Swap(int a, int b);
+
+			unsigned int generation;
+			int expanded;
+
+			std::vector<unsigned int>	seenGeneration;
+			std::vector<unsigned int>	closedGeneration;
+			std::vector<float>			g;
+			std::vector<float>			f;
+			std::vector<int>			parent;
+			std::vector<int>			heapIndex;
+
+			std::vector<int>			heap; // Node indices, min-heap on f
+		};
+
+		enum class GridSearchMode {
+			AStar,
+			JumpPoint	// Only valid while every open node costs the same, as in the maze files
+		};
+
+		// Called with the grid coordinates of a node whose type has changed
+		typedef std::function<void(int x, int z)> GridChangeFunc;
+
 		class NavigationGrid : public NavigationMap	{
 		public:
 			NavigationGrid();
+			// Throws std::runtime_error if the file is a damaged binary grid
 			NavigationGrid(const std::string&filename, Vector3 zeroPos = Vector3(0, 0, 0));
+			// Builds a grid from binary grid data already in memory, laid out as SaveBinary writes it. Throws if it's damaged
+			NavigationGrid(const char* data, size_t size, Vector3 zeroPos = Vector3(0, 0, 0));
 			~NavigationGrid() {}
 
+			// Uses a scratch search owned by the calling thread
 			bool FindPath(const Vector3& from, const Vector3& to, NavigationPath& outPath) override;
+			bool FindPath(const Vector3& from, const Vector3& to, NavigationPath& outPath, GridSearch& search) const;
+
+			void SetSearchMode(GridSearchMode mode) {
+				searchMode = mode;
+			}
+
+			GridSearchMode GetSearchMode() const {
+				return searchMode;
+			}
+
+			// Lets paths move diagonally between nodes, as long as they don't clip a wall corner
+			void AllowDiagonals(bool state) {
+				allowDiagonals = state;
+			}
+
+			bool AllowsDiagonals() const {
+				return allowDiagonals;
+			}
 
 			Vector3 GetZeroPos() const { return zeroPos; }
 			int GetNodeSize() const { return nodeSize; }
 			int GetWidth() const { return gridWidth; }
 			int GetHeight() const { return gridHeight; }
-			std::vector<GridNode> GetNodes() const { return allNodes; }
+			Vector3 GetNodePosition(int node) const { return allNodes[node].position; }
+			// A view straight onto the grid's own nodes, rather than a copy of them
+			std::span<const GridNode> GetNodes() const { return allNodes; }
 			void RemoveNode(Vector3 position);
 
+			// Works out which node a world position sits in, false if it's off the grid
+			bool WorldToGrid(const Vector3& position, int& x, int& z) const;
+
+			bool IsOpen(int x, int z) const {
+				return x >= 0 && x < gridWidth && z >= 0 && z < gridHeight &&
+					allNodes[(z * gridWidth) + x].type != 'x';
+			}
+
+			// Bumped whenever a node changes, so cached paths can tell they might be stale
+			unsigned int GetVersion() const {
+				return version;
+			}
+
+			int AddChangeListener(const GridChangeFunc& func);
+			void RemoveChangeListener(int id);
+
 			bool FullyWithinOpenNodes(Vector3 position, Vector3 halfSize);
 
+			// Writes the grid out in the binary format from NavigationData.h, into the data folder
+			bool SaveBinary(const std::string& filename) const;
+
 			void Print();
 				
 		protected:
-			bool		NodeInList(GridNode* n, std::vector<GridNode*>& list) const;
-			GridNode*	RemoveBestNode(std::vector<GridNode*>& list) const;
-			float		Heuristic(GridNode* hNode, GridNode* endNode) const;
+			bool		LoadBinary(const char* data, size_t size);
+
+			bool		AStarSearch(int startNode, int endNode, GridSearch& search) const;
+			bool		JumpPointSearch(int startNode, int endNode, GridSearch& search) const;
+			int			Jump(int x, int z, int dx, int dz, int endNode) const;
+			int			JumpStraight(int x, int z, int dx, int dz, int endNode) const;
+
+			void		NodeChanged(int x, int z);
+
+			float		Distance(int node, int endNode) const;
+			float		Heuristic(int node, int endNode) const;
 
 			void UpdateConnections();
+			void UpdateNodeConnections(int x, int z);
 			Vector3 zeroPos;
 			int nodeSize;
 			int gridWidth;
 			int gridHeight;
 
 			std::vector<GridNode> allNodes;
+
+			GridSearchMode	searchMode;
+			bool			allowDiagonals;
+
+			unsigned int	version;
+			int				listenerCounter;
+			std::vector<std::pair<int, GridChangeFunc>> changeListeners;
 		};
 	}
 }
@@ -1,7 +1,13 @@
 #include "NavigationMesh.h"
+#include "NavigationGrid.h"
+#include "NavigationData.h"
 #include "Assets.h"
+#include "MappedFile.h"
 #include "Maths.h"
 #include <fstream>
+#include <algorithm>
+#include <cfloat>
+#include <stdexcept>
 using namespace NCL;
 using namespace CSC8503;
 using namespace std;
@@ -12,7 +18,23 @@ NavigationMesh::NavigationMesh()
 
 NavigationMesh::NavigationMesh(const std::string&filename)
 {
-	ifstream file(Assets::DATADIR + filename);
+	MappedFile binary(Assets::DATADIR + filename);
+	if (IsNavData(binary.GetData(), binary.GetSize(), NAV_MESH_MAGIC)) {
+		// Same as a grid, an empty mesh would only go wrong much later on
+		if (!LoadBinary(binary.GetData(), binary.GetSize())) {
+			throw std::runtime_error("NavigationMesh: " + filename + " is a damaged binary mesh");
+		}
+	}
+	else {
+		binary.Close();
+		LoadText(Assets::DATADIR + filename);
+	}
+	BuildPortals();
+	BuildSpatialIndex();
+}
+
+void NavigationMesh::LoadText(const std::string& filepath) {
+	ifstream file(filepath);
 
 	int numVertices = 0;
 	int numIndices	= 0;
@@ -37,17 +59,7 @@ NavigationMesh::NavigationMesh(const std::string&filename)
 		file >> tri->indices[1];
 		file >> tri->indices[2];
 
-		tri->centroid = allVerts[tri->indices[0]] +
-			allVerts[tri->indices[1]] +
-			allVerts[tri->indices[2]];
-
-		tri->centroid = allTris[i].centroid / 3.0f;
-
-		tri->triPlane = Plane::PlaneFromTri(allVerts[tri->indices[0]],
-			allVerts[tri->indices[1]],
-			allVerts[tri->indices[2]]);
-
-		tri->area = Maths::CrossAreaOfTri(allVerts[tri->indices[0]], allVerts[tri->indices[1]], allVerts[tri->indices[2]]);
+		SetupTri(*tri);
 	}
 	for (int i = 0; i < allTris.size(); ++i) {
 		NavTri* tri = &allTris[i];
@@ -61,36 +73,419 @@ NavigationMesh::NavigationMesh(const std::string&filename)
 	}
 }
 
+/*
+The arrays in the file are already laid out the way they're held here,
+so the vertices are a straight copy. Indices are still checked, as a
+bad file shouldn't be able to send anything off the end of the arrays.
+*/
+bool NavigationMesh::LoadBinary(const char* data, size_t size) {
+	static_assert(sizeof(Vector3) == sizeof(float) * 3, "vertices are copied straight into Vector3s");
+
+	const NavMeshInfo* info = (const NavMeshInfo*)(data + sizeof(NavDataHeader));
+	size_t vertsStart = sizeof(NavDataHeader) + sizeof(NavMeshInfo);
+	if (size < vertsStart || info->vertexCount < 0 || info->triCount < 0) {
+		return false;
+	}
+	size_t vertBytes	= (size_t)info->vertexCount * sizeof(Vector3);
+	size_t triBytes		= (size_t)info->triCount * 3 * sizeof(int32_t);
+	if (size < vertsStart + vertBytes + (triBytes * 2)) {
+		return false; //cut short
+	}
+	const int32_t* indices		= (const int32_t*)(data + vertsStart + vertBytes);
+	const int32_t* neighbours	= (const int32_t*)(data + vertsStart + vertBytes + triBytes);
+
+	allVerts.resize(info->vertexCount);
+	memcpy(allVerts.data(), data + vertsStart, vertBytes);
+
+	allTris.resize(info->triCount);
+	for (int i = 0; i < info->triCount * 3; ++i) {
+		if (indices[i] < 0 || indices[i] >= info->vertexCount || neighbours[i] < -1 || neighbours[i] >= info->triCount) {
+			allVerts.clear();
+			allTris.clear();
+			return false;
+		}
+	}
+	for (int i = 0; i < info->triCount; ++i) {
+		NavTri* tri = &allTris[i];
+		for (int j = 0; j < 3; ++j) {
+			tri->indices[j] = indices[(i * 3) + j];
+			if (neighbours[(i * 3) + j] != -1) {
+				tri->neighbours[j] = &allTris[neighbours[(i * 3) + j]];
+			}
+		}
+		SetupTri(*tri);
+	}
+	return true;
+}
+
+bool NavigationMesh::SaveBinary(const std::string& filename) const {
+	ofstream outfile(Assets::DATADIR + filename, std::ios::binary);
+	if (!outfile) {
+		return false;
+	}
+	NavDataHeader header;
+	memcpy(header.magic, NAV_MESH_MAGIC, 4);
+	header.version = NAV_DATA_VERSION;
+
+	NavMeshInfo info;
+	info.vertexCount	= (int32_t)allVerts.size();
+	info.triCount		= (int32_t)allTris.size();
+
+	std::vector<int32_t> indices;
+	std::vector<int32_t> neighbours;
+	for (const NavTri& t : allTris) {
+		for (int j = 0; j < 3; ++j) {
+			indices.push_back(t.indices[j]);
+			neighbours.push_back(t.neighbours[j] ? (int32_t)(t.neighbours[j] - allTris.data()) : -1);
+		}
+	}
+	outfile.write((const char*)&header, sizeof(header));
+	outfile.write((const char*)&info, sizeof(info));
+	outfile.write((const char*)allVerts.data(), allVerts.size() * sizeof(Vector3));
+	outfile.write((const char*)indices.data(), indices.size() * sizeof(int32_t));
+	outfile.write((const char*)neighbours.data(), neighbours.size() * sizeof(int32_t));
+	return outfile.good();
+}
+
+void NavigationMesh::SetupTri(NavTri& tri) {
+	tri.centroid = allVerts[tri.indices[0]] +
+		allVerts[tri.indices[1]] +
+		allVerts[tri.indices[2]];
+
+	tri.centroid = tri.centroid / 3.0f;
+
+	tri.triPlane = Plane::PlaneFromTri(allVerts[tri.indices[0]],
+		allVerts[tri.indices[1]],
+		allVerts[tri.indices[2]]);
+
+	tri.area = Maths::CrossAreaOfTri(allVerts[tri.indices[0]], allVerts[tri.indices[1]], allVerts[tri.indices[2]]);
+}
+
 NavigationMesh::~NavigationMesh()
 {
 }
 
+/*
+The file gives each triangle's neighbours, but not which of its edges
+they're across. Vertices are duplicated between triangles, so the
+shared edge is found by matching positions rather than indices.
+*/
+void NavigationMesh::BuildPortals() {
+	const float sameVertex = 0.001f * 0.001f;
+
+	for (NavTri& t : allTris) {
+		for (int j = 0; j < 3; ++j) {
+			if (!t.neighbours[j]) {
+				continue;
+			}
+			int found = 0;
+			for (int a = 0; a < 3 && found < 2; ++a) {
+				for (int b = 0; b < 3; ++b) {
+					Vector3 diff = allVerts[t.indices[a]] - allVerts[t.neighbours[j]->indices[b]];
+					if (diff.LengthSquared() < sameVertex) {
+						t.portals[j][found++] = t.indices[a];
+						break;
+					}
+				}
+			}
+			if (found < 2) { //they don't really share an edge, so there's no way across
+				t.neighbours[j]		= nullptr;
+				t.portals[j][0]		= -1;
+				t.portals[j][1]		= -1;
+			}
+		}
+	}
+}
+
+void NavigationMesh::BuildSpatialIndex() {
+	cellsX = 0;
+	cellsZ = 0;
+	cellStarts.clear();
+	cellTris.clear();
+	if (allTris.empty()) {
+		return;
+	}
+	Vector3 minPos(FLT_MAX, FLT_MAX, FLT_MAX);
+	Vector3 maxPos(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	for (const Vector3& v : allVerts) {
+		minPos = Vector3(std::min(minPos.x, v.x), std::min(minPos.y, v.y), std::min(minPos.z, v.z));
+		maxPos = Vector3(std::max(maxPos.x, v.x), std::max(maxPos.y, v.y), std::max(maxPos.z, v.z));
+	}
+	/*
+	Roughly one triangle per cell - most lookups then only have to test
+	a handful of triangles, without the index getting much bigger than
+	the mesh itself.
+	*/
+	float areaXZ	= std::max((maxPos.x - minPos.x) * (maxPos.z - minPos.z), 1.0f);
+	cellSize		= std::max(sqrt(areaXZ / allTris.size()), 0.01f);
+	cellOrigin		= minPos;
+	cellsX			= (int)((maxPos.x - minPos.x) / cellSize) + 1;
+	cellsZ			= (int)((maxPos.z - minPos.z) / cellSize) + 1;
+
+	auto triCells = [&](const NavTri& t, int& x0, int& z0, int& x1, int& z1) {
+		Vector3 a = allVerts[t.indices[0]];
+		Vector3 b = allVerts[t.indices[1]];
+		Vector3 c = allVerts[t.indices[2]];
+		x0 = (int)((std::min({ a.x, b.x, c.x }) - cellOrigin.x) / cellSize);
+		z0 = (int)((std::min({ a.z, b.z, c.z }) - cellOrigin.z) / cellSize);
+		x1 = (int)((std::max({ a.x, b.x, c.x }) - cellOrigin.x) / cellSize);
+		z1 = (int)((std::max({ a.z, b.z, c.z }) - cellOrigin.z) / cellSize);
+	};
+	//Count up each cell's triangles first, so they can all go in one array
+	cellStarts.assign((size_t)cellsX * cellsZ + 1, 0);
+	for (const NavTri& t : allTris) {
+		int x0, z0, x1, z1;
+		triCells(t, x0, z0, x1, z1);
+		for (int z = z0; z <= z1; ++z) {
+			for (int x = x0; x <= x1; ++x) {
+				cellStarts[(z * cellsX) + x + 1]++;
+			}
+		}
+	}
+	for (size_t i = 1; i < cellStarts.size(); ++i) {
+		cellStarts[i] += cellStarts[i - 1];
+	}
+	cellTris.resize(cellStarts.back());
+	std::vector<int> filled(cellStarts.begin(), cellStarts.end() - 1);
+	for (int i = 0; i < (int)allTris.size(); ++i) {
+		int x0, z0, x1, z1;
+		triCells(allTris[i], x0, z0, x1, z1);
+		for (int z = z0; z <= z1; ++z) {
+			for (int x = x0; x <= x1; ++x) {
+				cellTris[filled[(z * cellsX) + x]++] = i;
+			}
+		}
+	}
+}
+
 bool NavigationMesh::FindPath(const Vector3& from, const Vector3& to, NavigationPath& outPath) {
-	const NavTri* start	= GetTriForPosition(from);
-	const NavTri* end	= GetTriForPosition(to);
+	thread_local GridSearch search;
+	return FindPath(from, to, outPath, search);
+}
+
+bool NavigationMesh::FindPath(const Vector3& from, const Vector3& to, NavigationPath& outPath, GridSearch& search) const {
+	int startTri	= GetTriIndexForPosition(from);
+	int endTri		= GetTriIndexForPosition(to);
+	if (startTri == -1 || endTri == -1) {
+		return false; //off the mesh!
+	}
+	if (!TriSearch(startTri, endTri, search)) {
+		return false;
+	}
+	thread_local std::vector<int> corridor;
+	corridor.clear();
+	for (int tri = endTri; tri != -1; tri = search.GetParent(tri)) {
+		corridor.push_back(tri);
+	}
+	std::reverse(corridor.begin(), corridor.end());
+
+	StringPull(corridor, from, to, outPath);
+	return true;
+}
 
+/*
+A* over the triangles, using the distance between centroids as the cost
+of crossing from one to the next. The triangle indices are the search's
+nodes, so the grid's search state works just as well here.
+*/
+bool NavigationMesh::TriSearch(int startTri, int endTri, GridSearch& search) const {
+	const NavTri* tris = allTris.data();
+	Vector3 endPos = tris[endTri].centroid;
+
+	search.Begin(allTris.size());
+	search.Open(startTri, 0.0f, (endPos - tris[startTri].centroid).Length(), -1);
+
+	while (search.HasOpen()) {
+		int current = search.PopBest();
+		if (current == endTri) {
+			return true;
+		}
+		search.Close(current);
+		float g = search.GetG(current);
+
+		for (int j = 0; j < 3; ++j) {
+			const NavTri* neighbour = tris[current].neighbours[j];
+			if (!neighbour) {
+				continue;
+			}
+			int n = (int)(neighbour - tris);
+			if (search.IsClosed(n)) {
+				continue;
+			}
+			float newG = g + (neighbour->centroid - tris[current].centroid).Length();
+			if (!search.IsSeen(n) || newG < search.GetG(n)) {
+				search.Open(n, newG, newG + (endPos - neighbour->centroid).Length(), current);
+			}
+		}
+	}
 	return false;
 }
 
 /*
-If you have triangles on top of triangles in a full 3D environment, you'll need to change this slightly,
-as it is currently ignoring height. You might find tri/plane raycasting is handy.
+Twice the signed area of abc on the x/z plane - its sign says which
+side of a->b that c is on.
 */
+static float TriArea2XZ(const Vector3& a, const Vector3& b, const Vector3& c) {
+	float ax = b.x - a.x;
+	float az = b.z - a.z;
+	float bx = c.x - a.x;
+	float bz = c.z - a.z;
+	return (bx * az) - (ax * bz);
+}
 
-const NavigationMesh::NavTri* NavigationMesh::GetTriForPosition(const Vector3& pos) const {
-	for (const NavTri& t : allTris) {
-		Vector3 planePoint = t.triPlane.ProjectPointOntoPlane(pos);
+static bool SameXZ(const Vector3& a, const Vector3& b) {
+	float dx = a.x - b.x;
+	float dz = a.z - b.z;
+	return (dx * dx) + (dz * dz) < 0.000001f;
+}
 
-		float ta = Maths::CrossAreaOfTri(allVerts[t.indices[0]], allVerts[t.indices[1]], planePoint);
-		float tb = Maths::CrossAreaOfTri(allVerts[t.indices[1]], allVerts[t.indices[2]], planePoint);
-		float tc = Maths::CrossAreaOfTri(allVerts[t.indices[2]], allVerts[t.indices[0]], planePoint);
+/*
+The 'simple stupid funnel' - a funnel is kept from the last corner of
+the path out through the edges between corridor triangles. Each edge
+narrows it from one side or the other, until an edge would cross right
+over the far side, at which point that side's corner is a waypoint
+and the funnel starts again from there.
+*/
+void NavigationMesh::StringPull(const std::vector<int>& corridor, const Vector3& from, const Vector3& to, NavigationPath& outPath) const {
+	thread_local std::vector<Vector3> lefts;
+	thread_local std::vector<Vector3> rights;
+	lefts.clear();
+	rights.clear();
 
-		float areaSum = ta + tb + tc;
+	lefts.push_back(from);
+	rights.push_back(from);
+	for (size_t i = 0; i + 1 < corridor.size(); ++i) {
+		const NavTri& t		= allTris[corridor[i]];
+		const NavTri* next	= &allTris[corridor[i + 1]];
+		for (int j = 0; j < 3; ++j) {
+			if (t.neighbours[j] != next) {
+				continue;
+			}
+			Vector3 a = allVerts[t.portals[j][0]];
+			Vector3 b = allVerts[t.portals[j][1]];
+			if (TriArea2XZ(t.centroid, a, b) < 0.0f) { //keep every edge's left on the same side as we walk along
+				std::swap(a, b);
+			}
+			lefts.push_back(a);
+			rights.push_back(b);
+			break;
+		}
+	}
+	lefts.push_back(to);
+	rights.push_back(to);
 
-		if (abs(areaSum - t.area)  > 0.001f) { //floating points are annoying! Are we more or less inside the triangle?
-			continue;
+	thread_local std::vector<Vector3> points;
+	points.clear();
+	points.push_back(from);
+
+	Vector3 apex		= from;
+	Vector3 funnelLeft	= lefts[0];
+	Vector3 funnelRight	= rights[0];
+	int apexIndex	= 0;
+	int leftIndex	= 0;
+	int rightIndex	= 0;
+
+	for (int i = 1; i < (int)lefts.size(); ++i) {
+		const Vector3& left		= lefts[i];
+		const Vector3& right	= rights[i];
+
+		if (TriArea2XZ(apex, funnelRight, right) <= 0.0f) { //right side narrows?
+			if (SameXZ(apex, funnelRight) || TriArea2XZ(apex, funnelLeft, right) > 0.0f) {
+				funnelRight	= right;
+				rightIndex	= i;
+			}
+			else { //crossed over the left, so the left is a corner
+				points.push_back(funnelLeft);
+				apex		= funnelLeft;
+				apexIndex	= leftIndex;
+				funnelLeft	= apex;
+				funnelRight	= apex;
+				leftIndex	= apexIndex;
+				rightIndex	= apexIndex;
+				i			= apexIndex;
+				continue;
+			}
+		}
+		if (TriArea2XZ(apex, funnelLeft, left) >= 0.0f) { //left side narrows?
+			if (SameXZ(apex, funnelLeft) || TriArea2XZ(apex, funnelRight, left) < 0.0f) {
+				funnelLeft	= left;
+				leftIndex	= i;
+			}
+			else {
+				points.push_back(funnelRight);
+				apex		= funnelRight;
+				apexIndex	= rightIndex;
+				funnelLeft	= apex;
+				funnelRight	= apex;
+				leftIndex	= apexIndex;
+				rightIndex	= apexIndex;
+				i			= apexIndex;
+				continue;
+			}
+		}
+	}
+	if (!SameXZ(points.back(), to)) {
+		points.push_back(to);
+	}
+	else {
+		points.back() = to;
+	}
+	for (auto i = points.rbegin(); i != points.rend(); ++i) {
+		outPath.PushWaypoint(*i);
+	}
+}
+
+bool NavigationMesh::PointInTriXZ(const NavTri& t, const Vector3& pos) const {
+	const float edgeSlop = 0.0001f; //floating points are annoying! Points on an edge count as in
+	const Vector3& a = allVerts[t.indices[0]];
+	const Vector3& b = allVerts[t.indices[1]];
+	const Vector3& c = allVerts[t.indices[2]];
+
+	float ab = TriArea2XZ(a, b, pos);
+	float bc = TriArea2XZ(b, c, pos);
+	float ca = TriArea2XZ(c, a, pos);
+	return (ab >= -edgeSlop && bc >= -edgeSlop && ca >= -edgeSlop) ||
+		(ab <= edgeSlop && bc <= edgeSlop && ca <= edgeSlop);
+}
+
+float NavigationMesh::HeightAtXZ(const NavTri& t, const Vector3& pos) const {
+	Vector3 normal = t.triPlane.GetNormal();
+	return -((normal.x * pos.x) + (normal.z * pos.z) + t.triPlane.GetDistance()) / normal.y;
+}
+
+/*
+Looks up which triangles might be under the position in the spatial
+index, and tests only those. If there's triangles on top of triangles,
+the one closest in height to the position wins.
+*/
+int NavigationMesh::GetTriIndexForPosition(const Vector3& pos) const {
+	if (cellsX == 0) {
+		return -1;
+	}
+	int x = (int)floor((pos.x - cellOrigin.x) / cellSize);
+	int z = (int)floor((pos.z - cellOrigin.z) / cellSize);
+	if (x < 0 || x >= cellsX || z < 0 || z >= cellsZ) {
+		return -1;
+	}
+	int cell = (z * cellsX) + x;
+
+	int		best		= -1;
+	float	bestHeight	= FLT_MAX;
+	for (int i = cellStarts[cell]; i < cellStarts[cell + 1]; ++i) {
+		const NavTri& t = allTris[cellTris[i]];
+		if (abs(t.triPlane.GetNormal().y) < 0.0001f || !PointInTriXZ(t, pos)) {
+			continue; //walls can't be stood on
+		}
+		float height = abs(HeightAtXZ(t, pos) - pos.y);
+		if (height < bestHeight) {
+			bestHeight	= height;
+			best		= cellTris[i];
 		}
-		return &t;
 	}
-	return nullptr;
-}
\ No newline at end of file
+	return best;
+}
+
+const NavigationMesh::NavTri* NavigationMesh::GetTriForPosition(const Vector3& pos) const {
+	int tri = GetTriIndexForPosition(pos);
+	return tri == -1 ? nullptr : &allTris[tri];
+}
@@ -5,14 +5,29 @@
 #include <vector>
 namespace NCL {
 	namespace CSC8503 {
+		class GridSearch;
+
 		class NavigationMesh : public NavigationMap	{
 		public:
 			NavigationMesh();
+			// Throws std::runtime_error if the file is a damaged binary mesh
 			NavigationMesh(const std::string&filename);
 			~NavigationMesh();
 
+			// Uses a scratch search owned by the calling thread
 			bool FindPath(const Vector3& from, const Vector3& to, NavigationPath& outPath) override;
-		
+			bool FindPath(const Vector3& from, const Vector3& to, NavigationPath& outPath, GridSearch& search) const;
+
+			int GetTriCount() const {
+				return (int)allTris.size();
+			}
+
+			// Index of the triangle under the position, -1 if it's off the mesh
+			int GetTriIndexForPosition(const Vector3& pos) const;
+
+			// Writes the mesh out in the binary format from NavigationData.h, into the data folder
+			bool SaveBinary(const std::string& filename) const;
+
 		protected:
 			struct NavTri {
 				Plane   triPlane;
@@ -21,6 +36,7 @@ namespace NCL {
 				NavTri* neighbours[3];
 
 				int indices[3];
+				int portals[3][2]; // Vertices of the edge shared with each neighbour, -1 if there isn't one
 
 				NavTri() {
 					area = 0.0f;
@@ -31,13 +47,43 @@ namespace NCL {
 					indices[0] = -1;
 					indices[1] = -1;
 					indices[2] = -1;
+
+					for (int i = 0; i < 3; ++i) {
+						portals[i][0] = -1;
+						portals[i][1] = -1;
+					}
 				}
 			};
 
 			const NavTri* GetTriForPosition(const Vector3& pos) const;
 
+			void LoadText(const std::string& filepath);
+			bool LoadBinary(const char* data, size_t size);
+			void SetupTri(NavTri& tri);
+
+			void BuildPortals();
+			void BuildSpatialIndex();
+
+			bool TriSearch(int startTri, int endTri, GridSearch& search) const;
+			void StringPull(const std::vector<int>& corridor, const Vector3& from, const Vector3& to, NavigationPath& outPath) const;
+
+			bool PointInTriXZ(const NavTri& t, const Vector3& pos) const;
+			float HeightAtXZ(const NavTri& t, const Vector3& pos) const;
+
 			std::vector<NavTri>		allTris;
 			std::vector<Vector3>	allVerts;
+
+			/*
+			A uniform grid over the mesh's x/z bounds, each cell listing the
+			triangles whose bounds overlap it. The lists are packed end to
+			end, with cellStarts[i] to cellStarts[i+1] being cell i's range.
+			*/
+			Vector3				cellOrigin;
+			float				cellSize;
+			int					cellsX;
+			int					cellsZ;
+			std::vector<int>	cellStarts;
+			std::vector<int>	cellTris;
 		};
 	}
-}
\ No newline at end of file
+}
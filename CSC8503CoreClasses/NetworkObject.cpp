@@ -25,6 +25,15 @@ bool NetworkObject::ReadPacket(GamePacket& p) {
 
 bool NetworkObject::WritePacket(GamePacket** p, bool deltaFrame, int stateID) {
 	UpdateLastFullState();
+	return WriteCurrentState(p, deltaFrame, stateID);
+}
+
+bool NetworkObject::WritePacket(GamePacket** p, bool deltaFrame, int stateID, const ObjectSnapshot& snapshot) {
+	UpdateLastFullState(snapshot);
+	return WriteCurrentState(p, deltaFrame, stateID);
+}
+
+bool NetworkObject::WriteCurrentState(GamePacket** p, bool deltaFrame, int stateID) {
 	if (deltaFrame) {
 		if (!WriteDeltaPacket(p, stateID)) {
 			return WriteFullPacket(p);
@@ -43,6 +52,14 @@ void NetworkObject::UpdateLastFullState() {
 	lastFullState.angVelocity = object->GetPhysicsObject()->GetAngularVelocity();
 }
 
+void NetworkObject::UpdateLastFullState(const ObjectSnapshot& snapshot) {
+	lastFullState.stateID++;
+	lastFullState.position = snapshot.position;
+	lastFullState.orientation = snapshot.orientation;
+	lastFullState.velocity = snapshot.linearVelocity;
+	lastFullState.angVelocity = snapshot.angularVelocity;
+}
+
 //Client objects recieve these packets
 bool NetworkObject::ReadDeltaPacket(DeltaPacket &p) {
 	NetworkState state;
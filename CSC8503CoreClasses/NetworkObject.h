@@ -2,6 +2,7 @@
 #include "GameObject.h"
 #include "NetworkBase.h"
 #include "NetworkState.h"
+#include "WorldSnapshot.h"
 
 namespace NCL::CSC8503 {
 	class GameObject;
@@ -51,6 +52,8 @@ namespace NCL::CSC8503 {
 		virtual bool ReadPacket(GamePacket& p);
 		//Called by servers
 		virtual bool WritePacket(GamePacket** p, bool deltaFrame, int stateID);
+		//As above, but encodes a frozen snapshot of the object instead of its live state
+		bool WritePacket(GamePacket** p, bool deltaFrame, int stateID, const ObjectSnapshot& snapshot);
 
 		void UpdateStateHistory(int minID);
 
@@ -61,6 +64,8 @@ namespace NCL::CSC8503 {
 		NetworkState& GetLatestNetworkState();
 
 		void UpdateLastFullState();
+		void UpdateLastFullState(const ObjectSnapshot& snapshot);
+		bool WriteCurrentState(GamePacket** p, bool deltaFrame, int stateID);
 
 		bool GetNetworkState(int frameID, NetworkState& state);
 
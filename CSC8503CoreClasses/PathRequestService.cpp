@@ -0,0 +1,203 @@
+#include "PathRequestService.h"
+
+using namespace NCL;
+using namespace CSC8503;
+
+PathRequestService::PathRequestService(const NavigationGrid& grid, JobSystem* jobs) : grid(grid), jobs(jobs) {
+	maxCacheSize	= 512;
+	cacheVersion	= grid.GetVersion();
+	searchBudget	= 8;
+	frame			= 0;
+	cacheHits		= 0;
+	searchCount		= 0;
+	requestCount	= 0;
+}
+
+PathRequestService::~PathRequestService() {
+	WaitForSearches();
+}
+
+void PathRequestService::WaitForSearches() {
+	if (jobs) {
+		jobs->Wait(searchesDone);
+	}
+}
+
+PathHandle PathRequestService::Request(const Vector3& from, const Vector3& to, float priority) {
+	requestCount++;
+	int slot;
+	if (freeSlots.empty()) {
+		slot = (int)requests.size();
+		requests.emplace_back(std::make_unique<PathRequestService::RequestSlot>());
+	}
+	else {
+		slot = freeSlots.back();
+		freeSlots.pop_back();
+	}
+	PathRequestService::RequestSlot& r = *requests[slot];
+	r.generation++;
+	r.released	= false;
+	r.priority	= priority;
+	r.path.reset();
+
+	PathHandle handle;
+	handle.slot			= slot;
+	handle.generation	= r.generation;
+
+	int fromX, fromZ, toX, toZ;
+	if (!grid.WorldToGrid(from, fromX, fromZ) || !grid.WorldToGrid(to, toX, toZ) ||
+		!grid.IsOpen(fromX, fromZ) || !grid.IsOpen(toX, toZ)) {
+		r.state.store(PathRequestState::Failed, std::memory_order_relaxed);
+		return handle;
+	}
+	r.fromNode	= (fromZ * grid.GetWidth()) + fromX;
+	r.toNode	= (toZ * grid.GetWidth()) + toX;
+
+	SharedPath cached;
+	if (FindCached(r.fromNode, r.toNode, grid.GetVersion(), cached)) {
+		cacheHits++;
+		r.path = cached;
+		r.state.store(cached ? PathRequestState::Ready : PathRequestState::Failed, std::memory_order_relaxed);
+		return handle;
+	}
+	r.state.store(PathRequestState::Queued, std::memory_order_relaxed);
+	queue.push_back(slot);
+	return handle;
+}
+
+const PathRequestService::RequestSlot* PathRequestService::GetRequest(PathHandle handle) const {
+	if (handle.slot < 0 || handle.slot >= (int)requests.size()) {
+		return nullptr;
+	}
+	const PathRequestService::RequestSlot* r = requests[handle.slot].get();
+	if (r->generation != handle.generation || r->released) {
+		return nullptr; //slot has been handed to someone else since
+	}
+	return r;
+}
+
+PathRequestState PathRequestService::GetState(PathHandle handle) const {
+	const PathRequestService::RequestSlot* r = GetRequest(handle);
+	return r ? r->state.load(std::memory_order_acquire) : PathRequestState::Invalid;
+}
+
+SharedPath PathRequestService::GetPath(PathHandle handle) const {
+	const PathRequestService::RequestSlot* r = GetRequest(handle);
+	if (!r || r->state.load(std::memory_order_acquire) != PathRequestState::Ready) {
+		return nullptr;
+	}
+	return r->path;
+}
+
+void PathRequestService::Release(PathHandle handle) {
+	if (GetRequest(handle)) {
+		requests[handle.slot]->released = true; //Update frees it once any search has finished
+	}
+}
+
+void PathRequestService::Update() {
+	frame++;
+
+	unsigned int version = grid.GetVersion();
+	if (version != cacheVersion) {
+		std::lock_guard<std::mutex> lock(cacheLock);
+		cache.clear(); //nothing in here can be hit any more
+		cacheVersion = version;
+	}
+
+	std::erase_if(queue, [&](int slot) {
+		return requests[slot]->released;
+	});
+	for (int i = 0; i < (int)requests.size(); ++i) {
+		PathRequestService::RequestSlot& r = *requests[i];
+		PathRequestState state = r.state.load(std::memory_order_acquire);
+		if (r.released && state != PathRequestState::Invalid && state != PathRequestState::Searching) {
+			r.state.store(PathRequestState::Invalid, std::memory_order_relaxed);
+			r.path.reset();
+			freeSlots.push_back(i);
+		}
+	}
+	/*
+	Only the most important requests get searched this frame, the rest
+	wait. Equal priorities keep the order they were asked for in, so
+	nothing waits forever behind later requests of the same priority.
+	*/
+	std::stable_sort(queue.begin(), queue.end(), [&](int a, int b) {
+		return requests[a]->priority > requests[b]->priority;
+	});
+	int count = std::min(searchBudget, (int)queue.size());
+
+	for (int i = 0; i < count; ++i) {
+		PathRequestService::RequestSlot& r = *requests[queue[i]];
+		r.gridVersion = version;
+
+		SharedPath cached;
+		if (FindCached(r.fromNode, r.toNode, version, cached)) { //an earlier search might have found it already
+			cacheHits++;
+			r.path = cached;
+			r.state.store(cached ? PathRequestState::Ready : PathRequestState::Failed, std::memory_order_release);
+			continue;
+		}
+		searchCount++;
+		r.state.store(PathRequestState::Searching, std::memory_order_relaxed);
+		if (jobs) {
+			jobs->Run([this, &r, searchFrame = frame]() {
+				Search(r, searchFrame);
+			}, &searchesDone);
+		}
+		else {
+			Search(r, frame);
+		}
+	}
+	queue.erase(queue.begin(), queue.begin() + count);
+}
+
+void PathRequestService::Search(PathRequestService::RequestSlot& r, unsigned int searchFrame) {
+	thread_local GridSearch search;
+
+	NavigationPath outPath;
+	bool found = grid.FindPath(grid.GetNodePosition(r.fromNode), grid.GetNodePosition(r.toNode), outPath, search);
+
+	SharedPath path;
+	if (found) {
+		auto waypoints = std::make_shared<std::vector<Vector3>>();
+		Vector3 pos;
+		while (outPath.PopWaypoint(pos)) {
+			waypoints->push_back(pos);
+		}
+		path = std::move(waypoints);
+	}
+	AddCached(r.fromNode, r.toNode, r.gridVersion, searchFrame, path);
+
+	r.path = path;
+	r.state.store(found ? PathRequestState::Ready : PathRequestState::Failed, std::memory_order_release);
+}
+
+bool PathRequestService::FindCached(int fromNode, int toNode, unsigned int gridVersion, SharedPath& outPath) {
+	std::lock_guard<std::mutex> lock(cacheLock);
+	auto i = cache.find(CacheKey(fromNode, toNode));
+	if (i == cache.end() || i->second.gridVersion != gridVersion) {
+		return false;
+	}
+	i->second.lastUsedFrame = frame;
+	outPath = i->second.path;
+	return true;
+}
+
+void PathRequestService::AddCached(int fromNode, int toNode, unsigned int gridVersion, unsigned int usedFrame, const SharedPath& path) {
+	std::lock_guard<std::mutex> lock(cacheLock);
+	if (gridVersion != cacheVersion) {
+		return; //grid has moved on since this search started
+	}
+	uint64_t key = CacheKey(fromNode, toNode);
+	if (cache.size() >= maxCacheSize && cache.find(key) == cache.end()) {
+		auto oldest = cache.begin();
+		for (auto i = cache.begin(); i != cache.end(); ++i) {
+			if (i->second.lastUsedFrame < oldest->second.lastUsedFrame) {
+				oldest = i;
+			}
+		}
+		cache.erase(oldest);
+	}
+	cache[key] = CachedPath{ gridVersion, usedFrame, path };
+}
@@ -0,0 +1,145 @@
+#pragma once
+#include "NavigationGrid.h"
+#include "JobSystem.h"
+
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace NCL {
+	namespace CSC8503 {
+		enum class PathRequestState {
+			Invalid,	// Never requested, or already released
+			Queued,
+			Searching,
+			Ready,
+			Failed		// No path, or one of the ends is off the grid or in a wall
+		};
+
+		struct PathHandle {
+			int				slot		= -1;
+			unsigned int	generation	= 0;
+
+			bool IsValid() const {
+				return slot != -1;
+			}
+		};
+
+		typedef std::shared_ptr<const std::vector<Vector3>> SharedPath;
+
+		/*
+		Rather than every agent running its own search whenever it wants a
+		path, requests are queued up, and Update hands the most important
+		few to the job system each frame. Agents hold on to a handle, and
+		check back on later frames for the result.
+
+		Finished paths are kept, keyed by their start and end nodes and the
+		grid's version, so asking for the same path again costs nothing
+		until the grid next changes. Cached paths are shared rather than
+		copied.
+
+		The grid must not change while searches are running - call
+		WaitForSearches first.
+		*/
+		class PathRequestService {
+		public:
+			PathRequestService(const NavigationGrid& grid, JobSystem* jobs = nullptr);
+			~PathRequestService();
+
+			// Higher priority requests are searched first
+			PathHandle	Request(const Vector3& from, const Vector3& to, float priority = 0.0f);
+
+			PathRequestState GetState(PathHandle handle) const;
+
+			// Waypoints from start to end, or null if the request isn't Ready
+			SharedPath	GetPath(PathHandle handle) const;
+
+			// Lets the request's slot be reused. Safe to call while it's still being searched
+			void		Release(PathHandle handle);
+
+			// Starts off this frame's searches, and tidies up after the last lot
+			void		Update();
+
+			void		WaitForSearches();
+
+			void SetSearchBudget(int searchesPerFrame) {
+				searchBudget = searchesPerFrame;
+			}
+
+			int GetSearchBudget() const {
+				return searchBudget;
+			}
+
+			void SetCacheSize(size_t maxPaths) {
+				maxCacheSize = maxPaths;
+			}
+
+			int GetQueuedCount() const {
+				return (int)queue.size();
+			}
+
+			int GetCacheHits() const {
+				return cacheHits;
+			}
+
+			int GetSearchCount() const {
+				return searchCount;
+			}
+
+			// Every request, whether it needed a search or not
+			int GetRequestCount() const {
+				return requestCount;
+			}
+
+		protected:
+			struct RequestSlot {
+				int				fromNode;
+				int				toNode;
+				float			priority;
+				unsigned int	gridVersion;
+				unsigned int	generation;
+				bool			released;
+
+				std::atomic<PathRequestState> state;
+				SharedPath		path;
+
+				RequestSlot() : fromNode(-1), toNode(-1), priority(0.0f), gridVersion(0),
+					generation(0), released(true), state(PathRequestState::Invalid) {}
+			};
+
+			struct CachedPath {
+				unsigned int	gridVersion;
+				unsigned int	lastUsedFrame;
+				SharedPath		path;
+			};
+
+			uint64_t	CacheKey(int fromNode, int toNode) const {
+				return ((uint64_t)(uint32_t)fromNode << 32) | (uint32_t)toNode;
+			}
+			// A null outPath means there's known to be no path
+			bool		FindCached(int fromNode, int toNode, unsigned int gridVersion, SharedPath& outPath);
+			void		AddCached(int fromNode, int toNode, unsigned int gridVersion, unsigned int usedFrame, const SharedPath& path);
+			void		Search(RequestSlot& r, unsigned int searchFrame);
+			const RequestSlot* GetRequest(PathHandle handle) const;
+
+			const NavigationGrid&	grid;
+			JobSystem*				jobs;
+			JobCounter				searchesDone;
+
+			std::vector<std::unique_ptr<RequestSlot>>	requests;	// Slots never move, so workers can hold on to them
+			std::vector<int>						freeSlots;
+			std::vector<int>						queue;		// Slots waiting for a search
+
+			std::mutex								cacheLock;
+			std::unordered_map<uint64_t, CachedPath> cache;
+			size_t			maxCacheSize;
+			unsigned int	cacheVersion;
+
+			int				searchBudget;
+			unsigned int	frame;
+			int				cacheHits;
+			int				searchCount;
+			int				requestCount;
+		};
+	}
+}
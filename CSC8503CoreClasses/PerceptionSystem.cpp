@@ -0,0 +1,201 @@
+#include "PerceptionSystem.h"
+#include "GameObject.h"
+#include "Maths.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace NCL;
+using namespace CSC8503;
+
+PerceptionSystem::PerceptionSystem(float cellSize) {
+	this->cellSize	= cellSize;
+	version			= 1;
+	moveCount		= 0;
+}
+
+PerceptionSystem::~PerceptionSystem() {
+}
+
+void PerceptionSystem::AddSource(GameObject* object, StimulusType type) {
+	for (const Source& s : sources) {
+		if (s.object == object) {
+			return;
+		}
+	}
+	Source s;
+	s.object	= object;
+	s.type		= type;
+	s.position	= object->GetTransform().GetPosition();
+	CellFor(s.position, s.cellX, s.cellZ);
+	sources.push_back(s);
+	SourcesChanged();
+}
+
+void PerceptionSystem::RemoveSource(GameObject* object) {
+	for (int i = 0; i < (int)sources.size(); ++i) {
+		if (sources[i].object == object) {
+			sources.erase(sources.begin() + i);
+			SourcesChanged();
+			return;
+		}
+	}
+}
+
+void PerceptionSystem::Clear() {
+	sources.clear();
+	SourcesChanged();
+}
+
+void PerceptionSystem::CellFor(const Vector3& position, int& x, int& z) const {
+	x = (int)std::floor(position.x / cellSize);
+	z = (int)std::floor(position.z / cellSize);
+}
+
+void PerceptionSystem::Update() {
+	bool moved = false;
+	for (Source& s : sources) {
+		s.position = s.object->GetTransform().GetPosition();
+		int x, z;
+		CellFor(s.position, x, z);
+		if (x != s.cellX || z != s.cellZ) {
+			s.cellX = x;
+			s.cellZ = z;
+			moveLog[moveCount % MoveLogSize] = { x, z, StimulusMask(s.type) };
+			moveCount++;
+			moved = true;
+		}
+	}
+	if (moved) {
+		SortCells();
+	}
+}
+
+void PerceptionSystem::SortCells() {
+	cells.clear();
+	for (int i = 0; i < (int)sources.size(); ++i) {
+		cells.push_back({ CellKey(sources[i].cellX, sources[i].cellZ), i });
+	}
+	std::sort(cells.begin(), cells.end());
+}
+
+// Source indices have changed, so every cache is out of date
+void PerceptionSystem::SourcesChanged() {
+	SortCells();
+	version++;
+	if (version == 0) {
+		version = 1; // A fresh cache has a version of 0, so it must never match
+	}
+}
+
+template <typename F>
+void PerceptionSystem::ForEachSourceInReach(int cellX, int cellZ, float radius, unsigned int typeMask, F&& func) const {
+	int reach = (int)std::ceil(radius / cellSize);
+	for (int x = cellX - reach; x <= cellX + reach; ++x) {
+		for (int z = cellZ - reach; z <= cellZ + reach; ++z) {
+			long long key = CellKey(x, z);
+			auto i = std::lower_bound(cells.begin(), cells.end(), CellEntry{ key, -1 });
+			for (; i != cells.end() && i->cell == key; ++i) {
+				if (typeMask & StimulusMask(sources[i->source].type)) {
+					func(i->source);
+				}
+			}
+		}
+	}
+}
+
+/*
+The cache has to hold whatever could be within radius of anywhere in the
+agent's cell, so it takes in every cell that comes within radius of the
+cell's edges, not just of the agent.
+*/
+void PerceptionSystem::FillCache(int cellX, int cellZ, float radius, unsigned int typeMask, PerceptionCache& cache) const {
+	cache.cellX		= cellX;
+	cache.cellZ		= cellZ;
+	cache.version	= version;
+	cache.moveCount	= moveCount;
+	cache.radius	= radius;
+	cache.typeMask	= typeMask;
+	cache.count		= 0;
+	cache.overflowed = false;
+
+	ForEachSourceInReach(cellX, cellZ, radius, typeMask, [&](int source) {
+		if (cache.count < PerceptionCache::MaxCandidates) {
+			cache.candidates[cache.count++] = source;
+		}
+		else {
+			cache.overflowed = true;
+		}
+	});
+}
+
+// True if the cache has to be refilled because of sources moving since it was filled
+bool PerceptionSystem::MovedIntoReach(const PerceptionCache& cache) const {
+	if (moveCount - cache.moveCount > (unsigned int)MoveLogSize) {
+		return true; // The log doesn't go back that far
+	}
+	int reach = (int)std::ceil(cache.radius / cellSize);
+	for (unsigned int i = cache.moveCount; i != moveCount; ++i) {
+		const CellMove& m = moveLog[i % MoveLogSize];
+		if ((m.typeMask & cache.typeMask) && std::abs(m.cellX - cache.cellX) <= reach && std::abs(m.cellZ - cache.cellZ) <= reach) {
+			return true;
+		}
+	}
+	return false;
+}
+
+int PerceptionSystem::Sense(const Vector3& position, const Vector3& forward, float radius, float halfFOV, unsigned int typeMask,
+	PerceptionCache& cache, PerceivedStimulus* out, int maxOut) const {
+	int cellX, cellZ;
+	CellFor(position, cellX, cellZ);
+	if (cache.version != version || cache.cellX != cellX || cache.cellZ != cellZ || cache.radius < radius || cache.typeMask != typeMask
+		|| (cache.moveCount != moveCount && MovedIntoReach(cache))) {
+		FillCache(cellX, cellZ, radius, typeMask, cache);
+	}
+	cache.moveCount = moveCount;
+
+	float cosFOV = std::cos(Maths::DegreesToRadians(std::min(halfFOV, 180.0f)));
+	Vector3 flatForward = Vector3(forward.x, 0, forward.z);
+	bool allRound = halfFOV >= 180.0f || flatForward.LengthSquared() == 0.0f;
+	if (!allRound) {
+		flatForward.Normalise();
+	}
+
+	int found = 0;
+	auto consider = [&](int source) {
+		const Source& s = sources[source];
+		Vector3 offset = s.position - position;
+		float distance = offset.Length();
+		if (distance > radius) {
+			return;
+		}
+		if (!allRound && distance > 0.0f) {
+			Vector3 flatOffset = Vector3(offset.x, 0, offset.z);
+			float flatLength = flatOffset.Length();
+			if (flatLength > 0.0f && Vector3::Dot(flatOffset, flatForward) < cosFOV * flatLength) {
+				return;
+			}
+		}
+		// Insertion sort, there's only ever a handful
+		int slot = found < maxOut ? found++ : maxOut;
+		while (slot > 0 && out[slot - 1].distance > distance) {
+			if (slot < maxOut) {
+				out[slot] = out[slot - 1];
+			}
+			slot--;
+		}
+		if (slot < maxOut) {
+			out[slot] = { s.object, s.type, s.position, distance };
+		}
+	};
+	if (cache.overflowed) {
+		// Too crowded to cache, so every source in reach is looked at, rather than only the first few
+		ForEachSourceInReach(cellX, cellZ, radius, typeMask, consider);
+	}
+	else {
+		for (int c = 0; c < cache.count; ++c) {
+			consider(cache.candidates[c]);
+		}
+	}
+	return found;
+}
@@ -0,0 +1,142 @@
+#pragma once
+#include "Vector3.h"
+#include <vector>
+
+namespace NCL {
+	using namespace NCL::Maths;
+
+	namespace CSC8503 {
+		class GameObject;
+
+		enum class StimulusType {
+			Goat,
+			Goose
+		};
+
+		inline unsigned int StimulusMask(StimulusType type) {
+			return 1u << (int)type;
+		}
+
+		struct PerceivedStimulus {
+			GameObject*		object;
+			StimulusType	type;
+			Vector3			position;
+			float			distance;
+		};
+
+		/*
+		Each agent keeps one of these, so that it doesn't have to go
+		looking through the perception system's cells every time it senses.
+		It holds every source close enough to matter from anywhere in the
+		agent's cell, and is only refreshed once the agent moves to another
+		cell, or a source moves into a cell near it. If there are more than
+		MaxCandidates of them, it's marked as overflowed instead, and the
+		agent goes back to looking through the cells until it's refilled.
+		*/
+		struct PerceptionCache {
+			static const int MaxCandidates = 16;
+
+			int				cellX		= 0;
+			int				cellZ		= 0;
+			unsigned int	version		= 0;	// 0 is never valid
+			unsigned int	moveCount	= 0;	// How many moves the system had logged when this was filled
+			float			radius		= 0.0f;
+			unsigned int	typeMask	= 0;
+			int				count		= 0;
+			bool			overflowed	= false;
+			int				candidates[MaxCandidates];
+		};
+
+		/*
+		Rather than every agent looping over every goat (and goose) each
+		time it wants to know what's nearby, the sources of stimuli are
+		sorted into a grid of cells once per update. Agents then only look
+		at the sources in the cells around them.
+
+		Sensing never allocates, so it's safe for agents to call from
+		worker threads, as long as Update isn't running at the same time.
+		*/
+		class PerceptionSystem {
+		public:
+			PerceptionSystem(float cellSize = 20.0f);
+			~PerceptionSystem();
+
+			void AddSource(GameObject* object, StimulusType type);
+			void RemoveSource(GameObject* object);
+			void Clear();
+
+			// Picks up where every source has moved to
+			void Update();
+
+			/*
+			Fills out with up to maxOut sources of the types in typeMask that
+			are within radius of position, and within halfFOV degrees either
+			side of forward (180 covers all the way round). Nearest first.
+			Returns how many were found.
+			*/
+			int Sense(const Vector3& position, const Vector3& forward, float radius, float halfFOV, unsigned int typeMask,
+				PerceptionCache& cache, PerceivedStimulus* out, int maxOut) const;
+
+			int GetSourceCount() const {
+				return (int)sources.size();
+			}
+
+			float GetCellSize() const {
+				return cellSize;
+			}
+
+		protected:
+			struct Source {
+				GameObject*		object;
+				StimulusType	type;
+				Vector3			position;
+				int				cellX;
+				int				cellZ;
+			};
+
+			struct CellEntry {
+				long long	cell;
+				int			source;
+
+				bool operator<(const CellEntry& other) const {
+					return cell < other.cell || (cell == other.cell && source < other.source);
+				}
+			};
+
+			void CellFor(const Vector3& position, int& x, int& z) const;
+			static long long CellKey(int x, int z) {
+				return ((long long)x << 32) | (unsigned int)z;
+			}
+
+			// Calls func with the index of every source of the types in typeMask in the cells within radius of the cell
+			template <typename F>
+			void ForEachSourceInReach(int cellX, int cellZ, float radius, unsigned int typeMask, F&& func) const;
+			void FillCache(int cellX, int cellZ, float radius, unsigned int typeMask, PerceptionCache& cache) const;
+			bool MovedIntoReach(const PerceptionCache& cache) const;
+			void SortCells();
+			void SourcesChanged();
+
+			float					cellSize;
+			std::vector<Source>		sources;
+			std::vector<CellEntry>	cells;	// Sorted by cell, so each cell's sources are together
+
+			// Bumped whenever a source comes or goes, which invalidates every cache
+			unsigned int			version;
+
+			/*
+			The cells the last few sources moved into. A source moving away
+			can't change what a cache would hold, as the exact distance check
+			drops it anyway, so only caches in reach of one of these need
+			refilling.
+			*/
+			static const int		MoveLogSize = 64;
+			struct CellMove {
+				int			cellX;
+				int			cellZ;
+				unsigned int typeMask;
+			};
+			CellMove				moveLog[MoveLogSize];
+			unsigned int			moveCount;
+		};
+	}
+}
@@ -16,7 +16,15 @@ PhysicsObject::PhysicsObject(Transform* parentTransform, const CollisionVolume*
 
 	this->lockedAxes = Vector3(1, 1, 1);
 
+	inertiaVersion	= 0;
+	inertiaDirty	= true;
+
 	this->sleep = sleep;
+	sleepProgress = 0.0f;
+
+	lodLevel	= 0;
+	lodTime		= 0.0f;
+	lodStepDT	= 0.0f;
 }
 
 PhysicsObject::~PhysicsObject()	{
@@ -83,6 +91,46 @@ void PhysicsObject::AddSleepProgress(float dt) {
 	lastPosition = currentPosition;
 }
 
+/*
+Reduced rate bodies bank up the substeps they skip, along with whatever
+force was on them for each one, and integrate the lot when their turn
+comes round. Forces are cleared every frame, so a force added on a frame
+the body sits out is still counted, but only for as long as it was
+actually there. A body that gets
+promoted back to full rate takes whatever it has banked straight away
+(see CatchUpLOD), so nothing is ever lost. The substep index is offset
+by the caller, so that not every 1/8th rate body lands on the same substep.
+*/
+bool PhysicsObject::AdvanceLOD(float dt, int substep) {
+	if (sleep) {
+		lodTime = 0.0f;
+		lodStepDT = 0.0f;
+		lodImpulse = Vector3();
+		lodAngularImpulse = Vector3();
+		return false;
+	}
+	lodTime += dt;
+	lodImpulse += force * dt;
+	lodAngularImpulse += torque * dt;
+	int stride = 1 << lodLevel;
+	if (substep % stride != 0) {
+		lodStepDT = 0.0f;
+		return false;
+	}
+	lodStepDT = lodTime;
+	lodTime = 0.0f;
+	return true;
+}
+
+bool PhysicsObject::CatchUpLOD() {
+	if (sleep || lodStepDT > 0.0f || lodTime == 0.0f) {
+		return false;
+	}
+	lodStepDT = lodTime;
+	lodTime = 0.0f;
+	return true;
+}
+
 void PhysicsObject::InitCubeInertia() {
 	Vector3 dimensions	= transform->GetScale();
 
@@ -93,6 +141,7 @@ void PhysicsObject::InitCubeInertia() {
 	inverseInertia.x = (12.0f * inverseMass) / (dimsSqr.y + dimsSqr.z);
 	inverseInertia.y = (12.0f * inverseMass) / (dimsSqr.x + dimsSqr.z);
 	inverseInertia.z = (12.0f * inverseMass) / (dimsSqr.x + dimsSqr.y);
+	inertiaDirty = true;
 }
 
 void PhysicsObject::InitSphereInertia() {
@@ -100,13 +149,61 @@ void PhysicsObject::InitSphereInertia() {
 	float i			= 2.5f * inverseMass / (radius*radius);
 
 	inverseInertia	= Vector3(i, i, i);
+	inertiaDirty	= true;
 }
 
+/*
+The world space tensor only changes when the body rotates, so it's
+cached against the transform's orientation version and left alone
+otherwise. Locked axes are folded into the tensor, so a locked body
+can't pick up spin on those axes from torques or contacts either.
+
+Spheres (or anything with equal inertia on every axis) don't care
+about orientation at all, so they're built once and never touched
+again. Bodies with locked axes only need the tensor entries for their
+free axes, which is a lot cheaper than two full matrix multiplies.
+*/
 void PhysicsObject::UpdateInertiaTensor() {
+	unsigned int version = transform->GetOrientationVersion();
+	if (!inertiaDirty && version == inertiaVersion)
+		return;
+
+	bool isotropic = inverseInertia.x == inverseInertia.y && inverseInertia.y == inverseInertia.z;
+	if (isotropic) {
+		if (inertiaDirty)
+			inverseInteriaTensor = Matrix3::Scale(inverseInertia * lockedAxes);
+		inertiaDirty	= false;
+		inertiaVersion	= version;
+		return;
+	}
+
 	Quaternion q = transform->GetOrientation();
-	
-	Matrix3 invOrientation	= Matrix3(q.Conjugate());
-	Matrix3 orientation		= Matrix3(q);
 
-	inverseInteriaTensor = orientation * Matrix3::Scale(inverseInertia) *invOrientation;
+	if (lockedAxes.x == 1.0f && lockedAxes.y == 1.0f && lockedAxes.z == 1.0f) {
+		Matrix3 invOrientation	= Matrix3(q.Conjugate());
+		Matrix3 orientation		= Matrix3(q);
+
+		inverseInteriaTensor = orientation * Matrix3::Scale(inverseInertia) *invOrientation;
+	}
+	else {
+		Matrix3 orientation = Matrix3(q);
+		inverseInteriaTensor = Matrix3::Scale(Vector3(0, 0, 0));
+		// Entry (r, c) of R * I * R^T, skipping any row or column that's locked
+		for (int r = 0; r < 3; ++r) {
+			if (lockedAxes[r] == 0.0f)
+				continue;
+			for (int c = r; c < 3; ++c) {
+				if (lockedAxes[c] == 0.0f)
+					continue;
+				float value = 0.0f;
+				for (int k = 0; k < 3; ++k) {
+					value += orientation.array[k][r] * orientation.array[k][c] * inverseInertia[k];
+				}
+				inverseInteriaTensor.array[c][r] = value;
+				inverseInteriaTensor.array[r][c] = value;
+			}
+		}
+	}
+	inertiaDirty	= false;
+	inertiaVersion	= version;
 }
\ No newline at end of file
@@ -30,6 +30,7 @@ namespace NCL {
 
 			void SetInverseMass(float invMass) {
 				inverseMass = invMass;
+				inertiaDirty = true;
 				if (invMass == 0)
 					sleep = true;
 			}
@@ -69,14 +70,54 @@ namespace NCL {
 			void InitCubeInertia();
 			void InitSphereInertia();
 
+			// Only rebuilds the world space tensor if the orientation has changed since last time
 			void UpdateInertiaTensor();
 
-			Matrix3 GetInertiaTensor() const {
+			const Matrix3& GetInertiaTensor() const {
 				return inverseInteriaTensor;
 			}
 
 			void SetAxisLock(bool x, bool y, bool z) {
 				lockedAxes = Vector3(x ? 0 : 1.0f, y ? 0 : 1.0f, z ? 0 : 1.0f);
+				inertiaDirty = true;
+			}
+
+			/*
+			Level n bodies only have their forces, gravity and damping
+			integrated every 2^n physics substeps. They still move along
+			their velocity every substep, so they don't jump or tunnel, and
+			the forces on them are banked every substep, so none are lost
+			when they're cleared at the end of a frame the body sat out.
+			*/
+			void SetLODLevel(int level) {
+				lodLevel = level;
+			}
+
+			int GetLODLevel() const {
+				return lodLevel;
+			}
+
+			// Banks a substep's worth of time, returns true if the body should integrate this substep
+			bool AdvanceLOD(float dt, int substep);
+
+			/*
+			For a body promoted partway through a substep it had skipped -
+			takes the banked time now, so it can be integrated before the
+			collision is resolved. False if there's nothing banked.
+			*/
+			bool CatchUpLOD();
+
+			// How much time to integrate forces over this substep, 0 if skipped
+			float GetLODStepDT() const {
+				return lodStepDT;
+			}
+
+			// Hands over the forces and torques banked since the body last integrated, times how long each was on for
+			void TakeLODImpulses(Vector3& linear, Vector3& angular) {
+				linear				= lodImpulse;
+				angular				= lodAngularImpulse;
+				lodImpulse			= Vector3();
+				lodAngularImpulse	= Vector3();
 			}
 
 		protected:
@@ -103,6 +144,15 @@ namespace NCL {
 			Vector3 inverseInertia;
 			Matrix3 inverseInteriaTensor;
 			Vector3 lockedAxes;
+
+			unsigned int	inertiaVersion;
+			bool			inertiaDirty;
+
+			int		lodLevel;
+			float	lodTime;
+			float	lodStepDT;
+			Vector3	lodImpulse;
+			Vector3	lodAngularImpulse;
 		};
 	}
 }
@@ -8,6 +8,7 @@
 
 #include "Debug.h"
 #include "Window.h"
+#include "JobSystem.h"
 #include <functional>
 using namespace NCL;
 using namespace CSC8503;
@@ -19,6 +20,7 @@ PhysicsSystem::PhysicsSystem(GameWorld& g) : gameWorld(g)	{
 	globalDamping	= 0.995f;
 	g.SetPhysicsSystem(this);
 	SetGravity(Vector3(0.0f, -9.8f, 0.0f));
+	SetLODDistances(50.0f, 100.0f, 200.0f);
 	octTreePointer = new OctTree<GameObject>(Vector3(1024, 256, 1024), 7, 6);
 }
 
@@ -30,6 +32,13 @@ void PhysicsSystem::SetGravity(const Vector3& g) {
 	gravity = g;
 }
 
+void PhysicsSystem::SetLODDistances(float halfRate, float quarterRate, float eighthRate) {
+	lodDistances[0] = halfRate;
+	lodDistances[1] = quarterRate;
+	lodDistances[2] = eighthRate;
+}
+
+
 void PhysicsSystem::AddObject(GameObject* object) {
 		Vector3 halfSizes;
 
@@ -41,13 +50,37 @@ void PhysicsSystem::AddObject(GameObject* object) {
 		octTreePointer->Insert(object, pos, halfSizes, object->GetPhysicsObject()->GetSleepState());
 }
 
+/*
+Each object keeps a list of who it's currently in the collision list with,
+so removing it only has to touch those pairs rather than rebuilding the
+whole set. The narrowphase can store a pair either way around, so both
+orderings are erased.
+*/
 void PhysicsSystem::RemoveObject(GameObject* object) {
-	std::set<CollisionDetection::CollisionInfo> tempCollisions;
-	for (CollisionDetection::CollisionInfo collision : allCollisions) {
-		if (collision.a != object && collision.b != object)
-			tempCollisions.insert(collision);
+	CollisionDetection::CollisionInfo key;
+	for (GameObject* other : object->GetContacts()) {
+		key.a = object;
+		key.b = other;
+		allCollisions.erase(key);
+		key.a = other;
+		key.b = object;
+		allCollisions.erase(key);
+		other->RemoveContact(object);
+	}
+	object->ClearContacts();
+	object->RemoveFromTree();
+
+	// Order matters here (a pair can begin and end in one batch), so no swap and pop
+	std::erase_if(pendingCollisionEvents, [object](const PendingCollisionEvent& e) {
+		return e.a == object || e.b == object;
+	});
+}
+
+void PhysicsSystem::AddCollision(const CollisionDetection::CollisionInfo& info) {
+	if (allCollisions.insert(info).second) {
+		info.a->AddContact(info.b);
+		info.b->AddContact(info.a);
 	}
-	allCollisions = tempCollisions;
 }
 
 /*
@@ -62,6 +95,7 @@ any collisions they are in.
 */
 void PhysicsSystem::Clear() {
 	allCollisions.clear();
+	pendingCollisionEvents.clear();
 	delete octTreePointer;
 	octTreePointer = new OctTree<GameObject>(Vector3(1024, 256, 1024), 7, 6);
 }
@@ -90,22 +124,27 @@ int realHZ		= idealHZ;
 float realDT	= idealDT;
 
 void PhysicsSystem::Update(float dt) {	
-	if (Window::GetKeyboard()->KeyPressed(KeyboardKeys::B)) {
+	const Keyboard* keyboard = Window::GetKeyboard(); //there's none when running headless
+	if (keyboard && keyboard->KeyPressed(KeyboardKeys::B)) {
 		useBroadPhase = !useBroadPhase;
 		std::cout << "Setting broadphase to " << useBroadPhase << std::endl;
 	}
-	if (Window::GetKeyboard()->KeyPressed(KeyboardKeys::N)) {
+	if (keyboard && keyboard->KeyPressed(KeyboardKeys::N)) {
 		useSimpleContainer = !useSimpleContainer;
 		std::cout << "Setting broad container to " << useSimpleContainer << std::endl;
 	}
-	if (Window::GetKeyboard()->KeyPressed(KeyboardKeys::I)) {
+	if (keyboard && keyboard->KeyPressed(KeyboardKeys::I)) {
 		constraintIterationCount--;
 		std::cout << "Setting constraint iterations to " << constraintIterationCount << std::endl;
 	}
-	if (Window::GetKeyboard()->KeyPressed(KeyboardKeys::O)) {
+	if (keyboard && keyboard->KeyPressed(KeyboardKeys::O)) {
 		constraintIterationCount++;
 		std::cout << "Setting constraint iterations to " << constraintIterationCount << std::endl;
 	}
+	if (keyboard && keyboard->KeyPressed(KeyboardKeys::M)) {
+		useLOD = !useLOD;
+		std::cout << "Setting physics LOD to " << useLOD << std::endl;
+	}
 
 	dTOffset += dt; //We accumulate time delta here - there might be remainders from previous frame!
 
@@ -115,9 +154,12 @@ void PhysicsSystem::Update(float dt) {
 	if (useBroadPhase) {
 		UpdateObjectAABBs();
 	}
+	UpdateLODLevels();
+
 	int iteratorCount = 0;
 	while(dTOffset > realDT) {
-		IntegrateAccel(realDT); //Update accelerations from external forces
+		UpdateLODSteps(realDT); //Work out which bodies integrate this substep
+		IntegrateAccel(); //Update accelerations from external forces
 		if (useBroadPhase) {
 			BroadPhase(iteratorCount == 0 ? true : false);
 			NarrowPhase();
@@ -147,6 +189,9 @@ void PhysicsSystem::Update(float dt) {
 	t.Tick();
 	float updateTime = t.GetTimeDeltaSeconds();
 
+	if (fixedRate) {
+		return;
+	}
 	//Uh oh, physics is taking too long...
 	if (updateTime > realDT) {
 		realHZ /= 2;
@@ -168,6 +213,88 @@ void PhysicsSystem::Update(float dt) {
 	}
 }
 
+/*
+Bodies far away from every goat don't need simulating at the full rate,
+nobody's there to see it. Every player in a networked game has a goat in
+the world, so this covers what each client is interested in too.
+Anything touching a full rate body has to keep up with it though, or it'd
+sink into it between its own steps, so those get promoted back up.
+*/
+void PhysicsSystem::UpdateLODLevels() {
+	std::vector<GameObject*>::const_iterator first, last;
+	gameWorld.GetObjectIterators(first, last);
+
+	for (auto i = first; i != last; i++) {
+		PhysicsObject* object = (*i)->GetPhysicsObject();
+		if (object == nullptr)
+			continue;
+		if (!useLOD || gameWorld.playerGoats.empty() || object->GetInverseMass() == 0) {
+			object->SetLODLevel(0);
+			continue;
+		}
+		Vector3 position = (*i)->GetTransform().GetPosition();
+		float nearest = FLT_MAX;
+		for (GameObject* goat : gameWorld.playerGoats) {
+			nearest = std::min(nearest, (goat->GetTransform().GetPosition() - position).LengthSquared());
+		}
+		int level = 0;
+		while (level < 3 && nearest > lodDistances[level] * lodDistances[level]) {
+			level++;
+		}
+		object->SetLODLevel(level);
+	}
+
+	for (auto i = first; i != last; i++) {
+		for (GameObject* other : (*i)->GetContacts()) {
+			PromoteLOD(**i, *other);
+		}
+	}
+}
+
+void PhysicsSystem::UpdateLODSteps(float dt) {
+	std::vector<GameObject*>::const_iterator first, last;
+	gameWorld.GetObjectIterators(first, last);
+
+	for (auto i = first; i != last; i++) {
+		PhysicsObject* object = (*i)->GetPhysicsObject();
+		if (object == nullptr)
+			continue;
+		// Offset by world ID so reduced rate bodies are spread across the substeps - unlike
+		// the index, it doesn't change when other objects are removed or shuffled
+		object->AdvanceLOD(dt, lodSubstep + (*i)->GetWorldID());
+	}
+	lodSubstep++;
+}
+
+/*
+Collisions are found after this substep's forces were integrated, so a
+body promoted by one (midStep) has missed them if it was sitting the
+substep out. It gets everything it banked integrated there and then,
+before the collision is resolved, rather than a substep late.
+*/
+void PhysicsSystem::PromoteLOD(GameObject& a, GameObject& b, bool midStep) {
+	PhysicsObject* physA = a.GetPhysicsObject();
+	PhysicsObject* physB = b.GetPhysicsObject();
+	bool fullRateA = physA->GetLODLevel() == 0 && physA->GetInverseMass() > 0;
+	bool fullRateB = physB->GetLODLevel() == 0 && physB->GetInverseMass() > 0;
+	if (fullRateA) {
+		PromoteLOD(*physB, midStep);
+	}
+	if (fullRateB) {
+		PromoteLOD(*physA, midStep);
+	}
+}
+
+void PhysicsSystem::PromoteLOD(PhysicsObject& object, bool midStep) {
+	if (object.GetLODLevel() == 0) {
+		return;
+	}
+	object.SetLODLevel(0);
+	if (midStep && object.CatchUpLOD()) {
+		IntegrateAccel(object, object.GetLODStepDT());
+	}
+}
+
 void PhysicsSystem::CheckSleeping(float dt) {
 	std::vector<GameObject*>::const_iterator first, last;
 	gameWorld.GetObjectIterators(first, last);
@@ -194,16 +321,16 @@ rocket launcher, gaining a point when the player hits the gold coin, and so on).
 void PhysicsSystem::UpdateCollisionList() {
 	for (std::set<CollisionDetection::CollisionInfo>::iterator i = allCollisions.begin(); i != allCollisions.end(); ) {
 		if ((*i).framesLeft == numCollisionFrames) {
-			i->a->OnCollisionBegin(i->b);
-			i->b->OnCollisionBegin(i->a);
+			CollisionEvent(i->a, i->b, true);
 		}
 
 		CollisionDetection::CollisionInfo& in = const_cast<CollisionDetection::CollisionInfo&>(*i);
 		in.framesLeft--;
 
 		if ((*i).framesLeft < 0) {
-			i->a->OnCollisionEnd(i->b);
-			i->b->OnCollisionEnd(i->a);
+			CollisionEvent(i->a, i->b, false);
+			i->a->RemoveContact(i->b);
+			i->b->RemoveContact(i->a);
 			i = allCollisions.erase(i);
 		}
 		else {
@@ -212,11 +339,50 @@ void PhysicsSystem::UpdateCollisionList() {
 	}
 }
 
+void PhysicsSystem::CollisionEvent(GameObject* a, GameObject* b, bool begin) {
+	if (deferCollisionEvents) {
+		pendingCollisionEvents.push_back({ a, b, begin });
+		return;
+	}
+	if (begin) {
+		a->OnCollisionBegin(b);
+		b->OnCollisionBegin(a);
+	}
+	else {
+		a->OnCollisionEnd(b);
+		b->OnCollisionEnd(a);
+	}
+}
+
+void PhysicsSystem::DispatchCollisionEvents() {
+	bool deferred = deferCollisionEvents;
+	deferCollisionEvents = false;
+	for (const PendingCollisionEvent& e : pendingCollisionEvents) {
+		CollisionEvent(e.a, e.b, e.begin);
+	}
+	pendingCollisionEvents.clear();
+	deferCollisionEvents = deferred;
+}
+
 void PhysicsSystem::UpdateObjectAABBs() {
-	std::vector<GameObject*>::const_iterator first, last;
-	gameWorld.GetObjectIterators(first, last);
-	for (auto i = first; i != last; i++)
-		(*i)->UpdateBroadphaseAABB();
+	ForEachObject([](GameObject* o) {
+		o->UpdateBroadphaseAABB();
+	});
+}
+
+/*
+Runs func over every object, spread across the world's job system if
+it has one. Only safe for work that touches nothing but the object
+it's given!
+*/
+void PhysicsSystem::ForEachObject(const std::function<void(GameObject*)>& func) {
+	JobSystem* jobs = gameWorld.GetJobSystem();
+	if (!jobs) {
+		for (GameObject* o : gameWorld.gameObjects)
+			func(o);
+		return;
+	}
+	jobs->ParallelFor(std::span<GameObject*>(gameWorld.gameObjects), func);
 }
 
 /*
@@ -245,9 +411,10 @@ void PhysicsSystem::BasicCollisionDetection() {
 			totalCount++;
 			if (CollisionDetection::ObjectIntersection(*i, *j, info)) {
 				count--;
+				PromoteLOD(*info.a, *info.b, true);
 				ImpulseResolveCollision(*info.a, *info.b, info.point);
 				info.framesLeft = numCollisionFrames;
-				allCollisions.insert(info);
+				AddCollision(info);
 			}
 		}
 	}
@@ -276,6 +443,10 @@ void PhysicsSystem::ImpulseResolveCollision(GameObject& a, GameObject& b, Collis
 
 	transformB.SetPosition(transformB.GetPosition() + (p.normal * p.penetration * (physB->GetInverseMass() / totalMass)));
 
+	// Cheap if neither has rotated since the tensors were last built
+	physA->UpdateInertiaTensor();
+	physB->UpdateInertiaTensor();
+
 	// Calculate impulse
 	Vector3 relativeA = p.localA;
 	Vector3 relativeB = p.localB;
@@ -373,8 +544,9 @@ void PhysicsSystem::BroadPhase(bool firstPass) {
 					// ie. Is the pair already in another QuadTree node together?
 
 					// Give the two objects a fixed order: objects A and B will be in the info in the same order no matter if they are i or j
-					info.a = std::min((*i).object, (*j).object);
-					info.b = std::max((*i).object, (*j).object);
+					bool iFirst = (*i).object->GetWorldID() < (*j).object->GetWorldID();
+					info.a = iFirst ? (*i).object : (*j).object;
+					info.b = iFirst ? (*j).object : (*i).object;
 
 					// C++ sets do not permit duplicate values, Insert will prevent this for us
 					broadphaseCollisions.insert(info);
@@ -401,8 +573,9 @@ void PhysicsSystem::NarrowPhase() {
 		if (CollisionDetection::ObjectIntersection(info.a, info.b, info)) {
 			count--;
 			info.framesLeft = numCollisionFrames;
+			PromoteLOD(*info.a, *info.b, true);
 			ImpulseResolveCollision(*info.a, *info.b, info.point);
-			allCollisions.insert(info); // Insert into main set
+			AddCollision(info); // Insert into main set
 		}
 	}
 }
@@ -415,42 +588,46 @@ without worrying about repeated forces accumulating etc.
 This function will update both linear and angular acceleration,
 based on any forces that have been accumulated in the objects during
 the course of the previous game frame.
-*/
-void PhysicsSystem::IntegrateAccel(float dt) {
-	std::vector<GameObject*>::const_iterator first, last;
-	gameWorld.GetObjectIterators(first, last);
 
-	for (auto i = first; i != last; i++) {
-		PhysicsObject* object = (*i)->GetPhysicsObject();
+Each body integrates over its own LOD step time, which is 0 for bodies
+sitting this substep out.
+*/
+void PhysicsSystem::IntegrateAccel() {
+	ForEachObject([&](GameObject* o) {
+		PhysicsObject* object = o->GetPhysicsObject();
 		if (object == nullptr)
-			continue; // No physics object for this GameObject
+			return; // No physics object for this GameObject
 
 		if (object->GetSleepState())
-			continue;
-		
-		float inverseMass = object->GetInverseMass();
-		Vector3 linearVel = object->GetLinearVelocity();
-		Vector3 force = object->GetForce();
-		Vector3 accel = force * inverseMass;
-		float test = force.Length();
+			return;
 
-		if (applyGravity && inverseMass > 0) // Check mass to not move infinitely heavy things
-			accel += gravity;
+		float dt = object->GetLODStepDT();
+		if (dt == 0.0f)
+			return; // Reduced rate body, not its turn
 
-		linearVel += accel * dt;
-		object->SetLinearVelocity(linearVel);
+		IntegrateAccel(*object, dt);
+	});
+}
 
-		// Angular stuff
-		Vector3 torque = object->GetTorque();
-		Vector3 angVel = object->GetAngularVelocity();
+void PhysicsSystem::IntegrateAccel(PhysicsObject& object, float dt) {
+	float inverseMass = object.GetInverseMass();
+	Vector3 linearVel = object.GetLinearVelocity();
+	// Forces were banked every substep, so they're already multiplied by how long they were on for
+	Vector3 impulse, angularImpulse;
+	object.TakeLODImpulses(impulse, angularImpulse);
 
-		object->UpdateInertiaTensor(); // Update tensor vs orientation
+	linearVel += impulse * inverseMass;
+	if (applyGravity && inverseMass > 0) // Check mass to not move infinitely heavy things
+		linearVel += gravity * dt;
+	object.SetLinearVelocity(linearVel);
 
-		Vector3 angAccel = object->GetInertiaTensor() * torque;
+	// Angular stuff
+	Vector3 angVel = object.GetAngularVelocity();
 
-		angVel += angAccel * dt; // Integrate anglular accel
-		object->SetAngularVelocity(angVel);
-	}
+	object.UpdateInertiaTensor(); // Update tensor vs orientation
+
+	angVel += object.GetInertiaTensor() * angularImpulse; // Integrate anglular accel
+	object.SetAngularVelocity(angVel);
 }
 
 /*
@@ -458,20 +635,21 @@ This function integrates linear and angular velocity into
 position and orientation. It may be called multiple times
 throughout a physics update, to slowly move the objects through
 the world, looking for collisions.
+
+Every awake body moves every substep, reduced rate or not - their
+velocity only changes on their own steps, but in between they carry on
+along it, rather than jumping the whole banked distance at once.
 */
 void PhysicsSystem::IntegrateVelocity(float dt) {
-	std::vector<GameObject*>::const_iterator first, last;
-	gameWorld.GetObjectIterators(first, last);
-
-	float frameLinearDamping = 1.0f - (0.4f * dt);
-
-	for (auto i = first; i != last; i++) {
-		PhysicsObject* object = (*i)->GetPhysicsObject();
+	ForEachObject([&](GameObject* o) {
+		PhysicsObject* object = o->GetPhysicsObject();
 		if (object == nullptr)
-			continue;
+			return;
 		if (object->GetSleepState())
-			continue;
-		Transform& transform = (*i)->GetTransform();
+			return;
+		float lodDT = object->GetLODStepDT(); // Damping goes with the forces, at the body's own rate
+		float frameLinearDamping = 1.0f - (0.4f * lodDT);
+		Transform& transform = o->GetTransform();
 		// Position
 		Vector3 position = transform.GetPosition();
 		Vector3 linearVel = object->GetLinearVelocity();
@@ -483,19 +661,22 @@ void PhysicsSystem::IntegrateVelocity(float dt) {
 		object->SetLinearVelocity(linearVel);
 
 		// Orientation
-		Quaternion orientation = transform.GetOrientation();
 		Vector3 angVel = object->GetAngularVelocity();
 
-		orientation = orientation + (Quaternion(angVel * dt * 0.5f, 0.0f) * orientation);
-		orientation.Normalise();
+		// Don't touch non-spinning bodies, keeps their cached inertia tensor valid
+		if (angVel.x != 0.0f || angVel.y != 0.0f || angVel.z != 0.0f) {
+			Quaternion orientation = transform.GetOrientation();
+			orientation = orientation + (Quaternion(angVel * dt * 0.5f, 0.0f) * orientation);
+			orientation.Normalise();
 
-		transform.SetOrientation(orientation);
+			transform.SetOrientation(orientation);
+		}
 
 		// Dampen the angular velocity too
-		float frameAngularDamping = 1.0f - (0.4f * dt);
+		float frameAngularDamping = 1.0f - (0.4f * lodDT);
 		angVel = angVel * frameAngularDamping;
 		object->SetAngularVelocity(angVel);
-	}
+	});
 }
 
 /*
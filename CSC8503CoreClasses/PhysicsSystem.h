@@ -25,6 +25,38 @@ namespace NCL {
 			void AddObject(GameObject* object);
 
 			void RemoveObject(GameObject* object);
+
+			void UseLOD(bool state) {
+				useLOD = state;
+			}
+
+			// Distances from the nearest goat past which bodies drop to 1/2, 1/4 and 1/8 rate
+			void SetLODDistances(float halfRate, float quarterRate, float eighthRate);
+
+			bool UsingLOD() const {
+				return useLOD;
+			}
+
+			/*
+			When physics runs off the main thread, collision callbacks can't
+			fire mid-update as they'd race with the game code. Deferred events
+			are held until DispatchCollisionEvents is called instead.
+			*/
+			void DeferCollisionEvents(bool state) {
+				deferCollisionEvents = state;
+			}
+
+			void DispatchCollisionEvents();
+
+			/*
+			Normally the number of substeps drops if physics starts taking too
+			long, so how things move depends on how fast the machine is. With
+			a fixed rate it never changes, so the same inputs always give the
+			same results.
+			*/
+			void UseFixedRate(bool state) {
+				fixedRate = state;
+			}
 		protected:
 			void BasicCollisionDetection();
 			void BroadPhase(bool firstPass);
@@ -32,12 +64,22 @@ namespace NCL {
 
 			void ClearForces();
 
-			void IntegrateAccel(float dt);
+			void ForEachObject(const std::function<void(GameObject*)>& func);
+
+			void IntegrateAccel();
+			void IntegrateAccel(PhysicsObject& object, float dt);
 			void IntegrateVelocity(float dt);
 
+			void UpdateLODLevels();
+			void UpdateLODSteps(float dt);
+			void PromoteLOD(GameObject& a, GameObject& b, bool midStep = false);
+			void PromoteLOD(PhysicsObject& object, bool midStep);
+
 			void UpdateConstraints(float dt);
 
 			void UpdateCollisionList();
+			void CollisionEvent(GameObject* a, GameObject* b, bool begin);
+			void AddCollision(const CollisionDetection::CollisionInfo& info);
 			void UpdateObjectAABBs();
 
 			void ImpulseResolveCollision(GameObject& a , GameObject&b, CollisionDetection::ContactPoint& p) const;
@@ -57,6 +99,19 @@ namespace NCL {
 			std::set<CollisionDetection::CollisionInfo> broadphaseCollisions;
 			bool useBroadPhase		= true;
 			int numCollisionFrames	= 5;
+
+			bool	useLOD			= true;
+			float	lodDistances[3];
+			int		lodSubstep		= 0;
+
+			struct PendingCollisionEvent {
+				GameObject* a;
+				GameObject* b;
+				bool		begin;
+			};
+			bool deferCollisionEvents = false;
+			bool fixedRate = false;
+			std::vector<PendingCollisionEvent> pendingCollisionEvents;
 		};
 	}
 }
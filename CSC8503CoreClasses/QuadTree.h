@@ -97,24 +97,24 @@ namespace NCL {
 					pos + Vector3(-size.x, -20, -size.y)
 				};
 
-				Debug::DrawLine(vertexes[0], vertexes[1]);
-				Debug::DrawLine(vertexes[0], vertexes[2]);
-				Debug::DrawLine(vertexes[0], vertexes[4]);
+				Debug::DrawLine<Debug::Spatial>(vertexes[0], vertexes[1]);
+				Debug::DrawLine<Debug::Spatial>(vertexes[0], vertexes[2]);
+				Debug::DrawLine<Debug::Spatial>(vertexes[0], vertexes[4]);
 
-				Debug::DrawLine(vertexes[1], vertexes[3]);
-				Debug::DrawLine(vertexes[1], vertexes[5]);
+				Debug::DrawLine<Debug::Spatial>(vertexes[1], vertexes[3]);
+				Debug::DrawLine<Debug::Spatial>(vertexes[1], vertexes[5]);
 
-				Debug::DrawLine(vertexes[2], vertexes[3]);
-				Debug::DrawLine(vertexes[2], vertexes[6]);
+				Debug::DrawLine<Debug::Spatial>(vertexes[2], vertexes[3]);
+				Debug::DrawLine<Debug::Spatial>(vertexes[2], vertexes[6]);
 
-				Debug::DrawLine(vertexes[3], vertexes[7]);
+				Debug::DrawLine<Debug::Spatial>(vertexes[3], vertexes[7]);
 
-				Debug::DrawLine(vertexes[4], vertexes[5]);
-				Debug::DrawLine(vertexes[4], vertexes[6]);
+				Debug::DrawLine<Debug::Spatial>(vertexes[4], vertexes[5]);
+				Debug::DrawLine<Debug::Spatial>(vertexes[4], vertexes[6]);
 
-				Debug::DrawLine(vertexes[5], vertexes[7]);
+				Debug::DrawLine<Debug::Spatial>(vertexes[5], vertexes[7]);
 
-				Debug::DrawLine(vertexes[6], vertexes[7]);
+				Debug::DrawLine<Debug::Spatial>(vertexes[6], vertexes[7]);
 			}
 
 			void OperateOnContents(QuadTreeFunc& func) {
@@ -15,6 +15,10 @@ namespace NCL {
 					func(dt);
 				}
 			}
+
+			const StateUpdateFunction& GetFunction() const {
+				return func;
+			}
 		protected:
 			StateUpdateFunction func;
 		};
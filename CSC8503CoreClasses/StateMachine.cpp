@@ -2,10 +2,14 @@
 #include "State.h"
 #include "StateTransition.h"
 
+#include <algorithm>
+#include <unordered_map>
+
 using namespace NCL::CSC8503;
 
 StateMachine::StateMachine()	{
-	activeState = nullptr;
+	activeState	= -1;
+	compiled	= true;
 }
 
 StateMachine::~StateMachine()	{
@@ -13,33 +17,86 @@ StateMachine::~StateMachine()	{
 		delete i;
 	}
 	for (auto& i : allTransitions) {
-		delete i.second;
+		delete i;
 	}
 }
 
 void StateMachine::AddState(State* s) {
 	allStates.emplace_back(s);
-	if (activeState == nullptr) {
-		activeState = s;
+	if (activeState == -1) {
+		activeState = 0;
 	}
+	compiled = false;
 }
 
-void StateMachine::AddTransition(StateTransition* t) {
-	allTransitions.insert(std::make_pair(t->GetSourceState(), t));
+void StateMachine::AddTransition(StateTransition* t, int priority) {
+	allTransitions.emplace_back(t);
+	transitionPriorities.emplace_back(priority);
+	compiled = false;
+}
+
+/*
+States are only ever added, so the active state's index is still good
+after compiling again.
+*/
+void StateMachine::Compile() {
+	std::unordered_map<const State*, int> stateIndices;
+	for (int i = 0; i < (int)allStates.size(); ++i) {
+		stateIndices[allStates[i]] = i;
+	}
+
+	// Grouped by source state, then highest priority first, keeping the order they were added in otherwise
+	std::vector<int> order;
+	std::vector<int> sources(allTransitions.size(), -1);
+	for (int i = 0; i < (int)allTransitions.size(); ++i) {
+		auto source	= stateIndices.find(allTransitions[i]->GetSourceState());
+		auto dest	= stateIndices.find(allTransitions[i]->GetDestinationState());
+		if (source == stateIndices.end() || dest == stateIndices.end()) {
+			continue; // Leads to or from a state that isn't in this machine
+		}
+		sources[i] = source->second;
+		order.push_back(i);
+	}
+	std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+		if (sources[a] != sources[b]) {
+			return sources[a] < sources[b];
+		}
+		return transitionPriorities[a] > transitionPriorities[b];
+	});
+
+	states.clear();
+	for (State* s : allStates) {
+		states.push_back({ s->GetFunction(), 0, 0 });
+	}
+	transitions.clear();
+	for (int i : order) {
+		CompiledState& source = states[sources[i]];
+		if (source.transitionCount == 0) {
+			source.firstTransition = (int)transitions.size();
+		}
+		source.transitionCount++;
+		transitions.push_back({ allTransitions[i]->GetFunction(), stateIndices[allTransitions[i]->GetDestinationState()] });
+	}
+	compiled = true;
 }
 
 void StateMachine::Update(float dt) {
-	if (activeState) {
-		activeState->Update(dt);
-	
-		//Get the transition set starting from this state node;
-		std::pair<TransitionIterator, TransitionIterator> range = allTransitions.equal_range(activeState);
-
-		for (auto& i = range.first; i != range.second; ++i) {
-			if (i->second->CanTransition()) {
-				State* newState = i->second->GetDestinationState();
-				activeState = newState;
-			}
+	if (!compiled) {
+		Compile();
+	}
+	if (activeState == -1) {
+		return;
+	}
+	const CompiledState& state = states[activeState];
+	if (state.func) {
+		state.func(dt);
+	}
+	const CompiledTransition* t		= transitions.data() + state.firstTransition;
+	const CompiledTransition* end	= t + state.transitionCount;
+	for (; t != end; ++t) {
+		if (t->guard()) {
+			activeState = t->destination;
+			break;
 		}
 	}
-}
\ No newline at end of file
+}
@@ -1,28 +1,53 @@
 #pragma once
+#include "State.h"
+#include "StateTransition.h"
 
 namespace NCL {
 	namespace CSC8503 {
-		class State;
-		class StateTransition;
-
-		typedef std::multimap<State*, StateTransition*> TransitionContainer;
-		typedef TransitionContainer::iterator TransitionIterator;
+		/*
+		States and transitions are added as separate objects, but the first
+		Update after any are added compiles them down into two flat arrays.
+		Each state knows where its own transitions start in the transition
+		array and how many there are, so an update is a single run along one
+		short stretch of it, with no lookups.
 
+		Transitions out of a state are checked highest priority first (in
+		the order they were added for equal priorities), and only the first
+		one that passes is taken.
+		*/
 		class StateMachine	{
 		public:
 			StateMachine();
 			virtual ~StateMachine(); //made it virtual!
 
 			void AddState(State* s);
-			void AddTransition(StateTransition* t);
+			void AddTransition(StateTransition* t, int priority = 0);
 
 			virtual void Update(float dt); //made it virtual!
 
 		protected:
-			State * activeState;
+			void Compile();
+
+			struct CompiledState {
+				StateUpdateFunction	func;
+				int					firstTransition;
+				int					transitionCount;
+			};
+
+			struct CompiledTransition {
+				StateTransitionFunction	guard;
+				int						destination;
+			};
+
+			std::vector<State*>				allStates;
+			std::vector<StateTransition*>	allTransitions;
+			std::vector<int>				transitionPriorities;
+
+			std::vector<CompiledState>		states;
+			std::vector<CompiledTransition>	transitions;
 
-			std::vector<State*> allStates;
-			TransitionContainer allTransitions;
+			int		activeState;	// Index into states, -1 if there are none
+			bool	compiled;
 		};
 	}
-}
\ No newline at end of file
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include <algorithm>
+#include <vector>
+
+namespace NCL {
+	namespace CSC8503 {
+		/*
+		A state machine for when there's lots of agents of the same type.
+		The table of states and transitions is built once and shared by all
+		of them, with each agent only keeping the index of its active state.
+		States and guards are plain function pointers taking the agent, so
+		there's no std::function or captured this in there - lambdas without
+		captures convert to them, and have the same access to the agent's
+		protected members as the member function they're written in.
+
+		As with StateMachine, transitions out of a state are checked highest
+		priority first, and only the first one that passes is taken.
+		*/
+		template <typename Context>
+		class StateTable {
+		public:
+			typedef void (*StateFunc)(Context&, float);
+			typedef bool (*GuardFunc)(Context&);
+
+			// Returns the new state's index. The first state added is where agents start
+			int AddState(StateFunc func = nullptr) {
+				states.push_back({ func, 0, 0 });
+				return (int)states.size() - 1;
+			}
+
+			void AddTransition(int from, int to, GuardFunc guard, int priority = 0) {
+				pending.push_back({ from, to, guard, priority });
+			}
+
+			// Groups the transitions by state. Must be called once everything has been added, before any Update
+			void Compile() {
+				std::stable_sort(pending.begin(), pending.end(), [](const PendingTransition& a, const PendingTransition& b) {
+					if (a.from != b.from) {
+						return a.from < b.from;
+					}
+					return a.priority > b.priority;
+				});
+				transitions.clear();
+				for (State& s : states) {
+					s.transitionCount = 0;
+				}
+				for (const PendingTransition& p : pending) {
+					State& source = states[p.from];
+					if (source.transitionCount == 0) {
+						source.firstTransition = (int)transitions.size();
+					}
+					source.transitionCount++;
+					transitions.push_back({ p.guard, p.to });
+				}
+			}
+
+			// Runs the agent's active state, then takes the first transition out of it that passes
+			void Update(Context& context, int& activeState, float dt) const {
+				const State& state = states[activeState];
+				if (state.func) {
+					state.func(context, dt);
+				}
+				const Transition* t		= transitions.data() + state.firstTransition;
+				const Transition* end	= t + state.transitionCount;
+				for (; t != end; ++t) {
+					if (t->guard(context)) {
+						activeState = t->destination;
+						return;
+					}
+				}
+			}
+
+			int GetStateCount() const {
+				return (int)states.size();
+			}
+
+		protected:
+			struct State {
+				StateFunc	func;
+				int			firstTransition;
+				int			transitionCount;
+			};
+
+			struct Transition {
+				GuardFunc	guard;
+				int			destination;
+			};
+
+			struct PendingTransition {
+				int			from;
+				int			to;
+				GuardFunc	guard;
+				int			priority;
+			};
+
+			std::vector<State>				states;
+			std::vector<Transition>			transitions;
+			std::vector<PendingTransition>	pending;
+		};
+	}
+}
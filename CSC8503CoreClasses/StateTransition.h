@@ -24,6 +24,10 @@ namespace NCL {
 				return sourceState;
 			}
 
+			const StateTransitionFunction& GetFunction() const {
+				return function;
+			}
+
 		protected:
 			State * sourceState;
 			State * destinationState;
@@ -4,6 +4,7 @@ using namespace NCL::CSC8503;
 
 Transform::Transform()	{
 	scale = Vector3(1, 1, 1);
+	orientationVersion = 0;
 }
 
 Transform::~Transform()	{
@@ -31,6 +32,7 @@ Transform& Transform::SetScale(const Vector3& worldScale) {
 
 Transform& Transform::SetOrientation(const Quaternion& worldOrientation) {
 	orientation = worldOrientation;
+	orientationVersion++;
 	UpdateMatrix();
 	return *this;
 }
\ No newline at end of file
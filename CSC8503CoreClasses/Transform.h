@@ -31,6 +31,11 @@ namespace NCL {
 			Matrix4 GetMatrix() const {
 				return matrix;
 			}
+
+			// Bumped every time the orientation is set, so dependent data can tell if it's stale
+			unsigned int GetOrientationVersion() const {
+				return orientationVersion;
+			}
 			void UpdateMatrix();
 		protected:
 			Matrix4		matrix;
@@ -38,6 +43,8 @@ namespace NCL {
 			Vector3		position;
 
 			Vector3		scale;
+
+			unsigned int orientationVersion;
 		};
 	}
 }
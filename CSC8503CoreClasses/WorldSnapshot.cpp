@@ -0,0 +1,41 @@
+#include "WorldSnapshot.h"
+#include "GameWorld.h"
+#include "GameObject.h"
+#include "PhysicsObject.h"
+#include "RenderObject.h"
+
+using namespace NCL;
+using namespace CSC8503;
+
+void WorldSnapshot::Capture(const GameWorld& world) {
+	objects.clear(); // Keeps its capacity, so this doesn't allocate once warmed up
+	worldStateID = world.GetWorldStateID();
+
+	GameObjectIterator first, last;
+	world.GetObjectIterators(first, last);
+
+	for (auto i = first; i != last; ++i) {
+		GameObject* o = *i;
+		if (!o->IsActive()) {
+			continue;
+		}
+		const RenderObject* render	= o->GetRenderObject();
+		NetworkObject* network		= o->GetNetworkObject();
+		if (!render && !network) {
+			continue;
+		}
+		ObjectSnapshot& s	= objects.emplace_back();
+		s.renderObject		= render;
+		s.networkObject		= network;
+
+		const Transform& t	= o->GetTransform();
+		s.modelMatrix		= t.GetMatrix();
+		s.position			= t.GetPosition();
+		s.orientation		= t.GetOrientation();
+		s.colour			= render ? render->GetColour() : Vector4(1, 1, 1, 1);
+
+		PhysicsObject* physics = o->GetPhysicsObject();
+		s.linearVelocity	= physics ? physics->GetLinearVelocity() : Vector3();
+		s.angularVelocity	= physics ? physics->GetAngularVelocity() : Vector3();
+	}
+}
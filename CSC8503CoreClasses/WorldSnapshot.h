@@ -0,0 +1,50 @@
+#pragma once
+#include <vector>
+
+using namespace NCL::Maths;
+
+namespace NCL {
+	namespace CSC8503 {
+		class GameWorld;
+		class RenderObject;
+		class NetworkObject;
+
+		/*
+		A frozen copy of everything the renderer and network code need from
+		an object, so they can keep working from it while physics moves the
+		live objects on to the next step.
+		*/
+		struct ObjectSnapshot {
+			const RenderObject*	renderObject;
+			NetworkObject*		networkObject;
+
+			Matrix4		modelMatrix;
+			Vector4		colour;
+
+			Vector3		position;
+			Quaternion	orientation;
+			Vector3		linearVelocity;
+			Vector3		angularVelocity;
+		};
+
+		class WorldSnapshot {
+		public:
+			WorldSnapshot() : worldStateID(0) {}
+
+			// Only active objects that are drawn or networked are kept
+			void Capture(const GameWorld& world);
+
+			const std::vector<ObjectSnapshot>& GetObjects() const {
+				return objects;
+			}
+
+			int GetWorldStateID() const {
+				return worldStateID;
+			}
+
+		protected:
+			std::vector<ObjectSnapshot> objects;
+			int worldStateID;
+		};
+	}
+}
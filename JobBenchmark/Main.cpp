@@ -0,0 +1,241 @@
+#include "JobSystem.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <numeric>
+
+using namespace NCL;
+
+/*
+Hammers the job system to check it still gets every job right under
+contention, then measures how long a job takes to get run and how many
+can be got through a second.
+
+	JobBenchmark [workers] [rounds]
+
+workers is 0 for one per hardware thread, as the game uses. The stress
+tests are repeated rounds times, and the program exits with 1 if any of
+them go wrong. It's also the thing to build with -fsanitize=thread, to
+check the queues and counters for races:
+
+	cmake -S . -B tsan -DCMAKE_CXX_FLAGS=-fsanitize=thread -DCMAKE_EXE_LINKER_FLAGS=-fsanitize=thread
+	cmake --build tsan --target JobBenchmark && ./tsan/JobBenchmark/JobBenchmark 0 4
+*/
+
+typedef std::chrono::high_resolution_clock Clock;
+
+static double MicrosecondsSince(Clock::time_point start) {
+	return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+}
+
+static int failures = 0;
+
+static void Check(bool passed, const char* test, long long got, long long expected) {
+	if (!passed) {
+		std::printf("  FAILED %s: got %lld, expected %lld\n", test, got, expected);
+		failures++;
+	}
+}
+
+// Lots of jobs that do next to nothing, so they're all fighting over the queues
+static void TinyJobs(JobSystem& jobs) {
+	const int count = 100000;
+	std::atomic<int> done = 0;
+	JobCounter counter;
+	for (int i = 0; i < count; ++i) {
+		jobs.Run([&]() { done.fetch_add(1, std::memory_order_relaxed); }, &counter);
+	}
+	jobs.Wait(counter);
+	Check(done == count, "tiny jobs", done, count);
+}
+
+/*
+Every job queues more jobs from inside a worker and waits on them there,
+so workers are pushing onto their own queues and stealing from each
+other, while waiting themselves.
+*/
+static void Spawn(JobSystem& jobs, std::atomic<int>& done, int depth, int fanOut) {
+	done.fetch_add(1, std::memory_order_relaxed);
+	if (depth == 0) {
+		return;
+	}
+	JobCounter children;
+	for (int i = 0; i < fanOut; ++i) {
+		jobs.Run([&jobs, &done, depth, fanOut]() { Spawn(jobs, done, depth - 1, fanOut); }, &children);
+	}
+	jobs.Wait(children);
+}
+
+static void NestedJobs(JobSystem& jobs) {
+	const int depth		= 6;
+	const int fanOut	= 6;
+	int expected = 0;
+	for (int level = 0, n = 1; level <= depth; ++level, n *= fanOut) {
+		expected += n;
+	}
+	std::atomic<int> done = 0;
+	JobCounter counter;
+	jobs.Run([&]() { Spawn(jobs, done, depth, fanOut); }, &counter);
+	jobs.Wait(counter);
+	Check(done == expected, "nested jobs", done, expected);
+}
+
+// A chain of groups, each only allowed to start once the one before has completely finished
+static void Dependencies(JobSystem& jobs) {
+	const int stages	= 64;
+	const int perStage	= 32;
+	std::vector<JobCounter> counters(stages);
+	std::atomic<int> finished	= 0;
+	std::atomic<int> outOfOrder	= 0;
+	for (int s = 0; s < stages; ++s) {
+		for (int j = 0; j < perStage; ++j) {
+			auto job = [&, s]() {
+				if (finished.load() < s * perStage) {
+					outOfOrder++;
+				}
+				finished++;
+			};
+			if (s == 0) {
+				jobs.Run(job, &counters[s]);
+			}
+			else {
+				jobs.RunAfter(counters[s - 1], job, &counters[s]);
+			}
+		}
+	}
+	for (JobCounter& c : counters) {
+		jobs.Wait(c);
+	}
+	Check(finished == stages * perStage, "dependencies ran", finished, stages * perStage);
+	Check(outOfOrder == 0, "dependencies in order", outOfOrder, 0);
+}
+
+// Every item touched exactly once, including by ParallelFors started from inside another one
+static void ParallelFors(JobSystem& jobs) {
+	const int outer = 64;
+	const int inner = 4096;
+	std::vector<std::vector<int>> items(outer, std::vector<int>(inner, 0));
+	jobs.ParallelFor(std::span<std::vector<int>>(items), [&](std::vector<int>& row) {
+		jobs.ParallelFor(std::span<int>(row), [](int& item) { item++; }, 256);
+	}, 4);
+
+	long long total = 0;
+	int wrong = 0;
+	for (const std::vector<int>& row : items) {
+		for (int item : row) {
+			total += item;
+			wrong += item != 1;
+		}
+	}
+	Check(wrong == 0, "parallel for", total, (long long)outer * inner);
+}
+
+// Threads that aren't workers all queuing and waiting at once, as the game and network threads can
+static void ExternalThreads(JobSystem& jobs) {
+	const int threads		= 4;
+	const int perThread		= 20000;
+	std::atomic<int> done = 0;
+	std::vector<std::thread> callers;
+	for (int t = 0; t < threads; ++t) {
+		callers.emplace_back([&]() {
+			for (int batch = 0; batch < perThread / 100; ++batch) {
+				JobCounter counter;
+				for (int i = 0; i < 100; ++i) {
+					jobs.Run([&]() { done.fetch_add(1, std::memory_order_relaxed); }, &counter);
+				}
+				jobs.Wait(counter);
+			}
+		});
+	}
+	for (std::thread& t : callers) {
+		t.join();
+	}
+	Check(done == threads * perThread, "external threads", done, threads * perThread);
+}
+
+// Round trip of a single job from the calling thread, with the workers either busy spinning up or asleep
+static void Latency(JobSystem& jobs, bool idle) {
+	const int samples = idle ? 500 : 20000;
+	std::vector<double> times;
+	times.reserve(samples);
+	for (int i = 0; i < samples; ++i) {
+		if (idle) {
+			std::this_thread::sleep_for(std::chrono::microseconds(500)); //give the workers time to go to sleep
+		}
+		JobCounter counter;
+		Clock::time_point start = Clock::now();
+		jobs.Run([]() {}, &counter);
+		jobs.Wait(counter);
+		times.push_back(MicrosecondsSince(start));
+	}
+	std::sort(times.begin(), times.end());
+	std::printf("  %-28s median %8.2f us   p99 %8.2f us\n", idle ? "Run + Wait, workers asleep" : "Run + Wait, back to back",
+		times[samples / 2], times[(samples * 99) / 100]);
+}
+
+static void JobThroughput(JobSystem& jobs) {
+	const int count = 200000;
+	std::atomic<int> done = 0;
+	JobCounter counter;
+	Clock::time_point start = Clock::now();
+	for (int i = 0; i < count; ++i) {
+		jobs.Run([&]() { done.fetch_add(1, std::memory_order_relaxed); }, &counter);
+	}
+	jobs.Wait(counter);
+	double us = MicrosecondsSince(start);
+	std::printf("  %-28s %8.2f M jobs/s     %8.3f us/job\n", "Empty jobs", count / us, us / count);
+}
+
+// Some made up work per item, about as much as a cheap agent update
+static void ParallelForThroughput(JobSystem& jobs, size_t grainSize) {
+	std::vector<float> items(1 << 20);
+	std::iota(items.begin(), items.end(), 0.0f);
+	auto work = [](float& f) {
+		for (int i = 0; i < 16; ++i) {
+			f = f * 0.999f + 1.0f;
+		}
+	};
+
+	// One batch the size of everything just runs on the calling thread, the same code without the jobs
+	Clock::time_point start = Clock::now();
+	jobs.ParallelFor(std::span<float>(items), work, items.size());
+	double serial = MicrosecondsSince(start);
+
+	start = Clock::now();
+	jobs.ParallelFor(std::span<float>(items), work, grainSize);
+	double parallel = MicrosecondsSince(start);
+
+	std::printf("  ParallelFor, grain %-8zu %8.2f M items/s   %5.2fx serial\n",
+		grainSize, items.size() / parallel, serial / parallel);
+}
+
+int main(int argc, char** argv) {
+	unsigned int workers	= argc > 1 ? (unsigned int)std::atoi(argv[1]) : 0;
+	int rounds				= argc > 2 ? std::atoi(argv[2]) : 10;
+
+	JobSystem jobs(workers);
+	std::printf("Job system: %u workers, %u hardware threads\n\n", jobs.GetWorkerCount(), std::thread::hardware_concurrency());
+
+	std::printf("Stress tests, %d rounds\n", rounds);
+	Clock::time_point start = Clock::now();
+	for (int i = 0; i < rounds; ++i) {
+		TinyJobs(jobs);
+		NestedJobs(jobs);
+		Dependencies(jobs);
+		ParallelFors(jobs);
+		ExternalThreads(jobs);
+	}
+	std::printf("  %s in %.1f ms\n\n", failures == 0 ? "All passed" : "FAILED", MicrosecondsSince(start) / 1000.0);
+
+	std::printf("Latency\n");
+	Latency(jobs, false);
+	Latency(jobs, true);
+
+	std::printf("\nThroughput\n");
+	JobThroughput(jobs);
+	for (size_t grain : { 64, 1024, 16384 }) {
+		ParallelForThroughput(jobs, grain);
+	}
+	return failures == 0 ? 0 : 1;
+}
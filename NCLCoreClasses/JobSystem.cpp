@@ -0,0 +1,195 @@
+#include "JobSystem.h"
+
+using namespace NCL;
+
+namespace {
+	// Which system and queue the current thread is working for, if any
+	thread_local const JobSystem*	threadSystem	= nullptr;
+	thread_local unsigned int		threadQueue		= 0;
+}
+
+static unsigned int ResolveWorkerCount(unsigned int requested) {
+	if (requested > 0) {
+		return requested;
+	}
+	unsigned int hardware = std::thread::hardware_concurrency();
+	return hardware > 1 ? hardware - 1 : 1;
+}
+
+JobSystem::JobSystem(unsigned int workerCount) : queues(ResolveWorkerCount(workerCount)) {
+	queuedJobs	= 0;
+	nextQueue	= 0;
+	running		= true;
+
+	workers.reserve(queues.size());
+	for (unsigned int i = 0; i < queues.size(); ++i) {
+		workers.emplace_back(&JobSystem::WorkerLoop, this, i);
+	}
+}
+
+JobSystem::~JobSystem() {
+	{
+		std::lock_guard<std::mutex> guard(sleepLock);
+		running = false;
+	}
+	sleepCondition.notify_all();
+	for (std::thread& t : workers) {
+		t.join();
+	}
+}
+
+bool JobSystem::IsWorkerThread() const {
+	return threadSystem == this;
+}
+
+void JobSystem::Run(JobFunc func, JobCounter* counter) {
+	if (counter) {
+		counter->count.fetch_add(1, std::memory_order_relaxed);
+	}
+	Push(Job{ std::move(func), counter });
+}
+
+void JobSystem::RunAfter(JobCounter& dependency, JobFunc func, JobCounter* counter) {
+	if (counter) {
+		counter->count.fetch_add(1, std::memory_order_relaxed);
+	}
+	{
+		// Finish takes this lock before running continuations, so either we
+		// get in before the dependency completes, or we see it's already done
+		std::lock_guard<std::mutex> guard(dependency.continuationLock);
+		if (!dependency.IsDone()) {
+			dependency.continuations.push_back(Job{ std::move(func), counter });
+			return;
+		}
+	}
+	Push(Job{ std::move(func), counter });
+}
+
+void JobSystem::Wait(JobCounter& counter) {
+	while (!counter.IsDone()) {
+		Job job;
+		if (FindJob(job)) {
+			Execute(job);
+		}
+		else {
+			std::this_thread::yield();
+		}
+	}
+	// The last Finish on this counter might still be holding its lock, once
+	// we've had it too the counter is ours again and safe to destroy
+	std::lock_guard<std::mutex> guard(counter.continuationLock);
+}
+
+/*
+Workers push onto their own queue, anyone else round-robins across
+the workers' queues so a burst of jobs from the main thread is spread
+out without needing to be stolen first.
+*/
+void JobSystem::Push(Job&& job) {
+	unsigned int index;
+	if (IsWorkerThread()) {
+		index = threadQueue;
+	}
+	else {
+		index = nextQueue.fetch_add(1, std::memory_order_relaxed) % (unsigned int)queues.size();
+	}
+	{
+		std::lock_guard<std::mutex> guard(queues[index].lock);
+		queues[index].jobs.push_back(std::move(job));
+	}
+	queuedJobs.fetch_add(1, std::memory_order_release);
+	{
+		// Empty lock, stops the notify slipping between a worker's check and its wait
+		std::lock_guard<std::mutex> guard(sleepLock);
+	}
+	sleepCondition.notify_one();
+}
+
+bool JobSystem::Pop(unsigned int index, Job& job) {
+	WorkQueue& queue = queues[index];
+	std::lock_guard<std::mutex> guard(queue.lock);
+	if (queue.jobs.empty()) {
+		return false;
+	}
+	job = std::move(queue.jobs.back());
+	queue.jobs.pop_back();
+	return true;
+}
+
+bool JobSystem::Steal(unsigned int start, Job& job) {
+	unsigned int count = (unsigned int)queues.size();
+	for (unsigned int i = 0; i < count; ++i) {
+		WorkQueue& queue = queues[(start + i) % count];
+		std::lock_guard<std::mutex> guard(queue.lock);
+		if (!queue.jobs.empty()) {
+			job = std::move(queue.jobs.front());
+			queue.jobs.pop_front();
+			return true;
+		}
+	}
+	return false;
+}
+
+bool JobSystem::FindJob(Job& job) {
+	if (queuedJobs.load(std::memory_order_acquire) == 0) {
+		return false;
+	}
+	bool found;
+	if (IsWorkerThread()) {
+		found = Pop(threadQueue, job) || Steal(threadQueue + 1, job);
+	}
+	else {
+		found = Steal(nextQueue.load(std::memory_order_relaxed), job);
+	}
+	if (found) {
+		queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+		return true;
+	}
+	return false;
+}
+
+void JobSystem::Execute(Job& job) {
+	job.func();
+	Finish(job.counter);
+}
+
+void JobSystem::Finish(JobCounter* counter) {
+	if (!counter) {
+		return;
+	}
+	/*
+	The decrement happens under the lock so that Wait can't see the
+	counter hit 0 and let it be destroyed while we're still using it.
+	*/
+	std::vector<Job> ready;
+	{
+		std::lock_guard<std::mutex> guard(counter->continuationLock);
+		if (counter->count.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+			// Last job in the group, release anything that was waiting on it
+			ready.swap(counter->continuations);
+		}
+	}
+	for (Job& j : ready) {
+		Push(std::move(j));
+	}
+}
+
+void JobSystem::WorkerLoop(unsigned int index) {
+	threadSystem	= this;
+	threadQueue		= index;
+
+	while (true) {
+		Job job;
+		if (FindJob(job)) {
+			Execute(job);
+			continue;
+		}
+		std::unique_lock<std::mutex> guard(sleepLock);
+		sleepCondition.wait(guard, [&]() {
+			return !running || queuedJobs.load(std::memory_order_acquire) > 0;
+		});
+		if (!running) {
+			return;
+		}
+	}
+}
@@ -0,0 +1,142 @@
+/*
+Part of Newcastle University's Game Engineering source code.
+
+Use as you see fit!
+
+Comments and queries to: richard-gordon.davison AT ncl.ac.uk
+https://research.ncl.ac.uk/game/
+*/
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
+
+namespace NCL {
+	typedef std::function<void()> JobFunc;
+
+	class JobSystem;
+
+	/*
+	Counts how many jobs are still outstanding in a group. Jobs can be
+	made to wait on a counter, and will only be queued once it hits 0.
+	*/
+	class JobCounter {
+	public:
+		JobCounter() : count(0) {}
+		JobCounter(const JobCounter&) = delete;
+		JobCounter& operator=(const JobCounter&) = delete;
+
+		bool IsDone() const {
+			return count.load(std::memory_order_acquire) == 0;
+		}
+
+	protected:
+		friend class JobSystem;
+
+		struct Job {
+			JobFunc		func;
+			JobCounter* counter;
+		};
+
+		std::atomic<int>	count;
+		std::mutex			continuationLock;
+		std::vector<Job>	continuations;
+	};
+
+	class JobSystem {
+	public:
+		// 0 workers means one per hardware thread, minus one for the calling thread
+		JobSystem(unsigned int workerCount = 0);
+		~JobSystem();
+
+		JobSystem(const JobSystem&) = delete;
+		JobSystem& operator=(const JobSystem&) = delete;
+
+		unsigned int GetWorkerCount() const {
+			return (unsigned int)queues.size();
+		}
+
+		// Queues a job, adding it to counter (if there is one) until it has run
+		void Run(JobFunc func, JobCounter* counter = nullptr);
+
+		// As Run, but the job isn't queued until everything in dependency has finished
+		void RunAfter(JobCounter& dependency, JobFunc func, JobCounter* counter = nullptr);
+
+		// Blocks until the counter hits 0, running other jobs in the meantime.
+		// A counter must be waited on before it goes out of scope.
+		void Wait(JobCounter& counter);
+
+		/*
+		Calls func on every item in the span, split into batches of
+		grainSize items that run across the workers. Returns once every
+		item has been processed. Small spans just run on the calling thread.
+		*/
+		template <typename T, typename F>
+		void ParallelFor(std::span<T> items, F func, size_t grainSize = 64) {
+			if (grainSize == 0) {
+				grainSize = 1;
+			}
+			if (workers.empty() || items.size() <= grainSize) {
+				for (T& item : items) {
+					func(item);
+				}
+				return;
+			}
+			JobCounter counter;
+			for (size_t start = grainSize; start < items.size(); start += grainSize) {
+				std::span<T> batch = items.subspan(start, std::min(grainSize, items.size() - start));
+				Run([batch, &func]() {
+					for (T& item : batch) {
+						func(item);
+					}
+				}, &counter);
+			}
+			for (T& item : items.first(grainSize)) {
+				func(item); // Calling thread takes the first batch itself
+			}
+			Wait(counter);
+		}
+
+		// True if called from one of this system's worker threads
+		bool IsWorkerThread() const;
+
+	protected:
+		typedef JobCounter::Job Job;
+
+		/*
+		Each worker owns a deque. The owner pushes and pops at the back, so it
+		works through its most recent (and cache-warm) jobs first, while idle
+		workers steal the oldest jobs from the front of someone else's.
+		*/
+		struct WorkQueue {
+			std::mutex			lock;
+			std::deque<Job>		jobs;
+		};
+
+		void WorkerLoop(unsigned int index);
+
+		void Push(Job&& job);
+		bool Pop(unsigned int index, Job& job);
+		bool Steal(unsigned int start, Job& job);
+		bool FindJob(Job& job);
+
+		void Execute(Job& job);
+		void Finish(JobCounter* counter);
+
+		std::vector<WorkQueue>		queues;
+		std::vector<std::thread>	workers;
+
+		std::atomic<int>			queuedJobs;
+		std::atomic<unsigned int>	nextQueue;
+		std::atomic<bool>			running;
+
+		std::mutex					sleepLock;
+		std::condition_variable		sleepCondition;
+	};
+}
@@ -0,0 +1,54 @@
+/*
+Part of Newcastle University's Game Engineering source code.
+
+Use as you see fit!
+
+Comments and queries to: richard-gordon.davison AT ncl.ac.uk
+https://research.ncl.ac.uk/game/
+*/
+#pragma once
+#include <cstddef>
+#include <string>
+
+namespace NCL {
+	/*
+	Maps a whole file into memory read-only, so it can be used where it
+	sits rather than being read into a buffer first. Pages are only
+	loaded in by the OS as they're touched, and stay shared with any
+	other process mapping the same file.
+
+	The data stays valid until the MappedFile is closed or destroyed.
+	*/
+	class MappedFile {
+	public:
+		MappedFile();
+		MappedFile(const std::string& filepath);
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		bool Open(const std::string& filepath);
+		void Close();
+
+		bool IsOpen() const {
+			return data != nullptr;
+		}
+
+		const char* GetData() const {
+			return data;
+		}
+
+		size_t GetSize() const {
+			return size;
+		}
+
+	protected:
+		const char*	data;
+		size_t		size;
+#ifdef _WIN32
+		void*		fileHandle;
+		void*		mappingHandle;
+#endif
+	};
+}